@@ -49,6 +49,11 @@ endif
 include common_features.mk
 include $(TMK_PATH)/common.mk
 include $(QUANTUM_PATH)/serial_link/tests/rules.mk
+include $(QUANTUM_PATH)/debounce/tests/rules.mk
+include $(QUANTUM_PATH)/audio/tests/rules.mk
+include $(TMK_PATH)/protocol/lufa/tests/rules.mk
+include keyboards/ergodox_ez/tests/rules.mk
+include keyboards/lets_split/tests/rules.mk
 ifneq ($(filter $(FULL_TESTS),$(TEST)),)
 include build_full_test.mk
 endif
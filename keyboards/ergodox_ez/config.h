@@ -81,7 +81,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define RGBW 1
 
 /* Set 0 if debouncing isn't needed */
-#define DEBOUNCE    15
+#define DEBOUNCING_DELAY 15
 
 #define PREVENT_STUCK_MODIFIERS
 
@@ -35,34 +35,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "matrix.h"
 #include QMK_KEYBOARD_H
 #include "i2cmaster.h"
+#include "debounce.h"
 #ifdef DEBUG_MATRIX_SCAN_RATE
 #include  "timer.h"
 #endif
 
-/*
- * This constant define not debouncing time in msecs, but amount of matrix
- * scan loops which should be made to get stable debounced results.
- *
- * On Ergodox matrix scan rate is relatively low, because of slow I2C.
- * Now it's only 317 scans/second, or about 3.15 msec/scan.
- * According to Cherry specs, debouncing time is 5 msec.
- *
- * And so, there is no sense to have DEBOUNCE higher than 2.
- */
-
-#ifndef DEBOUNCE
-#   define DEBOUNCE	5
-#endif
-
 /* matrix state(1:on, 0:off) */
 static matrix_row_t matrix[MATRIX_ROWS];
+/* raw values of the last scan, before debouncing */
+static matrix_row_t raw_matrix[MATRIX_ROWS];
 
-// Debouncing: store for each key the number of scans until it's eligible to
-// change.  When scanning the matrix, ignore any changes in keys that have
-// already changed in the last DEBOUNCE scans.
-static uint8_t debounce_matrix[MATRIX_ROWS * MATRIX_COLS];
-
-static matrix_row_t read_cols(uint8_t row);
+static matrix_row_t read_cols(void);
 static void init_cols(void);
 static void unselect_rows(void);
 static void select_row(uint8_t row);
@@ -72,6 +55,7 @@ static uint8_t mcp23018_reset_loop;
 #ifdef DEBUG_MATRIX_SCAN_RATE
 uint32_t matrix_timer;
 uint32_t matrix_scan_count;
+uint32_t matrix_i2c_count;
 #endif
 
 
@@ -108,7 +92,7 @@ void matrix_init(void)
     // initialize row and col
 
     mcp23018_status = init_mcp23018();
-
+    mcp23018_scan_reset();
 
     unselect_rows();
     init_cols();
@@ -116,14 +100,16 @@ void matrix_init(void)
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) {
         matrix[i] = 0;
-        for (uint8_t j=0; j < MATRIX_COLS; ++j) {
-            debounce_matrix[i * MATRIX_COLS + j] = 0;
-        }
+        raw_matrix[i] = 0;
     }
 
+    debounce_init(MATRIX_ROWS);
+
 #ifdef DEBUG_MATRIX_SCAN_RATE
     matrix_timer = timer_read32();
     matrix_scan_count = 0;
+    matrix_i2c_count = 0;
+    mcp23018_transactions();
 #endif
 
     matrix_init_quantum();
@@ -132,6 +118,7 @@ void matrix_init(void)
 
 void matrix_power_up(void) {
     mcp23018_status = init_mcp23018();
+    mcp23018_scan_reset();
 
     unselect_rows();
     init_cols();
@@ -147,30 +134,6 @@ void matrix_power_up(void) {
 #endif
 }
 
-// Returns a matrix_row_t whose bits are set if the corresponding key should be
-// eligible to change in this scan.
-matrix_row_t debounce_mask(uint8_t row) {
-  matrix_row_t result = 0;
-  for (uint8_t j=0; j < MATRIX_COLS; ++j) {
-    if (debounce_matrix[row * MATRIX_COLS + j]) {
-      --debounce_matrix[row * MATRIX_COLS + j];
-    } else {
-      result |= (1 << j);
-    }
-  }
-  return result;
-}
-
-// Report changed keys in the given row.  Resets the debounce countdowns
-// corresponding to each set bit in 'change' to DEBOUNCE.
-void debounce_report(matrix_row_t change, uint8_t row) {
-  for (uint8_t i = 0; i < MATRIX_COLS; ++i) {
-    if (change & (1 << i)) {
-      debounce_matrix[row * MATRIX_COLS + i] = DEBOUNCE;
-    }
-  }
-}
-
 uint8_t matrix_scan(void)
 {
     if (mcp23018_status) { // if there was an error
@@ -179,6 +142,7 @@ uint8_t matrix_scan(void)
             // this will be approx bit more frequent than once per second
             print("trying to reset mcp23018\n");
             mcp23018_status = init_mcp23018();
+            mcp23018_scan_reset();
             if (mcp23018_status) {
                 print("left side not responding\n");
             } else {
@@ -190,29 +154,37 @@ uint8_t matrix_scan(void)
 
 #ifdef DEBUG_MATRIX_SCAN_RATE
     matrix_scan_count++;
+    matrix_i2c_count += mcp23018_transactions();
 
     uint32_t timer_now = timer_read32();
     if (TIMER_DIFF_32(timer_now, matrix_timer)>1000) {
         print("matrix scan frequency: ");
         pdec(matrix_scan_count);
+        print(", i2c transactions: ");
+        pdec(matrix_i2c_count);
         print("\n");
 
         matrix_timer = timer_now;
         matrix_scan_count = 0;
+        matrix_i2c_count = 0;
     }
 #endif
 
-    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+    // the left half, only read row by row when a key is down
+    bool changed = mcp23018_scan(raw_matrix);
+
+    for (uint8_t i = MCP23018_ROWS; i < MATRIX_ROWS; i++) {
         select_row(i);
         wait_us(30);  // without this wait read unstable value.
-        matrix_row_t mask = debounce_mask(i);
-        matrix_row_t cols = (read_cols(i) & mask) | (matrix[i] & ~mask);
-        debounce_report(cols ^ matrix[i], i);
-        matrix[i] = cols;
+        matrix_row_t cols = read_cols();
+        changed |= (cols != raw_matrix[i]);
+        raw_matrix[i] = cols;
 
         unselect_rows();
     }
 
+    debounce(raw_matrix, matrix, MATRIX_ROWS, changed);
+
     matrix_scan_quantum();
 
     return 1;
@@ -275,32 +247,16 @@ static void  init_cols(void)
     PORTF |=  (1<<7 | 1<<6 | 1<<5 | 1<<4 | 1<<1 | 1<<0);
 }
 
-static matrix_row_t read_cols(uint8_t row)
+static matrix_row_t read_cols(void)
 {
-    if (row < 7) {
-        if (mcp23018_status) { // if there was an error
-            return 0;
-        } else {
-            uint8_t data = 0;
-            mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write(GPIOB);             if (mcp23018_status) goto out;
-            mcp23018_status = i2c_start(I2C_ADDR_READ);     if (mcp23018_status) goto out;
-            data = i2c_readNak();
-            data = ~data;
-        out:
-            i2c_stop();
-            return data;
-        }
-    } else {
-        // read from teensy
-        return
-            (PINF&(1<<0) ? 0 : (1<<0)) |
-            (PINF&(1<<1) ? 0 : (1<<1)) |
-            (PINF&(1<<4) ? 0 : (1<<2)) |
-            (PINF&(1<<5) ? 0 : (1<<3)) |
-            (PINF&(1<<6) ? 0 : (1<<4)) |
-            (PINF&(1<<7) ? 0 : (1<<5)) ;
-    }
+    // read from teensy
+    return
+        (PINF&(1<<0) ? 0 : (1<<0)) |
+        (PINF&(1<<1) ? 0 : (1<<1)) |
+        (PINF&(1<<4) ? 0 : (1<<2)) |
+        (PINF&(1<<5) ? 0 : (1<<3)) |
+        (PINF&(1<<6) ? 0 : (1<<4)) |
+        (PINF&(1<<7) ? 0 : (1<<5)) ;
 }
 
 /* Row pin configuration
@@ -315,19 +271,7 @@ static matrix_row_t read_cols(uint8_t row)
  */
 static void unselect_rows(void)
 {
-    // unselect on mcp23018
-    if (mcp23018_status) { // if there was an error
-        // do nothing
-    } else {
-        // set all rows hi-Z : 1
-        mcp23018_status = i2c_start(I2C_ADDR_WRITE);    if (mcp23018_status) goto out;
-        mcp23018_status = i2c_write(GPIOA);             if (mcp23018_status) goto out;
-        mcp23018_status = i2c_write( 0xFF
-                              & ~(0<<7)
-                          );                            if (mcp23018_status) goto out;
-    out:
-        i2c_stop();
-    }
+    // the rows of the mcp23018 are selected by mcp23018_scan()
 
     // unselect on teensy
     // Hi-Z(DDR:0, PORT:0) to unselect
@@ -341,54 +285,37 @@ static void unselect_rows(void)
 
 static void select_row(uint8_t row)
 {
-    if (row < 7) {
-        // select on mcp23018
-        if (mcp23018_status) { // if there was an error
-            // do nothing
-        } else {
-            // set active row low  : 0
-            // set other rows hi-Z : 1
-            mcp23018_status = i2c_start(I2C_ADDR_WRITE);        if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write(GPIOA);                 if (mcp23018_status) goto out;
-            mcp23018_status = i2c_write( 0xFF & ~(1<<row)
-                                  & ~(0<<7)
-                              );                                if (mcp23018_status) goto out;
-        out:
-            i2c_stop();
-        }
-    } else {
-        // select on teensy
-        // Output low(DDR:1, PORT:0) to select
-        switch (row) {
-            case 7:
-                DDRB  |= (1<<0);
-                PORTB &= ~(1<<0);
-                break;
-            case 8:
-                DDRB  |= (1<<1);
-                PORTB &= ~(1<<1);
-                break;
-            case 9:
-                DDRB  |= (1<<2);
-                PORTB &= ~(1<<2);
-                break;
-            case 10:
-                DDRB  |= (1<<3);
-                PORTB &= ~(1<<3);
-                break;
-            case 11:
-                DDRD  |= (1<<2);
-                PORTD &= ~(1<<3);
-                break;
-            case 12:
-                DDRD  |= (1<<3);
-                PORTD &= ~(1<<3);
-                break;
-            case 13:
-                DDRC  |= (1<<6);
-                PORTC &= ~(1<<6);
-                break;
-        }
+    // select on teensy
+    // Output low(DDR:1, PORT:0) to select
+    switch (row) {
+        case 7:
+            DDRB  |= (1<<0);
+            PORTB &= ~(1<<0);
+            break;
+        case 8:
+            DDRB  |= (1<<1);
+            PORTB &= ~(1<<1);
+            break;
+        case 9:
+            DDRB  |= (1<<2);
+            PORTB &= ~(1<<2);
+            break;
+        case 10:
+            DDRB  |= (1<<3);
+            PORTB &= ~(1<<3);
+            break;
+        case 11:
+            DDRD  |= (1<<2);
+            PORTD &= ~(1<<3);
+            break;
+        case 12:
+            DDRD  |= (1<<3);
+            PORTD &= ~(1<<3);
+            break;
+        case 13:
+            DDRC  |= (1<<6);
+            PORTC &= ~(1<<6);
+            break;
     }
 }
 
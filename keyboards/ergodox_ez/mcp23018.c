@@ -0,0 +1,107 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "mcp23018.h"
+#include "wait.h"
+
+// rows are selected by driving them low, the others are hi-Z
+#define SELECT_ROW(row)     (0xFF & ~(1<<(row)))
+#define SELECT_ALL_ROWS     (0xFF & ~((1<<MCP23018_ROWS) - 1))
+
+/* all rows are selected, so GPIOB reads every key of the left half at once */
+static bool all_rows_selected;
+
+static uint16_t transactions;
+
+/* selects 'rows' and reads the columns, in one transaction */
+static uint8_t select_and_read(uint8_t rows)
+{
+    uint8_t data = 0;
+    transactions++;
+    mcp23018_status = i2c_start(I2C_ADDR_WRITE);        if (mcp23018_status) goto out;
+    mcp23018_status = i2c_write(GPIOA);                 if (mcp23018_status) goto out;
+    mcp23018_status = i2c_write(rows);                  if (mcp23018_status) goto out;
+    wait_us(30);  // without this wait read unstable value.
+    mcp23018_status = i2c_rep_start(I2C_ADDR_READ);     if (mcp23018_status) goto out;
+    data = ~i2c_readNak() & MCP23018_COLS_MASK;
+out:
+    i2c_stop();
+    return data;
+}
+
+/* reads the columns with the rows selected as they are */
+static uint8_t read_cols(void)
+{
+    uint8_t data = 0;
+    transactions++;
+    mcp23018_status = i2c_start(I2C_ADDR_WRITE);        if (mcp23018_status) goto out;
+    mcp23018_status = i2c_write(GPIOB);                 if (mcp23018_status) goto out;
+    mcp23018_status = i2c_rep_start(I2C_ADDR_READ);     if (mcp23018_status) goto out;
+    data = ~i2c_readNak() & MCP23018_COLS_MASK;
+out:
+    i2c_stop();
+    return data;
+}
+
+static void select_rows(uint8_t rows)
+{
+    transactions++;
+    mcp23018_status = i2c_start(I2C_ADDR_WRITE);        if (mcp23018_status) goto out;
+    mcp23018_status = i2c_write(GPIOA);                 if (mcp23018_status) goto out;
+    mcp23018_status = i2c_write(rows);                  if (mcp23018_status) goto out;
+out:
+    i2c_stop();
+}
+
+bool mcp23018_scan(uint8_t rows[MCP23018_ROWS])
+{
+    uint8_t down = 0;
+    for (uint8_t i = 0; i < MCP23018_ROWS; i++) {
+        down |= rows[i];
+    }
+
+    if (!down && all_rows_selected && !mcp23018_status) {
+        if (!read_cols() && !mcp23018_status) {
+            return false;
+        }
+    }
+
+    bool changed = false;
+    for (uint8_t i = 0; i < MCP23018_ROWS; i++) {
+        uint8_t cols = 0;
+        if (!mcp23018_status) { // if there was no error
+            cols = select_and_read(SELECT_ROW(i));
+        }
+        changed |= (cols != rows[i]);
+        rows[i] = cols;
+    }
+
+    if (!mcp23018_status) {
+        select_rows(SELECT_ALL_ROWS);
+    }
+    all_rows_selected = !mcp23018_status;
+    return changed;
+}
+
+void mcp23018_scan_reset(void)
+{
+    all_rows_selected = false;
+}
+
+uint16_t mcp23018_transactions(void)
+{
+    uint16_t count = transactions;
+    transactions = 0;
+    return count;
+}
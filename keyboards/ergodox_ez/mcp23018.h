@@ -0,0 +1,68 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MCP23018_H
+#define MCP23018_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2cmaster.h"
+
+// I2C aliases and register addresses (see "mcp23018.md")
+#define I2C_ADDR        0b0100000
+#define I2C_ADDR_WRITE  ( (I2C_ADDR<<1) | I2C_WRITE )
+#define I2C_ADDR_READ   ( (I2C_ADDR<<1) | I2C_READ  )
+#define IODIRA          0x00            // i/o direction register
+#define IODIRB          0x01
+#define GPPUA           0x0C            // GPIO pull-up resistor register
+#define GPPUB           0x0D
+#define GPIOA           0x12            // general purpose i/o port register (write modifies OLAT)
+#define GPIOB           0x13
+#define OLATA           0x14            // output latch register
+#define OLATB           0x15
+
+// the left half: rows on A0-A6, columns on B0-B5
+#define MCP23018_ROWS       7
+#define MCP23018_COLS_MASK  0b00111111
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint8_t mcp23018_status;
+
+/*
+ * Reads the rows of the left half into 'rows' and returns whether any of
+ * them changed. On an error of the bus, the rows read as released.
+ *
+ * Selecting a row and reading the columns is a single transaction: with
+ * sequential addressing, writing GPIOA moves on to GPIOB, which is what a
+ * read after the repeated start returns. Once the rows are read, all of them
+ * are selected, so while no key of the left half is down, reading GPIOB once
+ * tells whether one has been pressed since. The INT pins would tell without
+ * using the bus, but they aren't wired to the right half.
+ */
+bool mcp23018_scan(uint8_t rows[MCP23018_ROWS]);
+
+/* the next mcp23018_scan() reads every row, e.g. after init_mcp23018() */
+void mcp23018_scan_reset(void);
+
+/* the number of I2C transactions since the last call */
+uint16_t mcp23018_transactions(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -16,6 +16,7 @@
 
 # # project specific files
 SRC = twimaster.c \
+	  mcp23018.c \
 	  matrix.c
 
 # MCU name
@@ -82,5 +83,6 @@ ONEHAND_ENABLE   = yes # Allow swapping hands of keyboard
 SLEEP_LED_ENABLE = no
 API_SYSEX_ENABLE = no
 RGBLIGHT_ENABLE = yes
+DEBOUNCE_TYPE    = eager_pk # Report a change on its first edge, then lock the key out
 
 LAYOUTS = ergodox
\ No newline at end of file
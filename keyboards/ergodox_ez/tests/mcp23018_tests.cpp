@@ -0,0 +1,282 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <cstring>
+extern "C" {
+#include "i2cmaster.h"
+}
+#include "mcp23018.h"
+
+uint8_t mcp23018_status = 0;
+
+// Stands in for the MCP23018 of the left half, as init_mcp23018() sets it
+// up: port A drives the rows, port B reads the columns with pull-ups. Keys
+// connect their row to their column, so a column reads low when a key on
+// one of the selected rows is down.
+namespace {
+struct MockMcp23018 {
+    bool connected = true;
+    bool keys[MCP23018_ROWS][8];
+    uint8_t registers[0x16];
+    uint8_t pointer;
+    bool in_transaction = false;
+    bool reading = false;
+    bool pointer_written = false;
+    uint32_t transactions = 0;
+    uint32_t bytes = 0;
+
+    void reset() {
+        memset(keys, 0, sizeof(keys));
+        memset(registers, 0, sizeof(registers));
+        registers[IODIRA] = 0b00000000;
+        registers[IODIRB] = 0b00111111;
+        registers[GPPUB] = 0b00111111;
+        connected = true;
+        transactions = 0;
+        bytes = 0;
+    }
+
+    uint8_t read_register(uint8_t reg) {
+        if (reg != GPIOB) {
+            return registers[reg];
+        }
+        uint8_t value = registers[OLATB] & ~registers[IODIRB];
+        for (uint8_t col = 0; col < 8; col++) {
+            if (!(registers[IODIRB] & (1 << col))) {
+                continue;
+            }
+            bool low = false;
+            for (uint8_t row = 0; row < MCP23018_ROWS; row++) {
+                bool selected = !(registers[IODIRA] & (1 << row)) && !(registers[OLATA] & (1 << row));
+                low |= selected && keys[row][col];
+            }
+            if (!low) {
+                value |= 1 << col;
+            }
+        }
+        return value;
+    }
+
+    void write_register(uint8_t reg, uint8_t value) {
+        if (reg == GPIOA) {
+            reg = OLATA;
+        } else if (reg == GPIOB) {
+            reg = OLATB;
+        }
+        registers[reg] = value;
+    }
+
+    // the rows as a full scan of the matrix sees them
+    uint8_t expected_row(uint8_t row) {
+        uint8_t cols = 0;
+        for (uint8_t col = 0; col < 6; col++) {
+            if (keys[row][col]) {
+                cols |= 1 << col;
+            }
+        }
+        return cols;
+    }
+};
+
+MockMcp23018 mcp;
+
+unsigned char address(unsigned char addr) {
+    mcp.bytes++;
+    if (!mcp.connected || (addr >> 1) != I2C_ADDR) {
+        return 1;
+    }
+    mcp.reading = addr & I2C_READ;
+    return 0;
+}
+}
+
+extern "C" {
+unsigned char i2c_start(unsigned char addr) {
+    EXPECT_FALSE(mcp.in_transaction);
+    mcp.in_transaction = true;
+    mcp.pointer_written = false;
+    mcp.transactions++;
+    return address(addr);
+}
+
+unsigned char i2c_rep_start(unsigned char addr) {
+    EXPECT_TRUE(mcp.in_transaction);
+    return address(addr);
+}
+
+void i2c_stop(void) {
+    mcp.in_transaction = false;
+}
+
+unsigned char i2c_write(unsigned char data) {
+    EXPECT_TRUE(mcp.in_transaction);
+    EXPECT_FALSE(mcp.reading);
+    mcp.bytes++;
+    if (!mcp.connected) {
+        return 1;
+    }
+    if (!mcp.pointer_written) {
+        mcp.pointer = data;
+        mcp.pointer_written = true;
+    } else {
+        // sequential addressing
+        mcp.write_register(mcp.pointer++, data);
+    }
+    return 0;
+}
+
+unsigned char i2c_readNak(void) {
+    EXPECT_TRUE(mcp.in_transaction);
+    EXPECT_TRUE(mcp.reading);
+    mcp.bytes++;
+    return mcp.read_register(mcp.pointer++);
+}
+}
+
+class ErgodoxEzMcp23018 : public testing::Test {
+public:
+    ErgodoxEzMcp23018() {
+        mcp.reset();
+        mcp23018_status = 0;
+        mcp23018_scan_reset();
+        memset(rows, 0, sizeof(rows));
+        mcp23018_transactions();
+    }
+
+    // scans like matrix_scan() does, and checks the transactions it counted
+    bool scan() {
+        uint32_t before = mcp.transactions;
+        bool changed = mcp23018_scan(rows);
+        last_transactions = mcp.transactions - before;
+        EXPECT_EQ(mcp23018_transactions(), last_transactions);
+        return changed;
+    }
+
+    void expect_rows() {
+        for (uint8_t row = 0; row < MCP23018_ROWS; row++) {
+            EXPECT_EQ(rows[row], mcp.expected_row(row)) << "row " << (int)row;
+        }
+    }
+
+    uint8_t rows[MCP23018_ROWS];
+    uint32_t last_transactions = 0;
+};
+
+TEST_F(ErgodoxEzMcp23018, FirstScanReadsEveryRow) {
+    EXPECT_FALSE(scan());
+    // a transaction per row, and one to select all of them
+    EXPECT_EQ(last_transactions, MCP23018_ROWS + 1u);
+    expect_rows();
+}
+
+TEST_F(ErgodoxEzMcp23018, IdleScanIsOneTransaction) {
+    scan();
+    for (int i = 0; i < 10; i++) {
+        EXPECT_FALSE(scan());
+        EXPECT_EQ(last_transactions, 1u);
+    }
+    // all rows are left selected
+    EXPECT_EQ(mcp.registers[OLATA] & 0x7F, 0);
+}
+
+TEST_F(ErgodoxEzMcp23018, FindsAPressedKey) {
+    scan();
+    mcp.keys[3][2] = true;
+    EXPECT_TRUE(scan());
+    EXPECT_EQ(last_transactions, 1u + MCP23018_ROWS + 1u);
+    expect_rows();
+
+    // held down: every row is read, to find the next key
+    EXPECT_FALSE(scan());
+    EXPECT_EQ(last_transactions, MCP23018_ROWS + 1u);
+    mcp.keys[5][2] = true;
+    EXPECT_TRUE(scan());
+    expect_rows();
+
+    mcp.keys[3][2] = false;
+    mcp.keys[5][2] = false;
+    EXPECT_TRUE(scan());
+    expect_rows();
+    EXPECT_FALSE(scan());
+    EXPECT_EQ(last_transactions, 1u);
+}
+
+TEST_F(ErgodoxEzMcp23018, IgnoresTheOutputsOfPortB) {
+    mcp.registers[OLATB] = 0;
+    scan();
+    for (uint8_t row = 0; row < MCP23018_ROWS; row++) {
+        EXPECT_EQ(rows[row], 0);
+    }
+}
+
+TEST_F(ErgodoxEzMcp23018, MatchesAFullScan) {
+    srand(1);
+    scan();
+    for (int i = 0; i < 2000; i++) {
+        // mostly idle, with a few keys down now and then
+        if (rand() % 4 == 0) {
+            uint8_t row = rand() % MCP23018_ROWS;
+            uint8_t col = rand() % 6;
+            mcp.keys[row][col] = !mcp.keys[row][col];
+        }
+        scan();
+        expect_rows();
+    }
+}
+
+TEST_F(ErgodoxEzMcp23018, KeysReadAsReleasedWhileDisconnected) {
+    mcp.keys[0][0] = true;
+    EXPECT_TRUE(scan());
+    mcp.connected = false;
+    EXPECT_TRUE(scan());
+    EXPECT_NE(mcp23018_status, 0);
+    EXPECT_EQ(rows[0], 0);
+    EXPECT_FALSE(scan());
+    EXPECT_EQ(last_transactions, 0u);
+
+    // like matrix_scan() after init_mcp23018() succeeds again
+    mcp.connected = true;
+    mcp23018_status = 0;
+    mcp23018_scan_reset();
+    EXPECT_TRUE(scan());
+    expect_rows();
+}
+
+TEST_F(ErgodoxEzMcp23018, CostsLessThanSelectingRowByRow) {
+    // what a scan used to cost: for every row a transaction to select it,
+    // one to read the columns, and one to unselect it again
+    const uint32_t old_transactions = 3 * MCP23018_ROWS;
+    const uint32_t old_bytes = (3 + 4 + 3) * MCP23018_ROWS;
+
+    scan();
+    uint32_t bytes = mcp.bytes;
+    scan();
+    uint32_t idle_transactions = last_transactions;
+    uint32_t idle_bytes = mcp.bytes - bytes;
+
+    mcp.keys[1][1] = true;
+    scan();
+    bytes = mcp.bytes;
+    scan();
+    uint32_t held_transactions = last_transactions;
+    uint32_t held_bytes = mcp.bytes - bytes;
+
+    EXPECT_LT(held_transactions, old_transactions);
+    EXPECT_LT(held_bytes, old_bytes);
+    EXPECT_LT(idle_transactions, held_transactions);
+    EXPECT_LT(idle_bytes, held_bytes);
+}
@@ -0,0 +1,5 @@
+ergodox_ez_mcp23018_INC := keyboards/ergodox_ez
+ergodox_ez_mcp23018_SRC := \
+	keyboards/ergodox_ez/tests/mcp23018_tests.cpp \
+	keyboards/ergodox_ez/mcp23018.c \
+	$(TMK_PATH)/common/test/timer.c
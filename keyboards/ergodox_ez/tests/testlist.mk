@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	ergodox_ez_mcp23018
@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdint.h>
 #include <stdbool.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include "wait.h"
 #include "print.h"
 #include "debug.h"
@@ -30,6 +31,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "pro_micro.h"
 #include "config.h"
 #include "timer.h"
+#include "debounce.h"
+#include "split_protocol.h"
 
 #ifdef USE_I2C
 #  include "i2c.h"
@@ -37,15 +40,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #  include "serial.h"
 #endif
 
-#ifndef DEBOUNCING_DELAY
-#   define DEBOUNCING_DELAY 5
-#endif
-
-#if (DEBOUNCING_DELAY > 0)
-    static uint16_t debouncing_time;
-    static bool debouncing = false;
-#endif
-
 #if (MATRIX_COLS <= 8)
 #    define print_matrix_header()  print("\nr/c 01234567\n")
 #    define print_matrix_row(row)  print_bin_reverse8(matrix_get_row(row))
@@ -54,20 +48,31 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #else
 #    error "Currently only supports 8 COLS"
 #endif
-static matrix_row_t matrix_debouncing[MATRIX_ROWS];
 
 #define ERROR_DISCONNECT_COUNT 5
 
 #define ROWS_PER_HAND (MATRIX_ROWS/2)
 
+#ifdef USE_I2C
+// the frame of the slave is stored at 0x00, the ack of the master after it
+#   define SPLIT_ACK_REG SPLIT_FRAME_MAX
+#   if SPLIT_ACK_REG + SPLIT_ACK_LENGTH > SLAVE_BUFFER_SIZE
+#       error "The i2c slave buffer is too small for split_protocol"
+#   endif
+#endif
+
 static uint8_t error_count = 0;
 
+static split_master_t split_master;
+static split_slave_t split_slave;
+
 static const uint8_t row_pins[MATRIX_ROWS] = MATRIX_ROW_PINS;
 static const uint8_t col_pins[MATRIX_COLS] = MATRIX_COL_PINS;
 
 /* matrix state(1:on, 0:off) */
 static matrix_row_t matrix[MATRIX_ROWS];
-static matrix_row_t matrix_debouncing[MATRIX_ROWS];
+/* raw values of the last scan, before debouncing */
+static matrix_row_t raw_matrix[MATRIX_ROWS];
 
 #if (DIODE_DIRECTION == COL2ROW)
     static void init_cols(void);
@@ -136,9 +141,14 @@ void matrix_init(void)
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) {
         matrix[i] = 0;
-        matrix_debouncing[i] = 0;
+        raw_matrix[i] = 0;
     }
 
+    debounce_init(ROWS_PER_HAND);
+
+    split_master_init(&split_master);
+    split_slave_init(&split_slave);
+
     matrix_init_quantum();
 
 }
@@ -146,48 +156,23 @@ void matrix_init(void)
 uint8_t _matrix_scan(void)
 {
     int offset = isLeftHand ? 0 : (ROWS_PER_HAND);
+    bool changed = false;
 #if (DIODE_DIRECTION == COL2ROW)
     // Set row, read cols
     for (uint8_t current_row = 0; current_row < ROWS_PER_HAND; current_row++) {
-#       if (DEBOUNCING_DELAY > 0)
-            bool matrix_changed = read_cols_on_row(matrix_debouncing+offset, current_row);
-
-            if (matrix_changed) {
-                debouncing = true;
-                debouncing_time = timer_read();
-                PORTD ^= (1 << 2);
-            }
-
-#       else
-            read_cols_on_row(matrix+offset, current_row);
-#       endif
-
+        if (read_cols_on_row(raw_matrix+offset, current_row)) {
+            changed = true;
+            PORTD ^= (1 << 2);
+        }
     }
-
 #elif (DIODE_DIRECTION == ROW2COL)
     // Set col, read rows
     for (uint8_t current_col = 0; current_col < MATRIX_COLS; current_col++) {
-#       if (DEBOUNCING_DELAY > 0)
-            bool matrix_changed = read_rows_on_col(matrix_debouncing+offset, current_col);
-            if (matrix_changed) {
-                debouncing = true;
-                debouncing_time = timer_read();
-            }
-#       else
-             read_rows_on_col(matrix+offset, current_col);
-#       endif
-
+        changed |= read_rows_on_col(raw_matrix+offset, current_col);
     }
 #endif
 
-#   if (DEBOUNCING_DELAY > 0)
-        if (debouncing && (timer_elapsed(debouncing_time) > DEBOUNCING_DELAY)) {
-            for (uint8_t i = 0; i < ROWS_PER_HAND; i++) {
-                matrix[i+offset] = matrix_debouncing[i+offset];
-            }
-            debouncing = false;
-        }
-#   endif
+    debounce(raw_matrix+offset, matrix+offset, ROWS_PER_HAND, changed);
 
     return 1;
 }
@@ -196,46 +181,80 @@ uint8_t _matrix_scan(void)
 
 // Get rows from other half over i2c
 int i2c_transaction(void) {
-    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
+    uint8_t ack[SPLIT_ACK_LENGTH];
+    uint8_t reply[SPLIT_FRAME_MAX];
+    uint8_t length;
+
+    split_master_ack(&split_master, ack);
 
     int err = i2c_master_start(SLAVE_I2C_ADDRESS + I2C_WRITE);
     if (err) goto i2c_error;
 
-    // start of matrix stored at 0x00
+    // start of the frame stored at 0x00
     err = i2c_master_write(0x00);
     if (err) goto i2c_error;
 
-    // Start read
+    // Start read, the sequence number only, which is all there is to it
+    // while nothing changes
     err = i2c_master_start(SLAVE_I2C_ADDRESS + I2C_READ);
     if (err) goto i2c_error;
+    reply[0] = i2c_master_read(I2C_NACK);
+
+    length = split_reply_length(reply, 1, ack);
+    if (length > 1) {
+        // the slave moves on to the next byte with every read
+        err = i2c_master_start(SLAVE_I2C_ADDRESS + I2C_READ);
+        if (err) goto i2c_error;
+
+        uint8_t i;
+        for (i = 1; i < length-1; ++i) {
+            reply[i] = i2c_master_read(I2C_ACK);
+            length = split_reply_length(reply, i+1, ack);
+        }
+        reply[i] = i2c_master_read(I2C_NACK);
+    }
+    i2c_master_stop();
 
-    if (!err) {
-        int i;
-        for (i = 0; i < ROWS_PER_HAND-1; ++i) {
-            matrix[slaveOffset+i] = i2c_master_read(I2C_ACK);
+    if (split_master_receive(&split_master, reply, length) == SPLIT_CORRUPT) {
+        return 1;
+    }
+
+    if (length > 1) {
+        // tell the slave which rows we have now
+        split_master_ack(&split_master, ack);
+        err = i2c_master_start(SLAVE_I2C_ADDRESS + I2C_WRITE);
+        if (err) goto i2c_error;
+        err = i2c_master_write(SPLIT_ACK_REG);
+        if (err) goto i2c_error;
+        for (uint8_t i = 0; i < SPLIT_ACK_LENGTH; ++i) {
+            err = i2c_master_write(ack[i]);
+            if (err) goto i2c_error;
         }
-        matrix[slaveOffset+i] = i2c_master_read(I2C_NACK);
         i2c_master_stop();
-    } else {
-i2c_error: // the cable is disconnceted, or something else went wrong
-        i2c_reset_state();
-        return err;
     }
-
     return 0;
+
+i2c_error: // the cable is disconnceted, or something else went wrong
+    i2c_reset_state();
+    return err;
 }
 
 #else // USE_SERIAL
 
 int serial_transaction(void) {
-    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
+    uint8_t reply[SPLIT_FRAME_MAX];
 
+    split_master_ack(&split_master, (uint8_t *)serial_master_buffer);
     if (serial_update_buffers()) {
         return 1;
     }
 
-    for (int i = 0; i < ROWS_PER_HAND; ++i) {
-        matrix[slaveOffset+i] = serial_slave_buffer[i];
+    for (uint8_t i = 0; i < SPLIT_FRAME_MAX; ++i) {
+        reply[i] = serial_slave_buffer[i];
+    }
+    uint8_t length = split_reply_length(reply, SPLIT_FRAME_MAX, (const uint8_t *)serial_master_buffer);
+    if (split_master_receive(&split_master, reply, length) == SPLIT_CORRUPT) {
+        return 1;
     }
     return 0;
 }
@@ -256,17 +275,18 @@ uint8_t matrix_scan(void)
         error_count++;
 
         if (error_count > ERROR_DISCONNECT_COUNT) {
-            // reset other half if disconnected
-            int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
-            for (int i = 0; i < ROWS_PER_HAND; ++i) {
-                matrix[slaveOffset+i] = 0;
-            }
+            // reset other half if disconnected, and start over with it
+            split_master_init(&split_master);
         }
     } else {
         // turn off the indicator led on no error
         TXLED0;
         error_count = 0;
     }
+    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
+    for (int i = 0; i < ROWS_PER_HAND; ++i) {
+        matrix[slaveOffset+i] = split_master.rows[i];
+    }
     matrix_scan_quantum();
     return ret;
 }
@@ -275,21 +295,39 @@ void matrix_slave_scan(void) {
     _matrix_scan();
 
     int offset = (isLeftHand) ? 0 : ROWS_PER_HAND;
+    uint8_t ack[SPLIT_ACK_LENGTH];
+    uint8_t frame[SPLIT_FRAME_MAX];
 
+    // the buffers are shared with the interrupt that talks to the master
+    cli();
+    for (uint8_t i = 0; i < SPLIT_ACK_LENGTH; ++i) {
 #ifdef USE_I2C
-    for (int i = 0; i < ROWS_PER_HAND; ++i) {
-        i2c_slave_buffer[i] = matrix[offset+i];
-    }
+        ack[i] = i2c_slave_buffer[SPLIT_ACK_REG+i];
 #else // USE_SERIAL
-    for (int i = 0; i < ROWS_PER_HAND; ++i) {
-        serial_slave_buffer[i] = matrix[offset+i];
+        ack[i] = serial_master_buffer[i];
+#endif
     }
+    sei();
+
+    // the ack first, it is for the rows of the last frame
+    split_slave_ack(&split_slave, ack);
+    split_slave_update(&split_slave, matrix+offset);
+    uint8_t length = split_slave_frame(&split_slave, frame);
+
+    cli();
+    for (uint8_t i = 0; i < length; ++i) {
+#ifdef USE_I2C
+        i2c_slave_buffer[i] = frame[i];
+#else // USE_SERIAL
+        serial_slave_buffer[i] = frame[i];
 #endif
+    }
+    sei();
 }
 
 bool matrix_is_modified(void)
 {
-    if (debouncing) return false;
+    if (debounce_active()) return false;
     return true;
 }
 
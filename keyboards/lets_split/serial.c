@@ -21,9 +21,6 @@
 uint8_t volatile serial_slave_buffer[SERIAL_SLAVE_BUFFER_LENGTH] = {0};
 uint8_t volatile serial_master_buffer[SERIAL_MASTER_BUFFER_LENGTH] = {0};
 
-#define SLAVE_DATA_CORRUPT (1<<0)
-volatile uint8_t status = 0;
-
 inline static
 void serial_delay(void) {
   _delay_us(SERIAL_DELAY);
@@ -122,15 +119,9 @@ void serial_write_byte(uint8_t data) {
 
 // interrupt handle to be used by the slave device
 ISR(SERIAL_PIN_INTERRUPT) {
-  sync_send();
+  // the frame can't change while this runs
+  uint8_t length = split_frame_length((const uint8_t *)serial_slave_buffer);
 
-  uint8_t checksum = 0;
-  for (int i = 0; i < SERIAL_SLAVE_BUFFER_LENGTH; ++i) {
-    serial_write_byte(serial_slave_buffer[i]);
-    sync_send();
-    checksum += serial_slave_buffer[i];
-  }
-  serial_write_byte(checksum);
   sync_send();
 
   // wait for the sync to finish sending
@@ -139,31 +130,26 @@ ISR(SERIAL_PIN_INTERRUPT) {
   // read the middle of pulses
   _delay_us(SERIAL_DELAY/2);
 
-  uint8_t checksum_computed = 0;
   for (int i = 0; i < SERIAL_MASTER_BUFFER_LENGTH; ++i) {
     serial_master_buffer[i] = serial_read_byte();
     sync_send();
-    checksum_computed += serial_master_buffer[i];
   }
-  uint8_t checksum_received = serial_read_byte();
-  sync_send();
 
-  serial_input(); // end transaction
+  // the master has this state already, only confirm it
+  if (split_ack_matches((const uint8_t *)serial_master_buffer, serial_slave_buffer[0])) {
+    length = 1;
+  }
 
-  if ( checksum_computed != checksum_received ) {
-    status |= SLAVE_DATA_CORRUPT;
-  } else {
-    status &= ~SLAVE_DATA_CORRUPT;
+  for (uint8_t i = 0; i < length; ++i) {
+    serial_write_byte(serial_slave_buffer[i]);
+    sync_send();
   }
-}
 
-inline
-bool serial_slave_DATA_CORRUPT(void) {
-  return status & SLAVE_DATA_CORRUPT;
+  serial_input(); // end transaction
 }
 
-// Copies the serial_slave_buffer to the master and sends the
-// serial_master_buffer to the slave.
+// Sends the serial_master_buffer to the slave and copies the reply of the
+// slave to the serial_slave_buffer, see split_protocol.h.
 //
 // Returns:
 // 0 => no error
@@ -192,34 +178,25 @@ int serial_update_buffers(void) {
   // if the slave is present syncronize with it
   sync_recv();
 
-  uint8_t checksum_computed = 0;
-  // receive data from the slave
-  for (int i = 0; i < SERIAL_SLAVE_BUFFER_LENGTH; ++i) {
-    serial_slave_buffer[i] = serial_read_byte();
-    sync_recv();
-    checksum_computed += serial_slave_buffer[i];
-  }
-  uint8_t checksum_received = serial_read_byte();
-  sync_recv();
-
-  if (checksum_computed != checksum_received) {
-    sei();
-    return 1;
-  }
-
-  uint8_t checksum = 0;
   // send data to the slave
   for (int i = 0; i < SERIAL_MASTER_BUFFER_LENGTH; ++i) {
     serial_write_byte(serial_master_buffer[i]);
     sync_recv();
-    checksum += serial_master_buffer[i];
   }
-  serial_write_byte(checksum);
-  sync_recv();
 
-  // always, release the line when not in use
-  serial_output();
-  serial_high();
+  // receive data from the slave, as much as the reply turns out to have
+  uint8_t length = 1;
+  for (uint8_t i = 0; i < length; ++i) {
+    serial_slave_buffer[i] = serial_read_byte();
+    // while the slave sends the sync
+    length = split_reply_length((const uint8_t *)serial_slave_buffer, i + 1,
+                                (const uint8_t *)serial_master_buffer);
+    sync_recv();
+  }
+
+  // always, release the line when not in use. Leave it to the pull-ups: if
+  // the reply was garbled, the slave may still be sending.
+  serial_input();
 
   sei();
   return 0;
@@ -3,6 +3,7 @@
 
 #include "config.h"
 #include <stdbool.h>
+#include "split_protocol.h"
 
 /* TODO:  some defines for interrupt setup */
 #define SERIAL_PIN_DDR DDRD
@@ -11,16 +12,16 @@
 #define SERIAL_PIN_MASK _BV(PD0)
 #define SERIAL_PIN_INTERRUPT INT0_vect
 
-#define SERIAL_SLAVE_BUFFER_LENGTH MATRIX_ROWS/2
-#define SERIAL_MASTER_BUFFER_LENGTH 1
+#define SERIAL_SLAVE_BUFFER_LENGTH SPLIT_FRAME_MAX
+#define SERIAL_MASTER_BUFFER_LENGTH SPLIT_ACK_LENGTH
 
-// Buffers for master - slave communication
+// Buffers for master - slave communication: the frame of the slave, and the
+// ack of the master (see split_protocol.h)
 extern volatile uint8_t serial_slave_buffer[SERIAL_SLAVE_BUFFER_LENGTH];
 extern volatile uint8_t serial_master_buffer[SERIAL_MASTER_BUFFER_LENGTH];
 
 void serial_master_init(void);
 void serial_slave_init(void);
 int serial_update_buffers(void);
-bool serial_slave_data_corrupt(void);
 
 #endif
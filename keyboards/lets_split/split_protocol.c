@@ -0,0 +1,149 @@
+#include <string.h>
+#include "split_protocol.h"
+
+#define FULL_MASK ((uint8_t)((1 << SPLIT_ROWS) - 1))
+
+uint8_t split_crc8(const uint8_t *data, uint8_t length) {
+  uint8_t crc = 0;
+  while (length--) {
+    crc ^= *data++;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+uint8_t split_frame_length(const uint8_t *frame) {
+  uint8_t length = SPLIT_HEADER_LENGTH + 1;
+  for (uint8_t mask = frame[2] & FULL_MASK; mask; mask &= mask - 1) {
+    length++;
+  }
+  return length;
+}
+
+bool split_ack_matches(const uint8_t *ack, uint8_t seq) {
+  return ack[0] == seq && ack[1] == (uint8_t)~seq;
+}
+
+uint8_t split_reply_length(const uint8_t *reply, uint8_t received, const uint8_t *ack) {
+  if (split_ack_matches(ack, reply[0])) {
+    return 1;
+  }
+  if (received < SPLIT_HEADER_LENGTH) {
+    return SPLIT_HEADER_LENGTH + 1;
+  }
+  return split_frame_length(reply);
+}
+
+void split_slave_init(split_slave_t *slave) {
+  memset(slave, 0, sizeof(*slave));
+  slave->seq = 1;
+}
+
+bool split_slave_update(split_slave_t *slave, const uint8_t *rows) {
+  if (memcmp(slave->rows, rows, SPLIT_ROWS) == 0) {
+    return false;
+  }
+  memcpy(slave->rows, rows, SPLIT_ROWS);
+  if (++slave->seq == SPLIT_SEQ_NEW) {
+    slave->seq = 1;
+  }
+  return true;
+}
+
+bool split_slave_ack(split_slave_t *slave, const uint8_t *ack) {
+  if (ack[1] != (uint8_t)~ack[0]) {
+    return false;
+  }
+  if (ack[0] == slave->seq) {
+    memcpy(slave->base_rows, slave->rows, SPLIT_ROWS);
+    slave->base_seq = slave->seq;
+  } else if (ack[0] != slave->base_seq) {
+    // a master that has just started, or that missed a frame
+    slave->base_seq = 0;
+  }
+  return true;
+}
+
+uint8_t split_slave_frame(const split_slave_t *slave, uint8_t *frame) {
+  uint8_t mask = FULL_MASK;
+  if (slave->base_seq) {
+    mask = 0;
+    for (uint8_t i = 0; i < SPLIT_ROWS; i++) {
+      if (slave->rows[i] != slave->base_rows[i]) {
+        mask |= 1 << i;
+      }
+    }
+  }
+
+  uint8_t *p = frame;
+  *p++ = slave->seq | (slave->base_seq == slave->seq ? 0 : SPLIT_SEQ_NEW);
+  *p++ = slave->base_seq;
+  *p++ = mask;
+  for (uint8_t i = 0; i < SPLIT_ROWS; i++) {
+    if (mask & (1 << i)) {
+      *p++ = slave->rows[i];
+    }
+  }
+  *p = split_crc8(frame, p - frame);
+  return p - frame + 1;
+}
+
+void split_master_init(split_master_t *master) {
+  memset(master, 0, sizeof(*master));
+}
+
+void split_master_ack(const split_master_t *master, uint8_t *ack) {
+  ack[0] = master->seq;
+  ack[1] = ~master->seq;
+}
+
+split_status_t split_master_receive(split_master_t *master, const uint8_t *reply, uint8_t length) {
+  if (length == 1) {
+    // nothing new
+    return reply[0] == master->seq ? SPLIT_OK : SPLIT_CORRUPT;
+  }
+  if (length < SPLIT_HEADER_LENGTH + 1 || length != split_frame_length(reply) ||
+      split_crc8(reply, length - 1) != reply[length - 1]) {
+    return SPLIT_CORRUPT;
+  }
+
+  uint8_t seq = reply[0] & ~SPLIT_SEQ_NEW;
+  if (!seq) {
+    return SPLIT_CORRUPT;
+  }
+
+  uint8_t base = reply[1];
+  uint8_t mask = reply[2];
+  const uint8_t *from;
+  if (!base) {
+    from = NULL;
+  } else if (seq == master->seq) {
+    // the state we have, sent again before the slave got the ack for it
+    return SPLIT_OK;
+  } else if (base == master->seq) {
+    from = master->rows;
+  } else if (base == master->prev_seq) {
+    from = master->prev_rows;
+  } else {
+    return SPLIT_STALE;
+  }
+
+  uint8_t rows[SPLIT_ROWS];
+  const uint8_t *row = reply + SPLIT_HEADER_LENGTH;
+  for (uint8_t i = 0; i < SPLIT_ROWS; i++) {
+    if (mask & (1 << i)) {
+      rows[i] = *row++;
+    } else {
+      rows[i] = from ? from[i] : 0;
+    }
+  }
+  if (seq != master->seq) {
+    memcpy(master->prev_rows, master->rows, SPLIT_ROWS);
+    master->prev_seq = master->seq;
+  }
+  memcpy(master->rows, rows, SPLIT_ROWS);
+  master->seq = seq;
+  return SPLIT_OK;
+}
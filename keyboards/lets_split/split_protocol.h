@@ -0,0 +1,109 @@
+#ifndef SPLIT_PROTOCOL_H
+#define SPLIT_PROTOCOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * What the halves tell each other, independent of the wire.
+ *
+ * The slave numbers the states of its rows: every time a row changes, the
+ * sequence number goes up, from 1 to 127 and around again. In every exchange
+ * the master first sends an ack, the number of the state it has, and the
+ * slave replies. If the ack is for the slave's current state, the reply is
+ * just the sequence number. Otherwise it is a frame with the rows that
+ * changed:
+ *
+ * Master to slave:  ack, ~ack
+ * Slave to master:  seq, base, mask, one byte per row in mask, crc
+ *
+ * 'base' is the state that the rows in the frame are a change to, which is
+ * the last one the master acked. A base of 0 means that the frame carries
+ * every row, which the slave sends while it doesn't know what the master
+ * has. Until the master has acked the state, 'seq' has SPLIT_SEQ_NEW set, so
+ * that the master can't mistake it for a state it has, e.g. after the slave
+ * restarted. The crc is a CRC-8 (polynomial 0x07) of the bytes before it.
+ *
+ * The slave only hears of an ack after it has built the frame for the
+ * exchange, so the master also takes changes to the state it had before.
+ * A lost or garbled exchange only costs time: the master never applies a
+ * frame that isn't based on a state it has, and the slave sends every row
+ * again once it gets an ack it can't place.
+ */
+
+#ifndef SPLIT_ROWS
+#define SPLIT_ROWS (MATRIX_ROWS/2)
+#endif
+
+#if SPLIT_ROWS > 8
+#   error "The row mask of split_protocol only has room for 8 rows"
+#endif
+
+#define SPLIT_HEADER_LENGTH 3
+#define SPLIT_FRAME_MAX     (SPLIT_HEADER_LENGTH + SPLIT_ROWS + 1)
+#define SPLIT_ACK_LENGTH    2
+
+#define SPLIT_SEQ_NEW       0x80
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SPLIT_OK,
+    SPLIT_STALE,        // a change to rows the master doesn't have
+    SPLIT_CORRUPT,      // wrong crc or length
+} split_status_t;
+
+typedef struct {
+    uint8_t rows[SPLIT_ROWS];
+    uint8_t seq;
+    // the rows that the master acked last
+    uint8_t base_rows[SPLIT_ROWS];
+    uint8_t base_seq;
+} split_slave_t;
+
+typedef struct {
+    uint8_t rows[SPLIT_ROWS];
+    uint8_t seq;
+    // the rows before, which the slave may not know yet that it has to
+    // move on from
+    uint8_t prev_rows[SPLIT_ROWS];
+    uint8_t prev_seq;
+} split_master_t;
+
+uint8_t split_crc8(const uint8_t *data, uint8_t length);
+
+/* the length of a frame, from its first SPLIT_HEADER_LENGTH bytes */
+uint8_t split_frame_length(const uint8_t *frame);
+
+/* whether 'ack' is intact and for the state that a frame starts with 'seq' */
+bool split_ack_matches(const uint8_t *ack, uint8_t seq);
+
+/*
+ * The length of the reply to 'ack' that starts with the 'received' bytes of
+ * 'reply', as far as they tell. Read bytes until it is reached.
+ */
+uint8_t split_reply_length(const uint8_t *reply, uint8_t received, const uint8_t *ack);
+
+void split_slave_init(split_slave_t *slave);
+/* takes the rows of a scan, returns whether they changed */
+bool split_slave_update(split_slave_t *slave, const uint8_t *rows);
+/* takes the ack that the master sent last, returns false if it is garbled */
+bool split_slave_ack(split_slave_t *slave, const uint8_t *ack);
+/*
+ * Writes the frame to reply with into 'frame' and returns its length. The
+ * reply is the first byte alone if split_ack_matches(ack, frame[0]).
+ */
+uint8_t split_slave_frame(const split_slave_t *slave, uint8_t *frame);
+
+void split_master_init(split_master_t *master);
+/* writes the SPLIT_ACK_LENGTH bytes to send into 'ack' */
+void split_master_ack(const split_master_t *master, uint8_t *ack);
+split_status_t split_master_receive(split_master_t *master, const uint8_t *reply, uint8_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,5 @@
+lets_split_split_protocol_DEFS := -DSPLIT_ROWS=4
+lets_split_split_protocol_INC := keyboards/lets_split
+lets_split_split_protocol_SRC := \
+	keyboards/lets_split/tests/split_protocol_tests.cpp \
+	keyboards/lets_split/split_protocol.c
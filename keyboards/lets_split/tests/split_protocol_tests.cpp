@@ -0,0 +1,306 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+#include "split_protocol.h"
+
+// Stands in for the serial line between the halves, and for the two ends of
+// it in serial.c: the master sends its ack, and the interrupt of the slave
+// replies with what the slave loop left in its buffer.
+namespace {
+struct Loopback {
+    split_master_t master;
+    split_slave_t slave;
+    // the buffers that the slave shares with its interrupt
+    uint8_t frame[SPLIT_FRAME_MAX];
+    uint8_t ack[SPLIT_ACK_LENGTH];
+
+    uint32_t bytes = 0;
+    // flips a bit of this byte of the next exchange, counting from the ack
+    int corrupt = -1;
+    int position;
+
+    // the states the slave went through, by sequence number
+    std::map<uint8_t, std::vector<uint8_t>> states;
+
+    Loopback() {
+        split_master_init(&master);
+        split_slave_init(&slave);
+        memset(ack, 0, sizeof(ack));
+        uint8_t rows[SPLIT_ROWS] = {0};
+        scan(rows);
+    }
+
+    // like matrix_slave_scan()
+    void scan(const uint8_t *rows) {
+        split_slave_ack(&slave, ack);
+        split_slave_update(&slave, rows);
+        split_slave_frame(&slave, frame);
+        states[slave.seq] = std::vector<uint8_t>(slave.rows, slave.rows + SPLIT_ROWS);
+    }
+
+    uint8_t wire(uint8_t byte) {
+        if (position++ == corrupt) {
+            byte ^= 0x10;
+            corrupt = -1;
+        }
+        bytes++;
+        return byte;
+    }
+
+    // like serial_transaction()
+    split_status_t exchange() {
+        uint8_t sent[SPLIT_ACK_LENGTH];
+        split_master_ack(&master, sent);
+        position = 0;
+        for (uint8_t i = 0; i < SPLIT_ACK_LENGTH; i++) {
+            ack[i] = wire(sent[i]);
+        }
+
+        uint8_t length = split_frame_length(frame);
+        if (split_ack_matches(ack, frame[0])) {
+            length = 1;
+        }
+
+        uint8_t reply[SPLIT_FRAME_MAX];
+        uint8_t expected = 1;
+        for (uint8_t i = 0; i < expected; i++) {
+            // the pull-ups, once the slave is done
+            reply[i] = i < length ? wire(frame[i]) : 0xFF;
+            expected = split_reply_length(reply, i + 1, sent);
+        }
+        for (uint8_t i = expected; i < length; i++) {
+            wire(frame[i]);
+        }
+
+        split_status_t status = split_master_receive(&master, reply, expected);
+        if (status == SPLIT_OK) {
+            EXPECT_EQ(std::vector<uint8_t>(master.rows, master.rows + SPLIT_ROWS), states[master.seq])
+                << "the master has rows the slave never had";
+        }
+        return status;
+    }
+
+    bool in_sync() {
+        return memcmp(master.rows, slave.rows, SPLIT_ROWS) == 0;
+    }
+
+    uint32_t exchange_bytes() {
+        uint32_t before = bytes;
+        exchange();
+        return bytes - before;
+    }
+};
+}
+
+class LetsSplitSplitProtocol : public testing::Test {
+public:
+    LetsSplitSplitProtocol() {
+        memset(rows, 0, sizeof(rows));
+    }
+
+    // both halves scan, and the master asks the slave
+    split_status_t scan() {
+        wire.scan(rows);
+        return wire.exchange();
+    }
+
+    Loopback wire;
+    uint8_t rows[SPLIT_ROWS];
+};
+
+TEST_F(LetsSplitSplitProtocol, TheFirstFrameHasEveryRow) {
+    rows[0] = 0x01;
+    rows[3] = 0x20;
+    wire.scan(rows);
+    EXPECT_EQ(wire.exchange_bytes(), SPLIT_ACK_LENGTH + SPLIT_FRAME_MAX);
+    EXPECT_TRUE(wire.in_sync());
+}
+
+TEST_F(LetsSplitSplitProtocol, NothingNewIsASingleByte) {
+    scan();
+    scan();
+    for (int i = 0; i < 10; i++) {
+        wire.scan(rows);
+        EXPECT_EQ(wire.exchange_bytes(), SPLIT_ACK_LENGTH + 1u);
+        EXPECT_TRUE(wire.in_sync());
+    }
+}
+
+TEST_F(LetsSplitSplitProtocol, AChangeSendsOnlyTheRowsThatChanged) {
+    scan();
+    scan();
+    rows[2] = 0x04;
+    wire.scan(rows);
+    EXPECT_EQ(wire.exchange_bytes(), SPLIT_ACK_LENGTH + SPLIT_HEADER_LENGTH + 1 + 1u);
+    EXPECT_TRUE(wire.in_sync());
+    // the slave gets the ack for it with the next exchange
+    scan();
+    scan();
+
+    rows[0] = 0x01;
+    rows[1] = 0x02;
+    wire.scan(rows);
+    EXPECT_EQ(wire.exchange_bytes(), SPLIT_ACK_LENGTH + SPLIT_HEADER_LENGTH + 2 + 1u);
+    EXPECT_TRUE(wire.in_sync());
+    scan();
+
+    wire.scan(rows);
+    EXPECT_EQ(wire.exchange_bytes(), SPLIT_ACK_LENGTH + 1u);
+}
+
+TEST_F(LetsSplitSplitProtocol, ChangesInEveryExchange) {
+    scan();
+    scan();
+    for (int i = 0; i < 20; i++) {
+        rows[i % SPLIT_ROWS] ^= 1 << (i % 6);
+        EXPECT_EQ(scan(), SPLIT_OK);
+        EXPECT_TRUE(wire.in_sync());
+    }
+}
+
+TEST_F(LetsSplitSplitProtocol, SeveralChangesBetweenExchanges) {
+    scan();
+    scan();
+    rows[0] = 0x01;
+    wire.scan(rows);
+    rows[0] = 0x00;
+    rows[1] = 0x01;
+    wire.scan(rows);
+    EXPECT_EQ(wire.exchange(), SPLIT_OK);
+    EXPECT_TRUE(wire.in_sync());
+}
+
+TEST_F(LetsSplitSplitProtocol, AGarbledFrameIsNotUsed) {
+    scan();
+    scan();
+    rows[1] = 0x3F;
+    wire.scan(rows);
+    // the row itself
+    wire.corrupt = SPLIT_ACK_LENGTH + SPLIT_HEADER_LENGTH;
+    EXPECT_EQ(wire.exchange(), SPLIT_CORRUPT);
+    EXPECT_EQ(wire.master.rows[1], 0);
+
+    EXPECT_EQ(scan(), SPLIT_OK);
+    EXPECT_TRUE(wire.in_sync());
+}
+
+TEST_F(LetsSplitSplitProtocol, AGarbledLengthIsNotUsed) {
+    scan();
+    scan();
+    rows[1] = 0x3F;
+    wire.scan(rows);
+    // the mask
+    wire.corrupt = SPLIT_ACK_LENGTH + 2;
+    EXPECT_EQ(wire.exchange(), SPLIT_CORRUPT);
+    EXPECT_EQ(scan(), SPLIT_OK);
+    EXPECT_TRUE(wire.in_sync());
+}
+
+TEST_F(LetsSplitSplitProtocol, AGarbledAckIsIgnored) {
+    scan();
+    scan();
+    rows[1] = 0x3F;
+    wire.scan(rows);
+    wire.corrupt = 0;
+    EXPECT_EQ(wire.exchange(), SPLIT_OK);
+    EXPECT_TRUE(wire.in_sync());
+
+    EXPECT_EQ(scan(), SPLIT_OK);
+    EXPECT_TRUE(wire.in_sync());
+    wire.scan(rows);
+    EXPECT_EQ(wire.exchange_bytes(), SPLIT_ACK_LENGTH + 1u);
+}
+
+TEST_F(LetsSplitSplitProtocol, AnAckItCantPlaceCostsAFullFrame) {
+    scan();
+    scan();
+    wire.master.seq = 0x55;
+    EXPECT_EQ(scan(), SPLIT_STALE);
+    wire.scan(rows);
+    EXPECT_EQ(wire.slave.base_seq, 0);
+    EXPECT_EQ(wire.exchange_bytes(), SPLIT_ACK_LENGTH + SPLIT_FRAME_MAX);
+    EXPECT_TRUE(wire.in_sync());
+}
+
+TEST_F(LetsSplitSplitProtocol, ARestartedMasterGetsEveryRow) {
+    rows[0] = 0x01;
+    scan();
+    scan();
+    split_master_init(&wire.master);
+    EXPECT_EQ(scan(), SPLIT_STALE);
+    EXPECT_EQ(scan(), SPLIT_OK);
+    EXPECT_TRUE(wire.in_sync());
+}
+
+TEST_F(LetsSplitSplitProtocol, ARestartedSlaveSendsEveryRow) {
+    rows[0] = 0x01;
+    scan();
+    scan();
+    split_slave_init(&wire.slave);
+    wire.states.clear();
+    rows[0] = 0x00;
+    rows[2] = 0x08;
+    EXPECT_EQ(scan(), SPLIT_OK);
+    EXPECT_TRUE(wire.in_sync());
+}
+
+TEST_F(LetsSplitSplitProtocol, CatchesUpWithANoisyLine) {
+    srand(1);
+    for (int i = 0; i < 5000; i++) {
+        if (rand() % 3 == 0) {
+            rows[rand() % SPLIT_ROWS] ^= 1 << (rand() % 6);
+        }
+        wire.scan(rows);
+        if (rand() % 4 == 0) {
+            wire.scan(rows);
+            continue;
+        }
+        if (rand() % 10 == 0) {
+            wire.corrupt = rand() % (SPLIT_ACK_LENGTH + SPLIT_FRAME_MAX);
+        }
+        wire.exchange();
+    }
+    wire.corrupt = -1;
+    for (int i = 0; i < 3; i++) {
+        scan();
+    }
+    EXPECT_TRUE(wire.in_sync());
+}
+
+TEST_F(LetsSplitSplitProtocol, SendsFewerBytesThanEveryRowEachScan) {
+    // what an exchange used to be: every row and a sum from the slave, and a
+    // byte and a sum from the master
+    const uint32_t old_bytes = SPLIT_ROWS + 1 + 1 + 1;
+
+    scan();
+    scan();
+    const int scans = 1000;
+    uint32_t before = wire.bytes;
+    srand(1);
+    for (int i = 0; i < scans; i++) {
+        // a key pressed or released every 20 scans or so
+        if (rand() % 20 == 0) {
+            rows[rand() % SPLIT_ROWS] ^= 1 << (rand() % 6);
+        }
+        scan();
+    }
+    double bytes = (double)(wire.bytes - before) / scans;
+    EXPECT_LT(bytes, old_bytes);
+}
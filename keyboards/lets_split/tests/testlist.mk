@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	lets_split_split_protocol
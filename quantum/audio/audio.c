@@ -24,13 +24,12 @@
 #endif
 #include "print.h"
 #include "audio.h"
+#include "audio_synth.h"
 #include "keymap.h"
 #include "wait.h"
 
 #include "eeconfig.h"
 
-#define CPU_PRESCALER 8
-
 // -----------------------------------------------------------------------------
 // Timer Abstractions
 // -----------------------------------------------------------------------------
@@ -78,12 +77,12 @@
 
 int voices = 0;
 int voice_place = 0;
-float frequency = 0;
-float frequency_alt = 0;
 int volume = 0;
 long position = 0;
 
 float frequencies[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+// the timer periods of the frequencies, worked out once per note
+static uint16_t periods[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 int volumes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
 bool sliding = false;
 
@@ -94,23 +93,32 @@ uint16_t sample_length = 0;
 
 bool     playing_notes = false;
 bool     playing_note = false;
-float    note_frequency = 0;
-float    note_length = 0;
 uint8_t  note_tempo = TEMPO_DEFAULT;
 float    note_timbre = TIMBRE_DEFAULT;
-uint16_t note_position = 0;
-float (* notes_pointer)[][2];
-uint16_t notes_count;
-bool     notes_repeat;
-bool     note_resting = false;
+__attribute__ ((unused))
+static uint8_t timbre = SYNTH_TIMBRE(TIMBRE_DEFAULT);
+static synth_song_t song;
 
-uint8_t current_note = 0;
 uint8_t rest_counter = 0;
 
+static synth_glide_t glide;
+static synth_glide_t glide_alt;
+
+// the second voice on B5 has a vibrato of its own
+__attribute__ ((unused))
+static synth_vibrato_t vibrato = {.rate = 0.125};
+__attribute__ ((unused))
+static synth_vibrato_t vibrato_alt = {.rate = 0.125};
+
 #ifdef VIBRATO_ENABLE
-float vibrato_counter = 0;
 float vibrato_strength = .5;
 float vibrato_rate = 0.125;
+// vibrato_strength as a fraction of 256
+#ifdef VIBRATO_STRENGTH_ENABLE
+static uint16_t vibrato_depth = .5 * 256;
+#else
+static uint16_t vibrato_depth = 256;
+#endif
 #endif
 
 float polyphony_rate = 0;
@@ -122,6 +130,9 @@ audio_config_t audio_config;
 uint16_t envelope_index = 0;
 bool glissando = true;
 
+// this is imported from voices.c
+extern voice_type voice;
+
 #ifndef STARTUP_SONG
     #define STARTUP_SONG SONG(STARTUP_SOUND)
 #endif
@@ -217,13 +228,14 @@ void stop_all_notes()
 
     playing_notes = false;
     playing_note = false;
-    frequency = 0;
-    frequency_alt = 0;
+    glide.period = 0;
+    glide_alt.period = 0;
     volume = 0;
 
     for (uint8_t i = 0; i < 8; i++)
     {
         frequencies[i] = 0;
+        periods[i] = 0;
         volumes[i] = 0;
     }
 }
@@ -239,10 +251,13 @@ void stop_note(float freq)
         for (int i = 7; i >= 0; i--) {
             if (frequencies[i] == freq) {
                 frequencies[i] = 0;
+                periods[i] = 0;
                 volumes[i] = 0;
                 for (int j = i; (j < 7); j++) {
                     frequencies[j] = frequencies[j+1];
                     frequencies[j+1] = 0;
+                    periods[j] = periods[j+1];
+                    periods[j+1] = 0;
                     volumes[j] = volumes[j+1];
                     volumes[j+1] = 0;
                 }
@@ -264,30 +279,103 @@ void stop_note(float freq)
                 DISABLE_AUDIO_COUNTER_1_ISR;
                 DISABLE_AUDIO_COUNTER_1_OUTPUT;
             #endif
-            frequency = 0;
-            frequency_alt = 0;
+            glide.period = 0;
+            glide_alt.period = 0;
             volume = 0;
             playing_note = false;
         }
     }
 }
 
-#ifdef VIBRATO_ENABLE
+#if defined(C6_AUDIO) || defined(B5_AUDIO)
 
-float mod(float a, int b)
-{
-    float r = fmod(a, b);
-    return r < 0 ? r + b : r;
+// The interrupts only work with timer periods, see audio_synth.h
+
+static uint16_t glide_to(synth_glide_t *from, uint16_t target) {
+    if (!glissando) {
+        from->period = 0;
+    }
+    return synth_glide(from, target);
+}
+
+static uint16_t vibrate(synth_vibrato_t *state, uint16_t period, uint16_t note) {
+    #ifdef VIBRATO_ENABLE
+        if (vibrato_depth > 0) {
+            return synth_vibrato(state, period, note, vibrato_depth);
+        }
+    #endif
+    return period;
 }
 
-float vibrato(float average_freq) {
-    #ifdef VIBRATO_STRENGTH_ENABLE
-        float vibrated_freq = average_freq * pow(vibrato_lut[(int)vibrato_counter], vibrato_strength);
-    #else
-        float vibrated_freq = average_freq * vibrato_lut[(int)vibrato_counter];
+static uint16_t envelope(uint16_t period) {
+    if (envelope_index < 65535) {
+        envelope_index++;
+    }
+
+    #ifdef AUDIO_VOICES
+        // the other voices work in floats
+        if (voice != default_voice) {
+            float freq = voice_envelope(((float)SYNTH_CLOCK) / period);
+            timbre = SYNTH_TIMBRE(note_timbre);
+            return synth_period(freq < 30.52 ? 30.52 : freq);
+        }
     #endif
-    vibrato_counter = mod((vibrato_counter + vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
-    return vibrated_freq;
+
+    // what voice_envelope() does for default_voice
+    glissando = false;
+    polyphony_rate = 0;
+    note_timbre = TIMBRE_50;
+    timbre = SYNTH_TIMBRE(TIMBRE_50);
+    return period;
+}
+
+static uint16_t voice_period(void) {
+    uint16_t period;
+    if (polyphony_rate > 0) {
+        if (voices > 1) {
+            voice_place %= voices;
+            if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
+                voice_place = (voice_place + 1) % voices;
+                place = 0.0;
+            }
+        }
+        period = vibrate(&vibrato, periods[voice_place], periods[voice_place]);
+    } else {
+        uint16_t target = periods[voices - 1];
+        period = vibrate(&vibrato, glide_to(&glide, target), target);
+    }
+    return envelope(period);
+}
+
+#if defined(C6_AUDIO) && defined(B5_AUDIO)
+static uint16_t alt_voice_period(void) {
+    uint16_t period = SYNTH_PERIOD_MAX;
+    if (polyphony_rate == 0) {
+        uint16_t target = periods[voices - 2];
+        period = vibrate(&vibrato_alt, glide_to(&glide_alt, target), target);
+    }
+    return envelope(period);
+}
+#endif
+
+// the period of the song for this interrupt, 0 for silence
+static uint16_t song_period(void) {
+    if (song.period > 0) {
+        return envelope(vibrate(&vibrato, song.period, song.period));
+    }
+    return 0;
+}
+
+// returns false at the end of the song
+static bool song_next(uint16_t period) {
+    if (!synth_song_next(&song, period, note_tempo)) {
+        playing_notes = false;
+        return false;
+    }
+    if (!song.resting && song.position == 0) {
+        envelope_index = 0;
+    }
+    return true;
 }
 
 #endif
@@ -295,175 +383,34 @@ float vibrato(float average_freq) {
 #ifdef C6_AUDIO
 ISR(TIMER3_COMPA_vect)
 {
-    float freq;
+    uint16_t period;
 
     if (playing_note) {
         if (voices > 0) {
 
             #ifdef B5_AUDIO
-            float freq_alt = 0;
                 if (voices > 1) {
-                    if (polyphony_rate == 0) {
-                        if (glissando) {
-                            if (frequency_alt != 0 && frequency_alt < frequencies[voices - 2] && frequency_alt < frequencies[voices - 2] * pow(2, -440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, 440/frequency_alt/12/2);
-                            } else if (frequency_alt != 0 && frequency_alt > frequencies[voices - 2] && frequency_alt > frequencies[voices - 2] * pow(2, 440/frequencies[voices - 2]/12/2)) {
-                                frequency_alt = frequency_alt * pow(2, -440/frequency_alt/12/2);
-                            } else {
-                                frequency_alt = frequencies[voices - 2];
-                            }
-                        } else {
-                            frequency_alt = frequencies[voices - 2];
-                        }
-
-                        #ifdef VIBRATO_ENABLE
-                            if (vibrato_strength > 0) {
-                                freq_alt = vibrato(frequency_alt);
-                            } else {
-                                freq_alt = frequency_alt;
-                            }
-                        #else
-                            freq_alt = frequency_alt;
-                        #endif
-                    }
-
-                    if (envelope_index < 65535) {
-                        envelope_index++;
-                    }
-
-                    freq_alt = voice_envelope(freq_alt);
-
-                    if (freq_alt < 30.517578125) {
-                        freq_alt = 30.52;
-                    }
-
-                    TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq_alt * CPU_PRESCALER));
-                    TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq_alt * CPU_PRESCALER)) * note_timbre);
+                    period = alt_voice_period();
+                    TIMER_1_PERIOD = period;
+                    TIMER_1_DUTY_CYCLE = synth_duty(period, timbre);
                 }
             #endif
 
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
-            } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
-            }
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-
-            freq = voice_envelope(freq);
-
-            if (freq < 30.517578125) {
-                freq = 30.52;
-            }
-
-            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+            period = voice_period();
+            TIMER_3_PERIOD = period;
+            TIMER_3_DUTY_CYCLE = synth_duty(period, timbre);
         }
     }
 
     if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
-
-            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
-        } else {
-            TIMER_3_PERIOD = 0;
-            TIMER_3_DUTY_CYCLE = 0;
-        }
-
-        note_position++;
-        bool end_of_note = false;
-        if (TIMER_3_PERIOD > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length / TIMER_3_PERIOD * 0xFFFF - 1));
-            else
-                end_of_note = (note_position >= (note_length));
-        } else {
-            end_of_note = (note_position >= (note_length));
-        }
-
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    DISABLE_AUDIO_COUNTER_3_ISR;
-                    DISABLE_AUDIO_COUNTER_3_OUTPUT;
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
+        period = song_period();
+        TIMER_3_PERIOD = period;
+        TIMER_3_DUTY_CYCLE = synth_duty(period, timbre);
 
-            note_position = 0;
+        if (!song_next(period)) {
+            DISABLE_AUDIO_COUNTER_3_ISR;
+            DISABLE_AUDIO_COUNTER_3_OUTPUT;
+            return;
         }
     }
 
@@ -478,132 +425,25 @@ ISR(TIMER3_COMPA_vect)
 ISR(TIMER1_COMPA_vect)
 {
     #if defined(B5_AUDIO) && !defined(C6_AUDIO)
-    float freq = 0;
+    uint16_t period;
 
     if (playing_note) {
         if (voices > 0) {
-            if (polyphony_rate > 0) {
-                if (voices > 1) {
-                    voice_place %= voices;
-                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
-                        voice_place = (voice_place + 1) % voices;
-                        place = 0.0;
-                    }
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequencies[voice_place]);
-                    } else {
-                        freq = frequencies[voice_place];
-                    }
-                #else
-                    freq = frequencies[voice_place];
-                #endif
-            } else {
-                if (glissando) {
-                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, 440/frequency/12/2);
-                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
-                        frequency = frequency * pow(2, -440/frequency/12/2);
-                    } else {
-                        frequency = frequencies[voices - 1];
-                    }
-                } else {
-                    frequency = frequencies[voices - 1];
-                }
-
-                #ifdef VIBRATO_ENABLE
-                    if (vibrato_strength > 0) {
-                        freq = vibrato(frequency);
-                    } else {
-                        freq = frequency;
-                    }
-                #else
-                    freq = frequency;
-                #endif
-            }
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-
-            freq = voice_envelope(freq);
-
-            if (freq < 30.517578125) {
-                freq = 30.52;
-            }
-
-            TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+            period = voice_period();
+            TIMER_1_PERIOD = period;
+            TIMER_1_DUTY_CYCLE = synth_duty(period, timbre);
         }
     }
 
     if (playing_notes) {
-        if (note_frequency > 0) {
-            #ifdef VIBRATO_ENABLE
-                if (vibrato_strength > 0) {
-                    freq = vibrato(note_frequency);
-                } else {
-                    freq = note_frequency;
-                }
-            #else
-                    freq = note_frequency;
-            #endif
-
-            if (envelope_index < 65535) {
-                envelope_index++;
-            }
-            freq = voice_envelope(freq);
-
-            TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
-            TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
-        } else {
-            TIMER_1_PERIOD = 0;
-            TIMER_1_DUTY_CYCLE = 0;
-        }
+        period = song_period();
+        TIMER_1_PERIOD = period;
+        TIMER_1_DUTY_CYCLE = synth_duty(period, timbre);
 
-        note_position++;
-        bool end_of_note = false;
-        if (TIMER_1_PERIOD > 0) {
-            if (!note_resting) 
-                end_of_note = (note_position >= (note_length / TIMER_1_PERIOD * 0xFFFF - 1));
-            else
-                end_of_note = (note_position >= (note_length));
-        } else {
-            end_of_note = (note_position >= (note_length));
-        }
-
-        if (end_of_note) {
-            current_note++;
-            if (current_note >= notes_count) {
-                if (notes_repeat) {
-                    current_note = 0;
-                } else {
-                    DISABLE_AUDIO_COUNTER_1_ISR;
-                    DISABLE_AUDIO_COUNTER_1_OUTPUT;
-                    playing_notes = false;
-                    return;
-                }
-            }
-            if (!note_resting) {
-                note_resting = true;
-                current_note--;
-                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
-                    note_frequency = 0;
-                    note_length = 1;
-                } else {
-                    note_frequency = (*notes_pointer)[current_note][0];
-                    note_length = 1;
-                }
-            } else {
-                note_resting = false;
-                envelope_index = 0;
-                note_frequency = (*notes_pointer)[current_note][0];
-                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-            }
-
-            note_position = 0;
+        if (!song_next(period)) {
+            DISABLE_AUDIO_COUNTER_1_ISR;
+            DISABLE_AUDIO_COUNTER_1_OUTPUT;
+            return;
         }
     }
 
@@ -641,6 +481,7 @@ void play_note(float freq, int vol) {
 
         if (freq > 0) {
             frequencies[voices] = freq;
+            periods[voices] = synth_period(freq);
             volumes[voices] = vol;
             voices++;
         }
@@ -686,16 +527,8 @@ void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
 
         playing_notes = true;
 
-        notes_pointer = np;
-        notes_count = n_count;
-        notes_repeat = n_repeat;
-
         place = 0;
-        current_note = 0;
-
-        note_frequency = (*notes_pointer)[current_note][0];
-        note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
-        note_position = 0;
+        synth_song_start(&song, np, n_count, n_repeat, note_tempo);
 
 
         #ifdef C6_AUDIO
@@ -748,28 +581,36 @@ void audio_off(void) {
 
 void set_vibrato_rate(float rate) {
     vibrato_rate = rate;
+    synth_vibrato_rate(&vibrato, vibrato_rate);
+    synth_vibrato_rate(&vibrato_alt, vibrato_rate);
 }
 
 void increase_vibrato_rate(float change) {
-    vibrato_rate *= change;
+    set_vibrato_rate(vibrato_rate * change);
 }
 
 void decrease_vibrato_rate(float change) {
-    vibrato_rate /= change;
+    set_vibrato_rate(vibrato_rate / change);
 }
 
 #ifdef VIBRATO_STRENGTH_ENABLE
 
 void set_vibrato_strength(float strength) {
     vibrato_strength = strength;
+    // the depth of the table times 256, up to 4 times
+    if (vibrato_strength <= 0) {
+        vibrato_depth = 0;
+    } else {
+        vibrato_depth = vibrato_strength < 4 ? vibrato_strength * 256 : 4 * 256;
+    }
 }
 
 void increase_vibrato_strength(float change) {
-    vibrato_strength *= change;
+    set_vibrato_strength(vibrato_strength * change);
 }
 
 void decrease_vibrato_strength(float change) {
-    vibrato_strength /= change;
+    set_vibrato_strength(vibrato_strength / change);
 }
 
 #endif  /* VIBRATO_STRENGTH_ENABLE */
@@ -33,7 +33,7 @@
 
 // #define VIBRATO_ENABLE
 
-// Enable vibrato strength/amplitude - slows down ISR too much
+// Enable vibrato strength/amplitude
 // #define VIBRATO_STRENGTH_ENABLE
 
 typedef union {
@@ -0,0 +1,207 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "audio_synth.h"
+#include <math.h>
+#include "progmem.h"
+
+// 2^(-i/64) as a fraction of 32768, for an octave
+static const uint16_t exp2_lut[65] PROGMEM = {
+    32768, 32415, 32066, 31720, 31379, 31041, 30706, 30376,
+    30048, 29725, 29405, 29088, 28774, 28464, 28158, 27855,
+    27554, 27258, 26964, 26674, 26386, 26102, 25821, 25543,
+    25268, 24995, 24726, 24460, 24196, 23936, 23678, 23423,
+    23170, 22921, 22674, 22430, 22188, 21949, 21713, 21479,
+    21247, 21019, 20792, 20568, 20347, 20127, 19911, 19696,
+    19484, 19274, 19066, 18861, 18658, 18457, 18258, 18061,
+    17867, 17674, 17484, 17296, 17109, 16925, 16743, 16562,
+    16384,
+};
+
+// 65536 * (1 / vibrato_lut[i] - 1): how much the period changes with the
+// frequency
+static const int16_t vibrato_period_lut[SYNTH_VIBRATO_LENGTH] PROGMEM = {
+    -146, -278, -382, -448, -471, -448, -382, -278, -146, 0,
+     146,  279,  384,  452,  475,  452,  384,  279,  146, 0,
+};
+
+// the step of the glissando is 440 / (24 * frequency) octaves, which is
+// the period times this, in 1/4096 of SYNTH_OCTAVE
+#define GLIDE_FACTOR ((uint32_t)(440.0 * SYNTH_OCTAVE / 24 * 4096 / SYNTH_CLOCK + 0.5))
+
+uint16_t synth_period(float frequency) {
+    if (frequency <= 0) {
+        return 0;
+    }
+    float period = ((float)F_CPU) / (frequency * CPU_PRESCALER);
+    if (period >= SYNTH_PERIOD_MAX) {
+        return SYNTH_PERIOD_MAX;
+    }
+    return period;
+}
+
+uint16_t synth_scale(uint16_t period, int32_t exponent) {
+    uint32_t scaled = period;
+    while (exponent < 0) {
+        if (scaled > SYNTH_PERIOD_MAX) {
+            return SYNTH_PERIOD_MAX;
+        }
+        scaled <<= 1;
+        exponent += SYNTH_OCTAVE;
+    }
+
+    uint8_t octaves = exponent / SYNTH_OCTAVE;
+    if (octaves > 16) {
+        return 0;
+    }
+    uint16_t fraction = exponent % SYNTH_OCTAVE;
+    uint8_t i = fraction >> 10;
+    uint16_t a = pgm_read_word(&exp2_lut[i]);
+    uint16_t b = pgm_read_word(&exp2_lut[i + 1]);
+    uint16_t factor = a - (((uint32_t)(a - b) * (fraction & 1023)) >> 10);
+
+    uint8_t shift = 15 + octaves;
+    scaled = (scaled * factor + ((uint32_t)1 << (shift - 1))) >> shift;
+    return scaled > SYNTH_PERIOD_MAX ? SYNTH_PERIOD_MAX : scaled;
+}
+
+int32_t synth_pitch(uint16_t period) {
+    return log((float)SYNTH_PERIOD_MAX / period) * (SYNTH_OCTAVE / M_LN2) + 0.5;
+}
+
+uint16_t synth_duty(uint16_t period, uint8_t timbre) {
+    return ((uint32_t)period * timbre) >> 8;
+}
+
+static int32_t glide_step(uint16_t period) {
+    return ((uint32_t)period * GLIDE_FACTOR + 0x800) >> 12;
+}
+
+uint16_t synth_glide(synth_glide_t *glide, uint16_t target) {
+    if (target != glide->target) {
+        // once per note
+        glide->target = target;
+        glide->target_pitch = synth_pitch(target);
+    }
+
+    if (glide->period) {
+        int32_t step = glide_step(target);
+        if (glide->pitch + step < glide->target_pitch) {
+            glide->pitch += glide_step(glide->period);
+            glide->period = synth_scale(SYNTH_PERIOD_MAX, glide->pitch);
+            return glide->period;
+        }
+        if (glide->pitch > glide->target_pitch + step) {
+            glide->pitch -= glide_step(glide->period);
+            glide->period = synth_scale(SYNTH_PERIOD_MAX, glide->pitch);
+            return glide->period;
+        }
+    }
+    glide->pitch = glide->target_pitch;
+    glide->period = target;
+    return target;
+}
+
+void synth_vibrato_rate(synth_vibrato_t *vibrato, float rate) {
+    vibrato->rate = rate;
+    vibrato->note = 0;
+}
+
+uint16_t synth_vibrato(synth_vibrato_t *vibrato, uint16_t period, uint16_t note, uint16_t strength) {
+    if (note != vibrato->note) {
+        // faster for lower notes, once per note. The period is rounded down
+        // from the frequency, half a count is closer on average.
+        vibrato->note = note;
+        vibrato->increment = vibrato->rate * (1 + 440.0 * (note + 0.5) / SYNTH_CLOCK) * 65536 + 0.5;
+    }
+
+    int16_t change = pgm_read_word(&vibrato_period_lut[vibrato->phase >> 16]);
+    int32_t vibrated = period + ((((int32_t)period * change) >> 8) * strength >> 16);
+
+    vibrato->phase += vibrato->increment;
+    while (vibrato->phase >= ((uint32_t)SYNTH_VIBRATO_LENGTH << 16)) {
+        vibrato->phase -= (uint32_t)SYNTH_VIBRATO_LENGTH << 16;
+    }
+
+    if (vibrated > SYNTH_PERIOD_MAX) {
+        return SYNTH_PERIOD_MAX;
+    }
+    return vibrated;
+}
+
+void synth_note_length(synth_length_t *length, float duration) {
+    // rounded up, as the interrupts compared with the float
+    float scaled = duration * 0xFFFF;
+    length->scaled = scaled;
+    if (length->scaled < scaled) {
+        length->scaled++;
+    }
+    length->count = duration;
+    if (length->count < duration) {
+        length->count++;
+    }
+}
+
+bool synth_note_done(const synth_length_t *length, uint16_t position, uint16_t period) {
+    if (period) {
+        // position >= length / period * 0xFFFF - 1
+        return ((uint32_t)position + 1) * period >= length->scaled;
+    }
+    return position >= length->count;
+}
+
+static void start_note(synth_song_t *song, uint8_t tempo) {
+    song->period = synth_period((*song->notes)[song->current][0]);
+    synth_note_length(&song->length, ((*song->notes)[song->current][1] / 4) * (((float)tempo) / 100));
+}
+
+void synth_song_start(synth_song_t *song, float (*notes)[][2], uint16_t count, bool repeat, uint8_t tempo) {
+    song->notes = notes;
+    song->count = count;
+    song->repeat = repeat;
+    song->current = 0;
+    song->resting = false;
+    song->position = 0;
+    start_note(song, tempo);
+}
+
+bool synth_song_next(synth_song_t *song, uint16_t period, uint8_t tempo) {
+    song->position++;
+    if (!synth_note_done(&song->length, song->position, song->resting ? 0 : period)) {
+        return true;
+    }
+
+    uint16_t next = song->current + 1;
+    if (next >= song->count) {
+        if (!song->repeat) {
+            return false;
+        }
+        next = 0;
+    }
+
+    if (!song->resting) {
+        // an interrupt between the notes, silent if the next one is the same
+        song->resting = true;
+        if ((*song->notes)[song->current][0] == (*song->notes)[next][0]) {
+            song->period = 0;
+        }
+        synth_note_length(&song->length, 1);
+    } else {
+        song->resting = false;
+        song->current = next;
+        start_note(song, tempo);
+    }
+    song->position = 0;
+    return true;
+}
@@ -0,0 +1,126 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef AUDIO_SYNTH_H
+#define AUDIO_SYNTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * What the timer interrupts of audio.c compute, in integers.
+ *
+ * A note is kept as the period of the timer that plays it. The float math,
+ * turning a frequency into a period and a duration into a length, happens
+ * once when a note starts. Glissando and vibrato then only scale the period,
+ * and the end of a note is a multiplication and a compare.
+ */
+
+// the timers run at F_CPU / CPU_PRESCALER
+#define CPU_PRESCALER 8
+#define SYNTH_CLOCK (F_CPU / CPU_PRESCALER)
+
+// the period of the lowest note, 30.52 Hz
+#define SYNTH_PERIOD_MAX ((uint16_t)(SYNTH_CLOCK / 30.52 < 0xFFFF ? SYNTH_CLOCK / 30.52 : 0xFFFF))
+
+// exponents and pitches are in 1/SYNTH_OCTAVE of an octave
+#define SYNTH_OCTAVE 65536L
+
+// the entries of the vibrato, as vibrato_lut in luts.c
+#define SYNTH_VIBRATO_LENGTH 20
+
+// a timbre (0 to 1) as a fraction of 256
+#define SYNTH_TIMBRE(timbre) ((uint8_t)((timbre) < 1 ? (timbre) * 256 : 255))
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t phase;      // the entry of the vibrato, in 1/65536
+    uint32_t increment;  // of the phase per interrupt
+    uint16_t note;       // the period the increment is for
+    float rate;
+} synth_vibrato_t;
+
+typedef struct {
+    uint16_t period;     // where the glissando is, 0 before it starts
+    int32_t pitch;       // of the period
+    uint16_t target;
+    int32_t target_pitch;
+} synth_glide_t;
+
+typedef struct {
+    uint32_t scaled;     // the length times 0xFFFF, for notes
+    uint16_t count;      // the length in interrupts, for rests
+} synth_length_t;
+
+typedef struct {
+    float (*notes)[][2];
+    uint16_t count;
+    bool repeat;
+    uint16_t current;
+    bool resting;        // in the pause after a note
+    uint16_t position;   // interrupts since the note started
+    uint16_t period;     // of the note, 0 for a rest
+    synth_length_t length;
+} synth_song_t;
+
+/* The period for 'frequency', 0 for no sound. Not for the interrupts. */
+uint16_t synth_period(float frequency);
+
+/* period * 2^(-exponent / SYNTH_OCTAVE), at most SYNTH_PERIOD_MAX */
+uint16_t synth_scale(uint16_t period, int32_t exponent);
+
+/*
+ * How much higher than SYNTH_PERIOD_MAX a period is, the exponent that
+ * synth_scale() takes. Not for the interrupts.
+ */
+int32_t synth_pitch(uint16_t period);
+
+/* The duty cycle of a period, timbre as by SYNTH_TIMBRE() */
+uint16_t synth_duty(uint16_t period, uint8_t timbre);
+
+/*
+ * One interrupt of glissando towards 'target', returns the period to play.
+ * Steps are a 24th of an octave at 440 Hz, more below and less above. They
+ * add up in pitch, so that the rounding of the periods doesn't.
+ */
+uint16_t synth_glide(synth_glide_t *glide, uint16_t target);
+
+/* Sets how fast the vibrato goes, as vibrato_rate in audio.c */
+void synth_vibrato_rate(synth_vibrato_t *vibrato, float rate);
+/*
+ * One interrupt of vibrato on 'period', for a note of period 'note'.
+ * 'strength' is a fraction of 256, 256 is the full depth of the table.
+ */
+uint16_t synth_vibrato(synth_vibrato_t *vibrato, uint16_t period, uint16_t note, uint16_t strength);
+
+/* 'duration' as play_notes() takes it: a 64th is 1, times the tempo / 100 */
+void synth_note_length(synth_length_t *length, float duration);
+/* whether a note of 'length' is over, playing 'period' (0 for a rest) */
+bool synth_note_done(const synth_length_t *length, uint16_t position, uint16_t period);
+
+void synth_song_start(synth_song_t *song, float (*notes)[][2], uint16_t count, bool repeat, uint8_t tempo);
+/*
+ * Counts an interrupt of the song that played 'period', and moves on to
+ * the pause after the note, or to the next note. Returns false at the end.
+ */
+bool synth_song_next(synth_song_t *song, uint16_t period, uint8_t tempo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
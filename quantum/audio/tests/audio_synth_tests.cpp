@@ -0,0 +1,275 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "audio_synth.h"
+#include "song_list.h"
+
+// What the timer interrupt of audio.c did in floats, for one voice
+namespace {
+const float vibrato_lut[SYNTH_VIBRATO_LENGTH] = {
+    1.0022336811487, 1.0042529943610, 1.0058584256028, 1.0068905285205,
+    1.0072464122237, 1.0068905285205, 1.0058584256028, 1.0042529943610,
+    1.0022336811487, 1.0000000000000, 0.9977712970630, 0.9957650169978,
+    0.9941756956510, 0.9931566259436, 0.9928057204913, 0.9931566259436,
+    0.9941756956510, 0.9957650169978, 0.9977712970630, 1.0000000000000,
+};
+
+struct FloatSynth {
+    float vibrato_counter = 0;
+    float vibrato_rate = 0.125;
+    float vibrato_strength = 1;
+
+    static uint16_t period(float freq) {
+        return (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
+    }
+
+    float vibrato(float average_freq) {
+        float vibrated_freq = average_freq * powf(vibrato_lut[(int)vibrato_counter], vibrato_strength);
+        float r = fmodf(vibrato_counter + vibrato_rate * (1.0f + 440.0f / average_freq), SYNTH_VIBRATO_LENGTH);
+        vibrato_counter = r < 0 ? r + SYNTH_VIBRATO_LENGTH : r;
+        return vibrated_freq;
+    }
+
+    static float glide(float frequency, float target) {
+        if (frequency != 0 && frequency < target && frequency < target * powf(2, -440 / target / 12 / 2)) {
+            return frequency * powf(2, 440 / frequency / 12 / 2);
+        } else if (frequency != 0 && frequency > target && frequency > target * powf(2, 440 / target / 12 / 2)) {
+            return frequency * powf(2, -440 / frequency / 12 / 2);
+        }
+        return target;
+    }
+
+    // the periods of a song, interrupt by interrupt
+    std::vector<uint16_t> song(float (*notes)[][2], uint16_t notes_count, bool with_vibrato, uint8_t note_tempo = TEMPO_DEFAULT) {
+        std::vector<uint16_t> periods;
+        uint16_t current_note = 0;
+        bool note_resting = false;
+        uint16_t note_position = 0;
+        float note_frequency = (*notes)[0][0];
+        float note_length = ((*notes)[0][1] / 4) * (((float)note_tempo) / 100);
+        while (true) {
+            uint16_t timer_period = 0;
+            if (note_frequency > 0) {
+                float freq = with_vibrato ? vibrato(note_frequency) : note_frequency;
+                timer_period = period(freq);
+            }
+            periods.push_back(timer_period);
+
+            note_position++;
+            bool end_of_note;
+            if (timer_period > 0 && !note_resting) {
+                end_of_note = (note_position >= (note_length / timer_period * 0xFFFF - 1));
+            } else {
+                end_of_note = (note_position >= (note_length));
+            }
+            if (end_of_note) {
+                current_note++;
+                if (current_note >= notes_count) {
+                    return periods;
+                }
+                if (!note_resting) {
+                    note_resting = true;
+                    current_note--;
+                    if ((*notes)[current_note][0] == (*notes)[current_note + 1][0]) {
+                        note_frequency = 0;
+                    } else {
+                        note_frequency = (*notes)[current_note][0];
+                    }
+                    note_length = 1;
+                } else {
+                    note_resting = false;
+                    note_frequency = (*notes)[current_note][0];
+                    note_length = ((*notes)[current_note][1] / 4) * (((float)note_tempo) / 100);
+                }
+                note_position = 0;
+            }
+        }
+    }
+};
+
+// the same with audio_synth, as audio.c does it now
+std::vector<uint16_t> synth_song(float (*notes)[][2], uint16_t count, bool with_vibrato, uint8_t tempo = TEMPO_DEFAULT) {
+    std::vector<uint16_t> periods;
+    synth_song_t song;
+    synth_vibrato_t vibrato = {};
+    synth_vibrato_rate(&vibrato, 0.125);
+    synth_song_start(&song, notes, count, false, tempo);
+    do {
+        uint16_t period = song.period;
+        if (period && with_vibrato) {
+            period = synth_vibrato(&vibrato, period, song.period, 256);
+        }
+        periods.push_back(period);
+    } while (synth_song_next(&song, periods.back(), tempo));
+    return periods;
+}
+
+// a period as close as the timer can get it
+void expect_close(uint16_t actual, uint16_t expected, double tolerance, size_t index) {
+    EXPECT_LE(std::abs((int)actual - (int)expected), 1 + expected * tolerance)
+        << "at interrupt " << index;
+}
+
+float startup_song[][2] = SONG(STARTUP_SOUND);
+float ode_to_joy[][2] = SONG(ODE_TO_JOY);
+float zelda_puzzle[][2] = SONG(ZELDA_PUZZLE);
+float qwerty_sound[][2] = SONG(QWERTY_SOUND);
+float repeated_notes[][2] = SONG(Q__NOTE(_A4), Q__NOTE(_A4), Q__NOTE(_REST), Q__NOTE(_C2), W__NOTE(_C8));
+
+struct Song {
+    float (*notes)[][2];
+    uint16_t count;
+};
+
+#define SONG_OF(notes) Song{&notes, sizeof(notes) / sizeof(notes[0])}
+const Song songs[] = {
+    SONG_OF(startup_song),
+    SONG_OF(ode_to_joy),
+    SONG_OF(zelda_puzzle),
+    SONG_OF(qwerty_sound),
+    SONG_OF(repeated_notes),
+};
+}
+
+TEST(AudioSynth, ThePeriodOfANoteIsTheSame) {
+    for (float frequency = 31; frequency < 8000; frequency *= 1.01) {
+        EXPECT_EQ(synth_period(frequency), FloatSynth::period(frequency)) << frequency << " Hz";
+    }
+    EXPECT_EQ(synth_period(0), 0);
+    // below the lowest note
+    EXPECT_EQ(synth_period(20), SYNTH_PERIOD_MAX);
+    EXPECT_EQ(SYNTH_PERIOD_MAX, FloatSynth::period(30.52));
+}
+
+TEST(AudioSynth, ScalesByPowersOfTwo) {
+    for (uint16_t period = 100; period < 30000; period += 97) {
+        EXPECT_EQ(synth_scale(period, 0), period);
+        expect_close(synth_scale(period, SYNTH_OCTAVE), period / 2, 0, period);
+        expect_close(synth_scale(period, -SYNTH_OCTAVE), period * 2, 0, period);
+        for (int32_t exponent = -2 * SYNTH_OCTAVE; exponent < 4 * SYNTH_OCTAVE; exponent += 4099) {
+            uint16_t expected = std::min(period * pow(2, -exponent / (double)SYNTH_OCTAVE), (double)SYNTH_PERIOD_MAX);
+            expect_close(synth_scale(period, exponent), expected, 0.0002, period);
+        }
+    }
+    EXPECT_EQ(synth_scale(40000, -SYNTH_OCTAVE), SYNTH_PERIOD_MAX);
+    EXPECT_EQ(synth_scale(SYNTH_PERIOD_MAX, -3 * SYNTH_OCTAVE), SYNTH_PERIOD_MAX);
+}
+
+TEST(AudioSynth, TheDutyCycleIsAFractionOfThePeriod) {
+    for (float frequency = 31; frequency < 8000; frequency *= 1.07) {
+        uint16_t period = synth_period(frequency);
+        float exact = ((float)F_CPU) / (frequency * CPU_PRESCALER);
+        EXPECT_EQ(synth_duty(period, SYNTH_TIMBRE(TIMBRE_50)), (uint16_t)(exact * TIMBRE_50));
+        EXPECT_EQ(synth_duty(period, SYNTH_TIMBRE(TIMBRE_12)), (uint16_t)(exact * TIMBRE_12));
+        expect_close(synth_duty(period, SYNTH_TIMBRE(TIMBRE_75)), exact * TIMBRE_75, 0, frequency);
+    }
+}
+
+TEST(AudioSynth, SongsPlayTheSamePeriods) {
+    for (const Song &song : songs) {
+        FloatSynth reference;
+        EXPECT_EQ(synth_song(song.notes, song.count, false), reference.song(song.notes, song.count, false));
+    }
+}
+
+TEST(AudioSynth, SongsWithAnotherTempo) {
+    for (uint8_t tempo : {10, 55, 160, 255}) {
+        FloatSynth reference;
+        EXPECT_EQ(synth_song(&ode_to_joy, 15, false, tempo), reference.song(&ode_to_joy, 15, false, tempo));
+    }
+}
+
+TEST(AudioSynth, SongsWithVibrato) {
+    for (const Song &song : songs) {
+        FloatSynth reference;
+        std::vector<uint16_t> expected = reference.song(song.notes, song.count, true);
+        std::vector<uint16_t> actual = synth_song(song.notes, song.count, true);
+        ASSERT_EQ(actual.size(), expected.size());
+        // the phases drift apart a little, sometimes a step of the table
+        for (size_t i = 0; i < actual.size(); i++) {
+            expect_close(actual[i], expected[i], 0.0025, i);
+        }
+    }
+}
+
+TEST(AudioSynth, VibratoStrength) {
+    synth_vibrato_t vibrato = {};
+    synth_vibrato_rate(&vibrato, 0.125);
+    FloatSynth reference;
+    reference.vibrato_strength = 0.5;
+    const float frequency = NOTE_A4;
+    uint16_t period = synth_period(frequency);
+    for (int i = 0; i < 5000; i++) {
+        bool same_entry = (int)reference.vibrato_counter == (int)(vibrato.phase >> 16);
+        uint16_t expected = FloatSynth::period(reference.vibrato(frequency));
+        uint16_t actual = synth_vibrato(&vibrato, period, period, 128);
+        if (same_entry) {
+            expect_close(actual, expected, 0.0002, i);
+        }
+        float drift = std::abs(reference.vibrato_counter - vibrato.phase / 65536.0f);
+        ASSERT_LT(std::min(drift, SYNTH_VIBRATO_LENGTH - drift), 0.02) << "at interrupt " << i;
+    }
+}
+
+TEST(AudioSynth, GlidesLikeTheFloats) {
+    const float notes[][2] = {
+        {NOTE_A4, NOTE_A5},
+        {NOTE_A5, NOTE_A4},
+        {NOTE_C2, NOTE_C7},
+        {NOTE_B7, NOTE_E3},
+        {NOTE_A4, NOTE_AS4},
+        {31, NOTE_C4},
+        {NOTE_C7, NOTE_C2},
+    };
+    for (auto &notes : notes) {
+        synth_glide_t glide = {};
+        synth_glide(&glide, synth_period(notes[0]));
+        uint16_t target = synth_period(notes[1]);
+        float frequency = notes[0];
+        int float_steps = 0;
+        while (frequency != notes[1]) {
+            frequency = FloatSynth::glide(frequency, notes[1]);
+            float_steps++;
+        }
+
+        // the steps add up to less than a step of difference, which is more
+        // at the low end of a glide down
+        frequency = notes[0];
+        int steps = 0;
+        uint16_t period;
+        do {
+            frequency = FloatSynth::glide(frequency, notes[1]);
+            period = synth_glide(&glide, target);
+            expect_close(period, FloatSynth::period(frequency), 0.02, steps);
+            ASSERT_LT(++steps, 1000) << notes[0] << " Hz to " << notes[1] << " Hz";
+        } while (period != target);
+        EXPECT_NEAR(steps, float_steps, 1) << notes[0] << " Hz to " << notes[1] << " Hz";
+    }
+}
+
+TEST(AudioSynth, AGlideStartsAtTheTarget) {
+    synth_glide_t glide = {};
+    EXPECT_EQ(synth_glide(&glide, 1234), 1234);
+    EXPECT_EQ(synth_glide(&glide, 1234), 1234);
+    // less than a step away
+    EXPECT_EQ(synth_glide(&glide, 1233), 1233);
+    // and further
+    EXPECT_NE(synth_glide(&glide, 617), 617);
+}
@@ -0,0 +1,5 @@
+audio_synth_DEFS := -DF_CPU=16000000
+audio_synth_INC := $(QUANTUM_PATH)/audio
+audio_synth_SRC := \
+	$(QUANTUM_PATH)/audio/tests/audio_synth_tests.cpp \
+	$(QUANTUM_PATH)/audio/audio_synth.c
@@ -0,0 +1,56 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "matrix.h"
+
+/* Set 0 if debouncing isn't needed */
+#ifndef DEBOUNCING_DELAY
+#   define DEBOUNCING_DELAY 5
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The algorithm is picked with DEBOUNCE_TYPE in rules.mk:
+ *   sym_g    - (default) any change holds back the whole matrix until it
+ *              has been stable for DEBOUNCING_DELAY ms
+ *   sym_pk   - the same, but with a timer for every key, so a bouncing key
+ *              does not delay the others
+ *   eager_pk - a change is reported on its first edge, after which the key
+ *              ignores further changes for DEBOUNCING_DELAY ms
+ */
+void debounce_init(uint8_t num_rows);
+
+/*
+ * Updates the debounced matrix 'cooked' from the raw scan result 'raw'.
+ * 'changed' has to be true when raw differs from the previous scan.
+ */
+void debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed);
+
+/* true while a change is held back or a key is locked out */
+bool debounce_active(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
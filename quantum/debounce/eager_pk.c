@@ -0,0 +1,133 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+ * Per-key eager debouncing: a change is reported on its first edge and the
+ * key then ignores everything for DEBOUNCING_DELAY ms. This removes the
+ * debounce delay from presses and releases, as long as the switch does not
+ * produce noise while it is idle.
+ */
+
+#include <string.h>
+#include "debounce.h"
+#include "timer.h"
+
+#if (DEBOUNCING_DELAY > 255)
+#   error "DEBOUNCING_DELAY has to fit in 8 bits for per-key debouncing"
+#endif
+
+#if (MATRIX_COLS <= 8)
+#    define ROW_SHIFTER ((uint8_t)1)
+#elif (MATRIX_COLS <= 16)
+#    define ROW_SHIFTER ((uint16_t)1)
+#elif (MATRIX_COLS <= 32)
+#    define ROW_SHIFTER ((uint32_t)1)
+#endif
+
+#if (DEBOUNCING_DELAY > 0)
+/* remaining ms for every key, 0 when the key is idle */
+static uint8_t debounce_counters[MATRIX_ROWS * MATRIX_COLS];
+static uint16_t active_counters = 0;
+static uint16_t last_time;
+
+static uint8_t elapsed_since_last_call(void)
+{
+    uint16_t now = timer_read();
+    uint16_t elapsed = TIMER_DIFF_16(now, last_time);
+    last_time = now;
+    return elapsed > 255 ? 255 : elapsed;
+}
+#endif
+
+void debounce_init(uint8_t num_rows)
+{
+#if (DEBOUNCING_DELAY > 0)
+    memset(debounce_counters, 0, sizeof(debounce_counters));
+    active_counters = 0;
+    last_time = timer_read();
+#endif
+}
+
+#if (DEBOUNCING_DELAY > 0)
+/* returns true when the lockout of at least one key ended */
+static bool update_counters(uint8_t num_rows, uint8_t elapsed)
+{
+    bool expired = false;
+    uint8_t *counter = debounce_counters;
+
+    for (uint16_t i = 0; i < num_rows * MATRIX_COLS; i++, counter++) {
+        if (!*counter) {
+            continue;
+        }
+        if (*counter <= elapsed) {
+            *counter = 0;
+            active_counters--;
+            expired = true;
+        } else {
+            *counter -= elapsed;
+        }
+    }
+    return expired;
+}
+
+static void transfer_new_edges(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows)
+{
+    uint8_t *counter = debounce_counters;
+
+    for (uint8_t row = 0; row < num_rows; row++) {
+        matrix_row_t delta = raw[row] ^ cooked[row];
+        if (!delta) {
+            counter += MATRIX_COLS;
+            continue;
+        }
+        for (uint8_t col = 0; col < MATRIX_COLS; col++, counter++) {
+            matrix_row_t mask = ROW_SHIFTER << col;
+            if ((delta & mask) && !*counter) {
+                cooked[row] ^= mask;
+                *counter = DEBOUNCING_DELAY;
+                active_counters++;
+            }
+        }
+    }
+}
+#endif
+
+void debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed)
+{
+#if (DEBOUNCING_DELAY > 0)
+    bool expired = false;
+    uint8_t elapsed = elapsed_since_last_call();
+
+    if (active_counters) {
+        expired = update_counters(num_rows, elapsed);
+    }
+    // a key that changed during its lockout is picked up once it ends
+    if (changed || expired) {
+        transfer_new_edges(raw, cooked, num_rows);
+    }
+#else
+    for (uint8_t i = 0; i < num_rows; i++) {
+        cooked[i] = raw[i];
+    }
+#endif
+}
+
+bool debounce_active(void)
+{
+#if (DEBOUNCING_DELAY > 0)
+    return active_counters;
+#else
+    return false;
+#endif
+}
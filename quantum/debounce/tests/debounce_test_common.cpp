@@ -0,0 +1,113 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "debounce_test_common.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+extern "C" {
+    void set_time(uint32_t t);
+}
+
+static bool operator<(const KeyEdge& lhs, const KeyEdge& rhs) {
+    if (lhs.row != rhs.row) return lhs.row < rhs.row;
+    if (lhs.col != rhs.col) return lhs.col < rhs.col;
+    return lhs.pressed < rhs.pressed;
+}
+
+namespace {
+    std::string to_string(const std::vector<KeyEdge>& edges) {
+        std::string result;
+        for (auto& e: edges) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "(%u,%u %s) ", e.row, e.col, e.pressed ? "down" : "up");
+            result += buf;
+        }
+        return result.empty() ? "none" : result;
+    }
+}
+
+Trace chatter(uint8_t row, uint8_t col, uint32_t start, uint32_t end, uint32_t period) {
+    Trace trace;
+    bool pressed = true;
+    for (uint32_t t = start; t <= end; t += period) {
+        trace.push_back({t, {{row, col, pressed}}, {}});
+        pressed = !pressed;
+    }
+    return trace;
+}
+
+void DebounceTest::replay(Trace trace) {
+    matrix_row_t raw[MATRIX_ROWS] = {};
+    matrix_row_t cooked[MATRIX_ROWS] = {};
+    uint32_t pending_since[MATRIX_ROWS][MATRIX_COLS];
+    const uint32_t none = UINT32_MAX;
+    std::fill(&pending_since[0][0], &pending_since[0][0] + MATRIX_ROWS * MATRIX_COLS, none);
+
+    std::stable_sort(trace.begin(), trace.end(),
+        [](const TraceEvent& lhs, const TraceEvent& rhs) { return lhs.time < rhs.time; });
+
+    set_time(0);
+    debounce_init(MATRIX_ROWS);
+
+    uint32_t end = trace.empty() ? 0 : trace.back().time + 100;
+    auto next = trace.begin();
+    for (uint32_t t = 0; t <= end; t++) {
+        set_time(t);
+        std::vector<KeyEdge> expected;
+        bool changed = false;
+        for (; next != trace.end() && next->time == t; ++next) {
+            for (auto& e: next->raw) {
+                matrix_row_t mask = (matrix_row_t)1 << e.col;
+                bool was_pressed = raw[e.row] & mask;
+                if (was_pressed == e.pressed) continue;
+                raw[e.row] ^= mask;
+                changed = true;
+            }
+            expected.insert(expected.end(), next->cooked.begin(), next->cooked.end());
+        }
+
+        matrix_row_t previous[MATRIX_ROWS];
+        memcpy(previous, cooked, sizeof(cooked));
+        debounce(raw, cooked, MATRIX_ROWS, changed);
+
+        std::vector<KeyEdge> actual;
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            matrix_row_t delta = previous[row] ^ cooked[row];
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                matrix_row_t mask = (matrix_row_t)1 << col;
+                // the latency is counted from when the switch last settled in its new state
+                if ((raw[row] ^ previous[row]) & mask) {
+                    if (pending_since[row][col] == none) {
+                        pending_since[row][col] = t;
+                    }
+                } else {
+                    pending_since[row][col] = none;
+                }
+                if (delta & mask) {
+                    actual.push_back({row, col, (bool)(cooked[row] & mask)});
+                    uint32_t latency = t - pending_since[row][col];
+                    pending_since[row][col] = none;
+                    max_latency = std::max(max_latency, latency);
+                }
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        EXPECT_EQ(to_string(expected), to_string(actual)) << "at " << t << " ms";
+    }
+    EXPECT_FALSE(debounce_active());
+}
@@ -0,0 +1,56 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "debounce.h"
+}
+
+struct KeyEdge {
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+};
+
+/*
+ * One entry of a recorded trace. 'raw' are the switch edges seen by the
+ * matrix scan at 'time', 'cooked' the edges the debounced matrix is
+ * expected to show at that time.
+ */
+struct TraceEvent {
+    uint32_t time;
+    std::vector<KeyEdge> raw;
+    std::vector<KeyEdge> cooked;
+};
+
+typedef std::vector<TraceEvent> Trace;
+
+/* a switch that toggles every 'period' ms from 'start' until 'end' */
+Trace chatter(uint8_t row, uint8_t col, uint32_t start, uint32_t end, uint32_t period);
+
+class DebounceTest : public testing::Test {
+protected:
+    /*
+     * Scans once per ms until the trace is over and checks every debounced
+     * edge against the expectations. Also records the longest a debounced
+     * edge lagged behind the raw edge it reports.
+     */
+    void replay(Trace trace);
+
+    uint32_t max_latency = 0;
+};
@@ -0,0 +1,70 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "debounce_test_common.h"
+
+class DebounceEagerPk : public DebounceTest {};
+
+// Every edge is reported at once, then the key is locked for DEBOUNCING_DELAY ms
+
+TEST_F(DebounceEagerPk, CleanPressAndRelease) {
+    replay({
+        {10, {{0, 0, true}}, {{0, 0, true}}},
+        {50, {{0, 0, false}}, {{0, 0, false}}},
+    });
+    EXPECT_EQ(max_latency, 0u);
+}
+
+TEST_F(DebounceEagerPk, BouncingPressAndRelease) {
+    replay({
+        {10, {{1, 2, true}}, {{1, 2, true}}},
+        {11, {{1, 2, false}}, {}},
+        {12, {{1, 2, true}}, {}},
+        {13, {{1, 2, false}}, {}},
+        {14, {{1, 2, true}}, {}},
+        {60, {{1, 2, false}}, {{1, 2, false}}},
+        {61, {{1, 2, true}}, {}},
+        {62, {{1, 2, false}}, {}},
+    });
+    EXPECT_EQ(max_latency, 0u);
+}
+
+TEST_F(DebounceEagerPk, AChatteringKeyDoesNotDelayOtherKeys) {
+    // The chattering key gets through at most once per lockout
+    Trace trace = chatter(0, 0, 10, 40, 2);
+    trace.push_back({10, {}, {{0, 0, true}}});
+    trace.push_back({16, {}, {{0, 0, false}}});
+    trace.push_back({22, {}, {{0, 0, true}}});
+    trace.push_back({28, {}, {{0, 0, false}}});
+    trace.push_back({34, {}, {{0, 0, true}}});
+    trace.push_back({40, {}, {{0, 0, false}}});
+    trace.push_back({20, {{1, 3, true}}, {{1, 3, true}}});
+    trace.push_back({60, {{1, 3, false}}, {{1, 3, false}}});
+    replay(trace);
+}
+
+TEST_F(DebounceEagerPk, AReleaseDuringTheLockoutIsReportedWhenItEnds) {
+    replay({
+        {10, {{2, 5, true}}, {{2, 5, true}}},
+        {12, {{2, 5, false}}, {}},
+        {15, {}, {{2, 5, false}}},
+    });
+}
+
+TEST_F(DebounceEagerPk, SimultaneousKeysInDifferentRows) {
+    replay({
+        {10, {{0, 1, true}, {3, 9, true}}, {{0, 1, true}, {3, 9, true}}},
+        {30, {{0, 1, false}, {3, 9, false}}, {{0, 1, false}, {3, 9, false}}},
+    });
+}
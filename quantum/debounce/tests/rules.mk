@@ -0,0 +1,23 @@
+DEBOUNCE_PATH := $(QUANTUM_PATH)/debounce
+DEBOUNCE_TEST_DEFS := -DMATRIX_ROWS=4 -DMATRIX_COLS=10 -DDEBOUNCING_DELAY=5
+
+debounce_sym_g_DEFS := $(DEBOUNCE_TEST_DEFS)
+debounce_sym_g_SRC := \
+	$(DEBOUNCE_PATH)/tests/sym_g_tests.cpp \
+	$(DEBOUNCE_PATH)/tests/debounce_test_common.cpp \
+	$(DEBOUNCE_PATH)/sym_g.c \
+	$(TMK_PATH)/common/test/timer.c
+
+debounce_sym_pk_DEFS := $(DEBOUNCE_TEST_DEFS)
+debounce_sym_pk_SRC := \
+	$(DEBOUNCE_PATH)/tests/sym_pk_tests.cpp \
+	$(DEBOUNCE_PATH)/tests/debounce_test_common.cpp \
+	$(DEBOUNCE_PATH)/sym_pk.c \
+	$(TMK_PATH)/common/test/timer.c
+
+debounce_eager_pk_DEFS := $(DEBOUNCE_TEST_DEFS)
+debounce_eager_pk_SRC := \
+	$(DEBOUNCE_PATH)/tests/eager_pk_tests.cpp \
+	$(DEBOUNCE_PATH)/tests/debounce_test_common.cpp \
+	$(DEBOUNCE_PATH)/eager_pk.c \
+	$(TMK_PATH)/common/test/timer.c
@@ -0,0 +1,69 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "debounce_test_common.h"
+
+class DebounceSymG : public DebounceTest {};
+
+// The whole matrix is released DEBOUNCING_DELAY ms after its last change
+
+TEST_F(DebounceSymG, CleanPressAndRelease) {
+    replay({
+        {10, {{0, 0, true}}, {}},
+        {16, {}, {{0, 0, true}}},
+        {50, {{0, 0, false}}, {}},
+        {56, {}, {{0, 0, false}}},
+    });
+}
+
+TEST_F(DebounceSymG, BouncingPressAndRelease) {
+    replay({
+        {10, {{1, 2, true}}, {}},
+        {11, {{1, 2, false}}, {}},
+        {12, {{1, 2, true}}, {}},
+        {13, {{1, 2, false}}, {}},
+        {14, {{1, 2, true}}, {}},
+        {20, {}, {{1, 2, true}}},
+        {60, {{1, 2, false}}, {}},
+        {61, {{1, 2, true}}, {}},
+        {62, {{1, 2, false}}, {}},
+        {68, {}, {{1, 2, false}}},
+    });
+}
+
+TEST_F(DebounceSymG, AChatteringKeyDelaysAllOtherKeys) {
+    Trace trace = chatter(0, 0, 10, 40, 2);
+    trace.push_back({20, {{1, 3, true}}, {}});
+    trace.push_back({46, {}, {{1, 3, true}}});
+    trace.push_back({60, {{1, 3, false}}, {}});
+    trace.push_back({66, {}, {{1, 3, false}}});
+    replay(trace);
+    EXPECT_EQ(max_latency, 26u);
+}
+
+TEST_F(DebounceSymG, ATapShorterThanTheDelayIsFiltered) {
+    replay({
+        {10, {{2, 5, true}}, {}},
+        {12, {{2, 5, false}}, {}},
+    });
+}
+
+TEST_F(DebounceSymG, SimultaneousKeysInDifferentRows) {
+    replay({
+        {10, {{0, 1, true}, {3, 9, true}}, {}},
+        {16, {}, {{0, 1, true}, {3, 9, true}}},
+        {30, {{0, 1, false}, {3, 9, false}}, {}},
+        {36, {}, {{0, 1, false}, {3, 9, false}}},
+    });
+}
@@ -23,6 +23,8 @@
   #define AUTO_SHIFT_TIMEOUT 175
 #endif
 
+extern uint16_t autoshift_lastkey;
+
 bool process_auto_shift(uint16_t keycode, keyrecord_t *record);
 
 #endif
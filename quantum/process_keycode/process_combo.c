@@ -16,13 +16,14 @@
 
 #include "process_combo.h"
 #include "print.h"
+#include <string.h>
 
 
-#define COMBO_TIMER_ELAPSED -1
+#define COMBO_TIMER_ELAPSED UINT16_MAX
 
 
 __attribute__ ((weak))
-combo_t key_combos[] = {
+combo_t key_combos[COMBO_COUNT] = {
 
 };
 
@@ -31,7 +32,29 @@ void process_combo_event(uint8_t combo_index, bool pressed) {
 
 }
 
-static uint8_t current_combo_index = 0;
+__attribute__ ((weak))
+void process_combo_event16(uint16_t combo_index, bool pressed) {
+    process_combo_event(combo_index, pressed);
+}
+
+static uint16_t current_combo_index = 0;
+
+/* Keycode -> combo index. Every keycode hashes to a bucket holding the set
+ * of combos that contain a keycode of that bucket, so a key event only
+ * visits its candidate combos. Built from key_combos on the first event. */
+#define COMBO_BITSET_SIZE ((COMBO_COUNT + 7) / 8)
+#define COMBO_BUCKET(keycode) (((keycode) ^ ((keycode) >> 8)) & (COMBO_INDEX_BUCKETS - 1))
+
+#if (COMBO_INDEX_BUCKETS & (COMBO_INDEX_BUCKETS - 1)) != 0
+#error "COMBO_INDEX_BUCKETS must be a power of two"
+#endif
+
+static uint8_t combo_index[COMBO_INDEX_BUCKETS][COMBO_BITSET_SIZE];
+static bool combo_index_ready = false;
+
+/* Combos with a running timer, the only ones matrix_scan_combo looks at */
+static uint8_t combo_active[COMBO_BITSET_SIZE];
+static uint16_t combo_active_count = 0;
 
 static inline void send_combo(uint16_t action, bool pressed)
 {
@@ -42,7 +65,7 @@ static inline void send_combo(uint16_t action, bool pressed)
             unregister_code16(action);
         }
     } else {
-        process_combo_event(current_combo_index, pressed);
+        process_combo_event16(current_combo_index, pressed);
     }
 }
 
@@ -112,30 +135,113 @@ static bool process_single_combo(combo_t *combo, uint16_t keycode, keyrecord_t *
     return is_combo_active;
 }
 
+#define COMBO_TIMER_IS_RUNNING(combo) ((combo)->timer && (combo)->timer != COMBO_TIMER_ELAPSED)
+
+/* Has matrix_scan_combo called once COMBO_TERM of the combo has passed */
+static inline void schedule_combo(combo_t *combo)
+{
+    deadline_set_earliest(DEADLINE_COMBO, combo->timer + COMBO_TERM + 1, matrix_scan_combo);
+}
+
+static void update_combo_active(uint16_t combo_index, combo_t *combo)
+{
+    uint8_t *byte = &combo_active[combo_index / 8];
+    const uint8_t bit = 1U << (combo_index % 8);
+
+    if (COMBO_TIMER_IS_RUNNING(combo)) {
+        if (!(*byte & bit)) {
+            *byte |= bit;
+            combo_active_count++;
+        }
+        schedule_combo(combo);
+    } else if (*byte & bit) {
+        *byte &= ~bit;
+        if (!--combo_active_count) {
+            deadline_clear(DEADLINE_COMBO);
+        }
+    }
+}
+
+void combo_index_init(void)
+{
+    memset(combo_index, 0, sizeof(combo_index));
+    memset(combo_active, 0, sizeof(combo_active));
+    combo_active_count = 0;
+    deadline_clear(DEADLINE_COMBO);
+
+    for (uint16_t i = 0; i < COMBO_COUNT; ++i) {
+        for (const uint16_t *keys = key_combos[i].keys; ; ++keys) {
+            uint16_t key = pgm_read_word(keys);
+            if (COMBO_END == key) break;
+            combo_index[COMBO_BUCKET(key)][i / 8] |= 1U << (i % 8);
+        }
+        update_combo_active(i, &key_combos[i]);
+    }
+    combo_index_ready = true;
+}
+
+bool combo_index_has(uint16_t keycode)
+{
+    if (!combo_index_ready) {
+        combo_index_init();
+    }
+
+    const uint8_t *candidates = combo_index[COMBO_BUCKET(keycode)];
+    for (uint16_t byte = 0; byte < COMBO_BITSET_SIZE; ++byte) {
+        if (candidates[byte]) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool process_combo(uint16_t keycode, keyrecord_t *record)
 {
     bool is_combo_key = false;
 
-    for (current_combo_index = 0; current_combo_index < COMBO_COUNT; ++current_combo_index) {
-        combo_t *combo = &key_combos[current_combo_index];
-        is_combo_key |= process_single_combo(combo, keycode, record);
-    }    
+    if (!combo_index_ready) {
+        combo_index_init();
+    }
+
+    const uint8_t *candidates = combo_index[COMBO_BUCKET(keycode)];
+    for (uint16_t byte = 0; byte < COMBO_BITSET_SIZE; ++byte) {
+        uint8_t bits = candidates[byte];
+        for (current_combo_index = byte * 8; bits; ++current_combo_index, bits >>= 1) {
+            if (bits & 1) {
+                combo_t *combo = &key_combos[current_combo_index];
+                is_combo_key |= process_single_combo(combo, keycode, record);
+                update_combo_active(current_combo_index, combo);
+            }
+        }
+    }
 
     return !is_combo_key;
 }
 
+/* Called by deadline_task once the earliest started combo can time out */
 void matrix_scan_combo(void)
 {
-    for (int i = 0; i < COMBO_COUNT; ++i) {
-        combo_t *combo = &key_combos[i];
-        if (combo->timer && 
-            combo->timer != COMBO_TIMER_ELAPSED && 
-            timer_elapsed(combo->timer) > COMBO_TERM) {
-            
+    if (!combo_active_count) {
+        return;
+    }
+
+    for (uint16_t byte = 0; byte < COMBO_BITSET_SIZE; ++byte) {
+        uint8_t bits = combo_active[byte];
+        for (uint16_t i = byte * 8; bits; ++i, bits >>= 1) {
+            if (!(bits & 1)) {
+                continue;
+            }
+            combo_t *combo = &key_combos[i];
+            if (timer_elapsed(combo->timer) <= COMBO_TERM) {
+                schedule_combo(combo);
+                continue;
+            }
+
             /* This disables the combo, meaning key events for this
              * combo will be handled by the next processors in the chain 
              */
             combo->timer = COMBO_TIMER_ELAPSED;
+            update_combo_active(i, combo);
 
 #ifdef COMBO_ALLOW_ACTION_KEYS
             process_action(&combo->prev_record, 
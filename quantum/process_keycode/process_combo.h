@@ -20,6 +20,11 @@
 #include <stdint.h>
 #include "progmem.h"
 #include "quantum.h"
+#include "action_tapping.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 typedef struct
 {
@@ -51,9 +56,24 @@ typedef struct
 #ifndef COMBO_TERM
 #define COMBO_TERM TAPPING_TERM
 #endif
+#ifndef COMBO_INDEX_BUCKETS
+#define COMBO_INDEX_BUCKETS 16
+#endif
+
+extern combo_t key_combos[COMBO_COUNT];
 
 bool process_combo(uint16_t keycode, keyrecord_t *record);
+/* Rebuilds the keycode index, call it after changing key_combos at runtime */
+void combo_index_init(void);
+/* false if no combo contains the keycode, true if one might */
+bool combo_index_has(uint16_t keycode);
 void matrix_scan_combo(void);
 void process_combo_event(uint8_t combo_index, bool pressed);
+/* for more than 255 combos, calls process_combo_event() unless the keymap defines it */
+void process_combo_event16(uint16_t combo_index, bool pressed);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
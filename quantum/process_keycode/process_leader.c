@@ -24,6 +24,12 @@ void leader_start(void) {}
 __attribute__ ((weak))
 void leader_end(void) {}
 
+// Keymaps without a table of sequences don't define it at all
+extern const uint16_t leader_sequences[] __attribute__ ((weak));
+
+__attribute__ ((weak))
+void leader_sequence_user(uint16_t id) {}
+
 // Leader key stuff
 bool leading = false;
 uint16_t leader_time = 0;
@@ -31,6 +37,171 @@ uint16_t leader_time = 0;
 uint16_t leader_sequence[5] = {0, 0, 0, 0, 0};
 uint8_t leader_sequence_size = 0;
 
+// The entries of leader_sequences that start with the keys pressed so far,
+// as offsets into the table
+static uint16_t leader_run_start;
+static uint16_t leader_run_end;
+
+#define LEADER_TABLE(offset) pgm_read_word(&leader_sequences[offset])
+#define LEADER_ENTRY_SIZE(length) (2 + (length))
+
+static bool leader_table_used(void) {
+  return leader_sequences && LEADER_TABLE(0) != LEADER_SEQUENCES_END;
+}
+
+static void leader_finish(bool matched) {
+  uint16_t id = matched ? LEADER_TABLE(leader_run_start + 1) : 0;
+  leading = false;
+  deadline_clear(DEADLINE_LEADER);
+  leader_end();
+  if (matched) {
+    leader_sequence_user(id);
+  }
+}
+
+// Whether the first entry of the run is exactly the keys pressed so far.
+// It's the only entry that can be, as it sorts before the longer ones.
+static bool leader_run_complete(void) {
+  return LEADER_TABLE(leader_run_start) == leader_sequence_size;
+}
+
+// Offsets of every leader_index_stride-th entry of the table, so that
+// narrowing the run is a binary search followed by a short walk
+static uint16_t leader_index[LEADER_INDEX_SIZE];
+static uint8_t leader_index_count;
+
+static void leader_index_init(void) {
+  uint16_t count = 0;
+  uint16_t pos = 0;
+  uint16_t length;
+  while ((length = LEADER_TABLE(pos)) != 0) {
+    count++;
+    pos += LEADER_ENTRY_SIZE(length);
+  }
+  uint16_t stride = (count + LEADER_INDEX_SIZE - 1) / LEADER_INDEX_SIZE;
+  pos = 0;
+  leader_index_count = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    if (i % stride == 0) {
+      leader_index[leader_index_count++] = pos;
+    }
+    pos += LEADER_ENTRY_SIZE(LEADER_TABLE(pos));
+  }
+}
+
+// Whether the entry at 'pos' sorts before the ones that continue with
+// 'keycode' (or, if 'inclusive', before the ones after those). All of the
+// run shares the first 'depth' keys, so only the next one matters, and an
+// entry that ends there sorts first.
+static inline bool leader_before(uint16_t pos, uint8_t depth, uint16_t keycode,
+                          bool inclusive) {
+  if (LEADER_TABLE(pos) <= depth) {
+    return true;
+  }
+  uint16_t key = LEADER_TABLE(pos + 2 + depth);
+  return inclusive ? key <= keycode : key < keycode;
+}
+
+// The first entry of the index at or after 'pos'
+static inline uint8_t leader_index_find(uint16_t pos) {
+  uint8_t lo = 0;
+  uint8_t hi = leader_index_count;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    if (leader_index[mid] < pos) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// The first offset of the run that doesn't sort before 'keycode'
+static uint16_t leader_bound(uint8_t depth, uint16_t keycode, bool inclusive) {
+  // the indexed entries inside the run
+  uint8_t lo = leader_index_find(leader_run_start);
+  uint8_t hi = leader_index_find(leader_run_end);
+  uint8_t first = lo;
+  // the last of them that still sorts before
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    if (leader_before(leader_index[mid], depth, keycode, inclusive)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  uint16_t pos = lo > first ? leader_index[lo - 1] : leader_run_start;
+  uint16_t length;
+  while (pos < leader_run_end && (length = LEADER_TABLE(pos)) != 0 &&
+         leader_before(pos, depth, keycode, inclusive)) {
+    pos += LEADER_ENTRY_SIZE(length);
+  }
+  return pos;
+}
+
+// Narrows the run down to the entries that continue with 'keycode'
+static bool leader_narrow(uint16_t keycode, uint8_t depth) {
+  uint16_t start = leader_bound(depth, keycode, false);
+  uint16_t end = leader_bound(depth, keycode, true);
+  if (start == end) {
+    return false;
+  }
+  leader_run_start = start;
+  leader_run_end = end;
+  return true;
+}
+
+static void leader_match(uint16_t keycode) {
+  if (!leader_narrow(keycode, leader_sequence_size - 1)) {
+    leader_finish(false);
+    return;
+  }
+  uint16_t length = LEADER_TABLE(leader_run_start);
+  if (leader_run_complete() &&
+      leader_run_start + LEADER_ENTRY_SIZE(length) == leader_run_end) {
+    leader_finish(true);
+  }
+}
+
+void leader_task(void) {
+  if (leading && leader_table_used() &&
+      timer_elapsed(leader_time) > LEADER_TIMEOUT) {
+    leader_finish(leader_sequence_size > 0 && leader_run_complete());
+  }
+}
+
+bool leader_sequences_valid(void) {
+  uint16_t prev = 0;
+  uint16_t pos = 0;
+  uint16_t length;
+  if (!leader_sequences) {
+    return true;
+  }
+  while ((length = LEADER_TABLE(pos)) != 0) {
+    if (pos > 0) {
+      uint16_t prev_length = LEADER_TABLE(prev);
+      uint16_t i = 0;
+      while (i < prev_length && i < length &&
+             LEADER_TABLE(prev + 2 + i) == LEADER_TABLE(pos + 2 + i)) {
+        i++;
+      }
+      if (i < prev_length && i < length) {
+        if (LEADER_TABLE(prev + 2 + i) > LEADER_TABLE(pos + 2 + i)) {
+          return false;
+        }
+      } else if (prev_length >= length) {
+        // a duplicate, or a longer sequence before its prefix
+        return false;
+      }
+    }
+    prev = pos;
+    pos += LEADER_ENTRY_SIZE(length);
+  }
+  return true;
+}
+
 bool process_leader(uint16_t keycode, keyrecord_t *record) {
   // Leader key set-up
   if (record->event.pressed) {
@@ -44,11 +215,25 @@ bool process_leader(uint16_t keycode, keyrecord_t *record) {
       leader_sequence[2] = 0;
       leader_sequence[3] = 0;
       leader_sequence[4] = 0;
+      leader_run_start = 0;
+      leader_run_end = UINT16_MAX;
+      if (leader_index_count == 0 && leader_table_used()) {
+        leader_index_init();
+      }
+      // a LEADER_DICTIONARY() in matrix_scan_user() needs the wake up too
+      deadline_set(DEADLINE_LEADER, leader_time + LEADER_TIMEOUT + 1, leader_task);
       return false;
     }
     if (leading && timer_elapsed(leader_time) < LEADER_TIMEOUT) {
-      leader_sequence[leader_sequence_size] = keycode;
-      leader_sequence_size++;
+      if (leader_sequence_size < sizeof(leader_sequence) / sizeof(leader_sequence[0])) {
+        leader_sequence[leader_sequence_size] = keycode;
+      }
+      if (leader_sequence_size < UINT8_MAX) {
+        leader_sequence_size++;
+      }
+      if (leader_table_used()) {
+        leader_match(keycode);
+      }
       return false;
     }
   }
@@ -19,6 +19,8 @@
 
 #include "quantum.h"
 
+extern bool leading;
+
 bool process_leader(uint16_t keycode, keyrecord_t *record);
 
 void leader_start(void);
@@ -27,6 +29,42 @@ void leader_end(void);
 #ifndef LEADER_TIMEOUT
   #define LEADER_TIMEOUT 200
 #endif
+
+/*
+ * Instead of matching the sequences in matrix_scan_user(), they can be given
+ * as a table. Every entry is the number of keys, an id and the keys, and the
+ * table ends with LEADER_SEQUENCES_END:
+ *
+ *   const uint16_t PROGMEM leader_sequences[] = {
+ *     LEADER_SEQUENCE(SEQ_SAVE, KC_F),
+ *     LEADER_SEQUENCE(SEQ_HOME, KC_A, KC_S),
+ *     LEADER_SEQUENCE(SEQ_SEARCH, KC_A, KC_S, KC_D),
+ *     LEADER_SEQUENCES_END
+ *   };
+ *
+ * The entries have to be sorted by their keys like the words of a
+ * dictionary, which makes the table a trie laid out depth first: all the
+ * sequences that start with the same keys are next to each other. Every key
+ * narrows down that run, a sequence matches as soon as no longer one starts
+ * with it (or when LEADER_TIMEOUT runs out otherwise), and the leader ends
+ * right away once nothing can match anymore. leader_sequence_user() gets the
+ * id of the sequence that matched.
+ */
+#define LEADER_SEQUENCE(id, ...) \
+  (sizeof((uint16_t[]){ __VA_ARGS__ }) / sizeof(uint16_t)), (id), __VA_ARGS__
+#define LEADER_SEQUENCES_END 0
+
+/* Entries of the table that are indexed in RAM to speed up the matching */
+#ifndef LEADER_INDEX_SIZE
+  #define LEADER_INDEX_SIZE 16
+#endif
+
+extern const uint16_t leader_sequences[];
+
+void leader_sequence_user(uint16_t id);
+void leader_task(void);
+/* false if leader_sequences isn't sorted the way the matching needs it */
+bool leader_sequences_valid(void);
 #define SEQ_ONE_KEY(key) if (leader_sequence[0] == (key) && leader_sequence[1] == 0 && leader_sequence[2] == 0 && leader_sequence[3] == 0 && leader_sequence[4] == 0)
 #define SEQ_TWO_KEYS(key1, key2) if (leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == 0 && leader_sequence[3] == 0 && leader_sequence[4] == 0)
 #define SEQ_THREE_KEYS(key1, key2, key3) if (leader_sequence[0] == (key1) && leader_sequence[1] == (key2) && leader_sequence[2] == (key3) && leader_sequence[3] == 0 && leader_sequence[4] == 0)
@@ -21,6 +21,8 @@
 
 #include "protocol/serial.h"
 
+extern bool printing_enabled;
+
 bool process_printer(uint16_t keycode, keyrecord_t *record);
 
 #endif
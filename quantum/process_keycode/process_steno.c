@@ -56,11 +56,24 @@
 #define BOLT_STATE_SIZE 4
 #define GEMINI_STATE_SIZE 6
 #define MAX_STATE_SIZE GEMINI_STATE_SIZE
+// a Gemini packet, or a TX Bolt one and its terminating byte
+#define MAX_PACKET_SIZE GEMINI_STATE_SIZE
 
 uint8_t state[MAX_STATE_SIZE] = {0};
 uint8_t pressed = 0;
 steno_mode_t mode;
 
+// The packets of the finished strokes, sent by steno_task()
+static uint8_t stroke_queue[STENO_QUEUE_SIZE * MAX_PACKET_SIZE];
+static uint8_t stroke_queue_length = 0;
+
+#ifdef STENO_FIRST_UP
+// The keys that are down, a bit per key as in a Gemini packet
+static uint8_t held[GEMINI_STATE_SIZE] = {0};
+// Whether the stroke of the held keys has been sent already
+static bool stroke_sent = false;
+#endif
+
 uint8_t boltmap[64] = {
   TXB_NUL, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM, TXB_NUM,
   TXB_S_L, TXB_S_L, TXB_T_L, TXB_K_L, TXB_P_L, TXB_W_L, TXB_H_L,
@@ -87,10 +100,25 @@ void steno_set_mode(steno_mode_t new_mode) {
   eeprom_update_byte(EECONFIG_STENOMODE, mode);
 }
 
+static void queue_byte(uint8_t byte) {
+  stroke_queue[stroke_queue_length++] = byte;
+}
+
+void steno_task(void) {
+  if (stroke_queue_length) {
+    virtser_send_buffer(stroke_queue, stroke_queue_length);
+    stroke_queue_length = 0;
+  }
+}
+
 void send_steno_state(uint8_t size, bool send_empty) {
+  // the queue is full, send it now to make room
+  if (stroke_queue_length > sizeof(stroke_queue) - MAX_PACKET_SIZE) {
+    steno_task();
+  }
   for (uint8_t i = 0; i < size; ++i) {
     if (state[i] || send_empty) {
-      virtser_send(state[i]);
+      queue_byte(state[i]);
     }
   }
   steno_clear_state();
@@ -104,7 +132,7 @@ bool update_state_bolt(uint8_t key) {
 
 bool send_state_bolt(void) {
   send_steno_state(BOLT_STATE_SIZE, false);
-  virtser_send(0); // terminating byte
+  queue_byte(0); // terminating byte
   return false;
 }
 
@@ -119,6 +147,48 @@ bool send_state_gemini(void) {
   return false;
 }
 
+static bool update_state(uint8_t key) {
+  switch(mode) {
+    case STENO_MODE_BOLT:
+      return update_state_bolt(key);
+    case STENO_MODE_GEMINI:
+      return update_state_gemini(key);
+    default:
+      return false;
+  }
+}
+
+static bool send_state(void) {
+  switch(mode) {
+    case STENO_MODE_BOLT:
+      return send_state_bolt();
+    case STENO_MODE_GEMINI:
+      return send_state_gemini();
+    default:
+      return false;
+  }
+}
+
+#ifdef STENO_FIRST_UP
+static void set_held(uint8_t key, bool down) {
+  uint8_t bit = 1 << (6 - (key % 7));
+  if (down) {
+    held[key / 7] |= bit;
+  } else {
+    held[key / 7] &= ~bit;
+  }
+}
+
+// Keys that stay down after a stroke was sent are part of the next one
+static void update_state_held(void) {
+  for (uint8_t key = 0; key < GEMINI_STATE_SIZE * 7; ++key) {
+    if (held[key / 7] & (1 << (6 - (key % 7)))) {
+      update_state(key);
+    }
+  }
+}
+#endif
+
 bool process_steno(uint16_t keycode, keyrecord_t *record) {
   switch (keycode) {
     case QK_STENO_BOLT:
@@ -137,27 +207,37 @@ bool process_steno(uint16_t keycode, keyrecord_t *record) {
       if (IS_PRESSED(record->event)) {
         uint8_t key = keycode - QK_STENO;
         ++pressed;
-        switch(mode) {
-          case STENO_MODE_BOLT:
-            return update_state_bolt(key);
-          case STENO_MODE_GEMINI:
-            return update_state_gemini(key);
-          default:
-            return false;
+#ifdef STENO_FIRST_UP
+        if (stroke_sent) {
+          stroke_sent = false;
+          update_state_held();
         }
+        set_held(key, true);
+#endif
+        return update_state(key);
       } else {
+#ifdef STENO_FIRST_UP
+        set_held(keycode - QK_STENO, false);
+#endif
         --pressed;
         if (pressed <= 0) {
           pressed = 0;
-          switch(mode) {
-            case STENO_MODE_BOLT:
-              return send_state_bolt();
-            case STENO_MODE_GEMINI:
-              return send_state_gemini();
-            default:
-              return false;
+#ifdef STENO_FIRST_UP
+          if (stroke_sent) {
+            stroke_sent = false;
+            return false;
           }
+#endif
+          return send_state();
+        }
+#ifdef STENO_FIRST_UP
+        // the first key up ends the stroke
+        if (!stroke_sent) {
+          stroke_sent = true;
+          return send_state();
         }
+#endif
+        return false;
       }
 
   }
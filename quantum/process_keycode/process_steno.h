@@ -22,10 +22,17 @@
   #error "must have virtser enabled to use steno"
 #endif
 
+// How many finished strokes are kept until steno_task() sends them
+#ifndef STENO_QUEUE_SIZE
+  #define STENO_QUEUE_SIZE 4
+#endif
+
 typedef enum { STENO_MODE_BOLT, STENO_MODE_GEMINI } steno_mode_t;
 
 bool process_steno(uint16_t keycode, keyrecord_t *record);
 void steno_init(void);
 void steno_set_mode(steno_mode_t mode);
+// Sends the strokes finished since the last call, in a single write
+void steno_task(void);
 
 #endif
\ No newline at end of file
@@ -19,7 +19,11 @@
 uint8_t get_oneshot_mods(void);
 
 static uint16_t last_td;
-static int8_t highest_td = -1;
+
+/* The dances with a non-zero count, so that neither the scan nor a key press
+ * has to look at the ones that aren't in flight */
+static uint8_t td_active[(QK_TAP_DANCE_MAX - QK_TAP_DANCE + 8) / 8];
+static uint8_t td_active_count;
 
 void qk_tap_dance_pair_finished (qk_tap_dance_state_t *state, void *user_data) {
   qk_tap_dance_pair_t *pair = (qk_tap_dance_pair_t *)user_data;
@@ -90,6 +94,48 @@ static inline void process_tap_dance_action_on_reset (qk_tap_dance_action_t *act
   send_keyboard_report();
 }
 
+static inline void td_set_active (uint16_t idx) {
+  td_active[idx / 8] |= 1 << (idx % 8);
+  td_active_count++;
+}
+
+static inline void td_clear_active (uint16_t idx) {
+  td_active[idx / 8] &= ~(1 << (idx % 8));
+  td_active_count--;
+}
+
+/* the first active dance at or after 'idx', or -1 */
+static int16_t td_next_active (int16_t idx) {
+  if (!td_active_count)
+    return -1;
+  for (; idx < (int16_t)sizeof(td_active) * 8; idx++) {
+    uint8_t bits = td_active[idx / 8] >> (idx % 8);
+    if (!bits) {
+      idx |= 7;
+      continue;
+    }
+    if (bits & 1)
+      return idx;
+  }
+  return -1;
+}
+
+static inline uint16_t td_tapping_term (qk_tap_dance_action_t *action) {
+  return action->custom_tapping_term > 0 ? action->custom_tapping_term : TAPPING_TERM;
+}
+
+/* A dance that has finished while its key is still down has nothing to wait
+ * for until the key is released */
+static inline bool td_waiting (qk_tap_dance_action_t *action) {
+  return !(action->state.finished && action->state.pressed);
+}
+
+/* Makes sure the dances are looked at once the tapping term of this one has passed */
+static inline void td_schedule (qk_tap_dance_action_t *action) {
+  deadline_set_earliest (DEADLINE_TAP_DANCE, action->state.timer + td_tapping_term(action) + 1,
+                         matrix_scan_tap_dance);
+}
+
 bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
   uint16_t idx = keycode - QK_TAP_DANCE;
   qk_tap_dance_action_t *action;
@@ -100,12 +146,12 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
 
   switch(keycode) {
   case QK_TAP_DANCE ... QK_TAP_DANCE_MAX:
-    if ((int16_t)idx > highest_td)
-      highest_td = idx;
     action = &tap_dance_actions[idx];
 
     action->state.pressed = record->event.pressed;
     if (record->event.pressed) {
+      if (action->state.count == 0)
+        td_set_active (idx);
       action->state.keycode = keycode;
       action->state.count++;
       action->state.timer = timer_read();
@@ -122,19 +168,16 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
       last_td = keycode;
     }
 
+    if (action->state.count)
+      td_schedule (action);
     break;
 
   default:
     if (!record->event.pressed)
       return true;
 
-    if (highest_td == -1)
-      return true;
-
-    for (int i = 0; i <= highest_td; i++) {
+    for (int16_t i = td_next_active(0); i >= 0; i = td_next_active(i + 1)) {
       action = &tap_dance_actions[i];
-      if (action->state.count == 0)
-        continue;
       action->state.interrupted = true;
       process_tap_dance_action_on_dance_finished (action);
       reset_tap_dance (&action->state);
@@ -147,26 +190,25 @@ bool process_tap_dance(uint16_t keycode, keyrecord_t *record) {
 
 
 
+/* Called by deadline_task once the earliest dance can time out */
 void matrix_scan_tap_dance () {
-  if (highest_td == -1)
-    return;
-  uint16_t tap_user_defined;
-
-for (uint8_t i = 0; i <= highest_td; i++) {
+  /* Time some of the dances out, and find out when the next one is due */
+  for (int16_t i = td_next_active(0); i >= 0; i = td_next_active(i + 1)) {
     qk_tap_dance_action_t *action = &tap_dance_actions[i];
-    if(action->custom_tapping_term > 0 ) {
-      tap_user_defined = action->custom_tapping_term;
-    }
-    else{
-      tap_user_defined = TAPPING_TERM;
-    }
-    if (action->state.count && timer_elapsed (action->state.timer) > tap_user_defined) {
+    if (timer_elapsed (action->state.timer) > td_tapping_term(action)) {
       process_tap_dance_action_on_dance_finished (action);
       reset_tap_dance (&action->state);
     }
+    if (action->state.count && td_waiting(action))
+      td_schedule (action);
   }
 }
 
+/* true while any key has to be routed through process_tap_dance to interrupt a dance */
+bool tap_dance_in_progress (void) {
+  return last_td || td_active_count;
+}
+
 void reset_tap_dance (qk_tap_dance_state_t *state) {
   qk_tap_dance_action_t *action;
 
@@ -177,6 +219,8 @@ void reset_tap_dance (qk_tap_dance_state_t *state) {
 
   process_tap_dance_action_on_reset (action);
 
+  if (state->count)
+    td_clear_active (state->keycode - QK_TAP_DANCE);
   state->count = 0;
   state->interrupted = false;
   state->finished = false;
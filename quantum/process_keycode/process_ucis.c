@@ -27,9 +27,11 @@ void qk_ucis_start(void) {
 
 __attribute__((weak))
 void qk_ucis_start_user(void) {
+  output_queue_begin();
   unicode_input_start();
   register_hex(0x2328);
   unicode_input_finish();
+  output_queue_end();
 }
 
 static bool is_uni_seq(char *seq) {
@@ -56,11 +58,12 @@ void qk_ucis_symbol_fallback (void) {
     uint8_t code = qk_ucis_state.codes[i];
     register_code(code);
     unregister_code(code);
-    wait_ms(UNICODE_TYPE_DELAY);
+    output_queue_delay(UNICODE_TYPE_DELAY);
   }
 }
 
 void register_ucis(const char *hex) {
+  output_queue_begin();
   for(int i = 0; hex[i]; i++) {
     uint8_t kc = 0;
     char c = hex[i];
@@ -83,9 +86,10 @@ void register_ucis(const char *hex) {
     if (kc) {
       register_code (kc);
       unregister_code (kc);
-      wait_ms (UNICODE_TYPE_DELAY);
+      output_queue_delay(UNICODE_TYPE_DELAY);
     }
   }
+  output_queue_end();
 }
 
 bool process_ucis (uint16_t keycode, keyrecord_t *record) {
@@ -118,13 +122,15 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
   if (keycode == KC_ENT || keycode == KC_SPC || keycode == KC_ESC) {
     bool symbol_found = false;
 
+    output_queue_begin();
     for (i = qk_ucis_state.count; i > 0; i--) {
       register_code (KC_BSPC);
       unregister_code (KC_BSPC);
-      wait_ms(UNICODE_TYPE_DELAY);
+      output_queue_delay(UNICODE_TYPE_DELAY);
     }
 
     if (keycode == KC_ESC) {
+      output_queue_end();
       qk_ucis_state.in_progress = false;
       return false;
     }
@@ -141,6 +147,7 @@ bool process_ucis (uint16_t keycode, keyrecord_t *record) {
       qk_ucis_symbol_fallback();
     }
     unicode_input_finish();
+    output_queue_end();
 
     qk_ucis_state.in_progress = false;
     return false;
@@ -26,9 +26,11 @@ bool process_unicode(uint16_t keycode, keyrecord_t *record) {
       first_flag = 1;
     }
     uint16_t unicode = keycode & 0x7FFF;
+    output_queue_begin();
     unicode_input_start();
     register_hex(unicode);
     unicode_input_finish();
+    output_queue_end();
   }
   return true;
 }
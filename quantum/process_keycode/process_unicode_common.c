@@ -71,7 +71,7 @@ void unicode_input_start (void) {
     register_code(KC_U);
     unregister_code(KC_U);
   }
-  wait_ms(UNICODE_TYPE_DELAY);
+  output_queue_delay(UNICODE_TYPE_DELAY);
 }
 
 __attribute__((weak))
@@ -114,9 +114,11 @@ uint16_t hex_to_keycode(uint8_t hex)
 }
 
 void register_hex(uint16_t hex) {
+  output_queue_begin();
   for(int i = 3; i >= 0; i--) {
     uint8_t digit = ((hex >> (i*4)) & 0xF);
     register_code(hex_to_keycode(digit));
     unregister_code(hex_to_keycode(digit));
   }
+  output_queue_end();
 }
@@ -23,6 +23,7 @@ const uint32_t PROGMEM unicode_map[] = {
 
 void register_hex32(uint32_t hex) {
   bool onzerostart = true;
+  output_queue_begin();
   for(int i = 7; i >= 0; i--) {
     if (i <= 3) {
       onzerostart = false;
@@ -39,6 +40,7 @@ void register_hex32(uint32_t hex) {
       onzerostart = false;
     }
   }
+  output_queue_end();
 }
 
 __attribute__((weak))
@@ -55,17 +57,21 @@ bool process_unicode_map(uint16_t keycode, keyrecord_t *record) {
       code -= 0x10000;
       uint32_t lo = code & 0x3ff;
       uint32_t hi = (code & 0xffc00) >> 10;
+      output_queue_begin();
       unicode_input_start();
       register_hex32(hi + 0xd800);
       register_hex32(lo + 0xdc00);
       unicode_input_finish();
+      output_queue_end();
     } else if ((code > 0x10ffff && (input_mode == UC_OSX || input_mode == UC_OSX_RALT)) || (code > 0xFFFFF && input_mode == UC_LNX)) {
       // when character is out of range supported by the OS
       unicode_map_input_error();
     } else {
+      output_queue_begin();
       unicode_input_start();
       register_hex32(code);
       unicode_input_finish();
+      output_queue_end();
     }
   }
   return true;
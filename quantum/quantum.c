@@ -131,6 +131,8 @@ bool process_record_user(uint16_t keycode, keyrecord_t *record) {
 }
 
 void reset_keyboard(void) {
+  // e.g. a SEND_STRING() of the make command right before
+  output_queue_flush();
   clear_keyboard();
 #if defined(AUDIO_ENABLE) || (defined(MIDI_ENABLE) && defined(MIDI_ENABLE_BASIC))
   music_all_notes_off();
@@ -149,6 +151,18 @@ void reset_keyboard(void) {
   bootloader_jump();
 }
 
+/* Feature handler dispatch
+ *
+ * Each process_* handler of the feature chain is only called for the
+ * keycode ranges it handles, or while it wants to see every key, e.g.
+ * while leading or while a tap dance is in progress. The checks are
+ * inlined into the chain, so a keycode that no feature cares about costs
+ * a few compares instead of a call per feature.
+ */
+
+#define IN_RANGE(keycode, first, last) ((uint16_t)((keycode) - (first)) <= (uint16_t)((last) - (first)))
+#define PROCESS_IF(claimed, process) (!(claimed) || (process))
+
 // Shift / paren setup
 
 #ifndef LSPO_KEY
@@ -203,46 +217,60 @@ bool process_record_quantum(keyrecord_t *record) {
   #endif
     process_record_kb(keycode, record) &&
   #if defined(MIDI_ENABLE) && defined(MIDI_ADVANCED)
-    process_midi(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, MIDI_TONE_MIN, MI_MODSU),
+      process_midi(keycode, record)) &&
   #endif
   #ifdef AUDIO_ENABLE
-    process_audio(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, AU_ON, AU_TOG) || IN_RANGE(keycode, MUV_IN, MUV_DE),
+      process_audio(keycode, record)) &&
   #endif
   #ifdef STENO_ENABLE
-    process_steno(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, QK_STENO, QK_STENO_MAX),
+      process_steno(keycode, record)) &&
   #endif
   #if defined(AUDIO_ENABLE) || (defined(MIDI_ENABLE) && defined(MIDI_BASIC))
-    process_music(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, MU_ON, MU_MOD) || is_music_on(),
+      process_music(keycode, record)) &&
   #endif
   #ifdef TAP_DANCE_ENABLE
-    process_tap_dance(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, QK_TAP_DANCE, QK_TAP_DANCE_MAX) || tap_dance_in_progress(),
+      process_tap_dance(keycode, record)) &&
   #endif
   #ifndef DISABLE_LEADER
-    process_leader(keycode, record) &&
+    PROCESS_IF(keycode == KC_LEAD || leading,
+      process_leader(keycode, record)) &&
   #endif
   #ifndef DISABLE_CHORDING
-    process_chording(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, QK_CHORDING, QK_CHORDING_MAX),
+      process_chording(keycode, record)) &&
   #endif
   #ifdef COMBO_ENABLE
-    process_combo(keycode, record) &&
+    PROCESS_IF(combo_index_has(keycode),
+      process_combo(keycode, record)) &&
   #endif
   #ifdef UNICODE_ENABLE
-    process_unicode(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, QK_UNICODE, QK_UNICODE_MAX),
+      process_unicode(keycode, record)) &&
   #endif
   #ifdef UCIS_ENABLE
-    process_ucis(keycode, record) &&
+    PROCESS_IF(qk_ucis_state.in_progress,
+      process_ucis(keycode, record)) &&
   #endif
   #ifdef PRINTING_ENABLE
-    process_printer(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, PRINT_ON, PRINT_OFF) || printing_enabled,
+      process_printer(keycode, record)) &&
   #endif
   #ifdef AUTO_SHIFT_ENABLE
-    process_auto_shift(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, KC_A, KC_SLSH) || IN_RANGE(keycode, KC_ASUP, KC_ASRP) || autoshift_lastkey != KC_NO,
+      process_auto_shift(keycode, record)) &&
   #endif
   #ifdef UNICODEMAP_ENABLE
-    process_unicode_map(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, QK_UNICODE_MAP, QK_UNICODE_MAX),
+      process_unicode_map(keycode, record)) &&
   #endif
   #ifdef TERMINAL_ENABLE
-    process_terminal(keycode, record) &&
+    PROCESS_IF(IN_RANGE(keycode, TERM_ON, TERM_OFF) || terminal_enabled,
+      process_terminal(keycode, record)) &&
   #endif
       true)) {
     return false;
@@ -611,6 +639,7 @@ void send_string_P(const char *str) {
 }
 
 void send_string_with_delay(const char *str, uint8_t interval) {
+    output_queue_begin();
     while (1) {
         char ascii_code = *str;
         if (!ascii_code) break;
@@ -632,11 +661,13 @@ void send_string_with_delay(const char *str, uint8_t interval) {
         }
         ++str;
         // interval
-        { uint8_t ms = interval; while (ms--) wait_ms(1); }
+        output_queue_delay(interval);
     }
+    output_queue_end();
 }
 
 void send_string_with_delay_P(const char *str, uint8_t interval) {
+    output_queue_begin();
     while (1) {
         char ascii_code = pgm_read_byte(str);
         if (!ascii_code) break;
@@ -658,13 +689,15 @@ void send_string_with_delay_P(const char *str, uint8_t interval) {
         }
         ++str;
         // interval
-        { uint8_t ms = interval; while (ms--) wait_ms(1); }
+        output_queue_delay(interval);
     }
+    output_queue_end();
 }
 
 void send_char(char ascii_code) {
   uint8_t keycode;
   keycode = pgm_read_byte(&ascii_to_keycode_lut[(uint8_t)ascii_code]);
+  output_queue_begin();
   if (pgm_read_byte(&ascii_to_shift_lut[(uint8_t)ascii_code])) {
       register_code(KC_LSFT);
       register_code(keycode);
@@ -674,6 +707,7 @@ void send_char(char ascii_code) {
       register_code(keycode);
       unregister_code(keycode);
   }
+  output_queue_end();
 }
 
 void set_single_persistent_default_layer(uint8_t default_layer) {
@@ -741,18 +775,13 @@ void matrix_init_quantum() {
 }
 
 void matrix_scan_quantum() {
+  // leader, tap dance and combos time out from here
+  deadline_task();
+
   #ifdef AUDIO_ENABLE
     matrix_scan_music();
   #endif
 
-  #ifdef TAP_DANCE_ENABLE
-    matrix_scan_tap_dance();
-  #endif
-
-  #ifdef COMBO_ENABLE
-    matrix_scan_combo();
-  #endif
-
   #if defined(BACKLIGHT_ENABLE) && defined(BACKLIGHT_PIN)
     backlight_task();
   #endif
@@ -35,6 +35,8 @@
 #include <stddef.h>
 #include "bootloader.h"
 #include "timer.h"
+#include "deadline.h"
+#include "output_queue.h"
 #include "config_common.h"
 #include "led.h"
 #include "action_util.h"
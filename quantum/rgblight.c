@@ -13,11 +13,11 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
-#include <avr/eeprom.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
+#include <string.h>
+#include "eeprom.h"
 #include "progmem.h"
 #include "timer.h"
+#include "wait.h"
 #include "rgblight.h"
 #include "debug.h"
 #include "led_tables.h"
@@ -42,6 +42,13 @@ LED_TYPE led[RGBLED_NUM];
 uint8_t rgblight_inited = 0;
 bool rgblight_timer_enabled = false;
 
+// LEDs [0, rgblight_dirty_end) may differ from what the strip shows
+static uint8_t rgblight_dirty_end = 0;
+
+#ifdef RGBLIGHT_ANIMATIONS
+static void rgblight_mode_zone(uint8_t mode);
+#endif
+
 void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1) {
   uint8_t r = 0, g = 0, b = 0, base, color;
 
@@ -93,12 +100,111 @@ void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1) {
   setrgb(r, g, b, led1);
 }
 
+void hsv_to_rgb_n(uint16_t hue, int16_t hue_step, uint8_t sat, uint8_t val, LED_TYPE *leds, uint8_t count) {
+  uint8_t r, g, b;
+  uint8_t base = ((255 - sat) * val) >> 8;
+  if (sat == 0) {
+    base = val;
+  }
+  uint8_t span = val - base;
+
+  for (; count > 0; count--, leds++, hue += hue_step) {
+    // six sectors of 0x1000 steps each on a wheel of 12 bits
+    uint16_t sector = (hue >> 4) * 6;
+    uint8_t color = (span * ((sector >> 4) & 0xFF)) >> 8;
+
+    switch (sector >> 12) {
+      case 0:
+        r = val;
+        g = base + color;
+        b = base;
+        break;
+      case 1:
+        r = val - color;
+        g = val;
+        b = base;
+        break;
+      case 2:
+        r = base;
+        g = val;
+        b = base + color;
+        break;
+      case 3:
+        r = base;
+        g = val - color;
+        b = val;
+        break;
+      case 4:
+        r = base + color;
+        g = base;
+        b = val;
+        break;
+      default:
+        r = val;
+        g = base;
+        b = val - color;
+        break;
+    }
+    (*leds).r = pgm_read_byte(&CIE1931_CURVE[r]);
+    (*leds).g = pgm_read_byte(&CIE1931_CURVE[g]);
+    (*leds).b = pgm_read_byte(&CIE1931_CURVE[b]);
+  }
+}
+
 void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1) {
   (*led1).r = r;
   (*led1).g = g;
   (*led1).b = b;
 }
 
+// Writes one LED of the framebuffer, and marks it for the next push only if it changed
+static void rgblight_write_rgb(uint8_t i, uint8_t r, uint8_t g, uint8_t b) {
+  if (led[i].r == r && led[i].g == g && led[i].b == b) {
+    return;
+  }
+  setrgb(r, g, b, (LED_TYPE *)&led[i]);
+  if (i >= rgblight_dirty_end) {
+    rgblight_dirty_end = i + 1;
+  }
+}
+
+// Writes the LEDs [first, end) with a ramp of hues on the wheel of hsv_to_rgb_n()
+static void rgblight_write_hue_ramp(uint8_t first, uint8_t end, uint16_t hue, int16_t hue_step, uint8_t sat, uint8_t val) {
+  LED_TYPE tmp_leds[8];
+  while (first < end) {
+    uint8_t count = end - first < 8 ? end - first : 8;
+    hsv_to_rgb_n(hue, hue_step, sat, val, tmp_leds, count);
+    for (uint8_t i = 0; i < count; i++) {
+      rgblight_write_rgb(first + i, tmp_leds[i].r, tmp_leds[i].g, tmp_leds[i].b);
+    }
+    first += count;
+    hue += hue_step * count;
+  }
+}
+
+// The hue step between two LEDs of the static gradient modes 25-34
+static int16_t rgblight_gradient_step(uint8_t mode) {
+  int8_t direction = ((mode - 25) % 2) ? -1 : 1;
+  uint16_t range = pgm_read_word(&RGBLED_GRADIENT_RANGES[(mode - 25) / 2]);
+  // a whole turn of the wheel does not fit a step with a single LED, which only shows the first hue anyway
+  int32_t step = (int32_t)hue_to_wheel(range) / RGBLED_NUM * direction;
+  return step > INT16_MAX ? INT16_MAX : (step < -INT16_MAX ? -INT16_MAX : step);
+}
+
+// Pushes the LEDs written since the last push, nothing if none of them changed
+static void rgblight_flush(void) {
+  if (rgblight_dirty_end == 0) {
+    return;
+  }
+  if (rgblight_config.enable) {
+    // the strip is a shift register chain, so the LEDs after the last changed one can be left out
+    rgblight_driver_write(led, rgblight_dirty_end);
+  } else {
+    rgblight_set();
+  }
+  rgblight_dirty_end = 0;
+}
+
 
 uint32_t eeconfig_read_rgblight(void) {
   return eeprom_read_dword(EECONFIG_RGBLIGHT);
@@ -217,6 +323,9 @@ void rgblight_mode(uint8_t mode) {
   }
   eeconfig_update_rgblight(rgblight_config.raw);
   xprintf("rgblight mode: %u\n", rgblight_config.mode);
+  #ifdef RGBLIGHT_ANIMATIONS
+    rgblight_mode_zone(rgblight_config.mode);
+  #endif
   if (rgblight_config.mode == 1) {
     #ifdef RGBLIGHT_ANIMATIONS
       rgblight_timer_disable();
@@ -253,7 +362,7 @@ void rgblight_toggle(void) {
     #ifdef RGBLIGHT_ANIMATIONS
       rgblight_timer_disable();
     #endif
-    _delay_ms(50);
+    wait_ms(50);
     rgblight_set();
   }
 }
@@ -344,15 +453,10 @@ void rgblight_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
         hue = rgblight_config.hue;
       } else if (rgblight_config.mode >= 25 && rgblight_config.mode <= 34) {
         // static gradient
-        uint16_t _hue;
-        int8_t direction = ((rgblight_config.mode - 25) % 2) ? -1 : 1;
-        uint16_t range = pgm_read_word(&RGBLED_GRADIENT_RANGES[(rgblight_config.mode - 25) / 2]);
-        for (uint8_t i = 0; i < RGBLED_NUM; i++) {
-          _hue = (range / RGBLED_NUM * i * direction + hue + 360) % 360;
-          dprintf("rgblight rainbow set hsv: %u,%u,%d,%u\n", i, _hue, direction, range);
-          sethsv(_hue, sat, val, (LED_TYPE *)&led[i]);
-        }
-        rgblight_set();
+        int16_t step = rgblight_gradient_step(rgblight_config.mode);
+        dprintf("rgblight rainbow set hsv: %u,%u,%u\n", hue, sat, val);
+        rgblight_write_hue_ramp(0, RGBLED_NUM, hue_to_wheel(hue), step, sat, val);
+        rgblight_flush();
       }
     }
     rgblight_config.hue = hue;
@@ -366,33 +470,42 @@ void rgblight_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
 void rgblight_setrgb(uint8_t r, uint8_t g, uint8_t b) {
   // dprintf("rgblight set rgb: %u,%u,%u\n", r,g,b);
   for (uint8_t i = 0; i < RGBLED_NUM; i++) {
-    led[i].r = r;
-    led[i].g = g;
-    led[i].b = b;
+    rgblight_write_rgb(i, r, g, b);
   }
-  rgblight_set();
+  rgblight_flush();
+}
+
+__attribute__ ((weak))
+bool rgblight_driver_busy(void) {
+  return false;
 }
 
 #ifndef RGBLIGHT_CUSTOM_DRIVER
+__attribute__ ((weak))
+void rgblight_driver_write(LED_TYPE *leds, uint16_t count) {
+  #ifdef RGBW
+    ws2812_setleds_rgbw(leds, count);
+  #else
+    ws2812_setleds(leds, count);
+  #endif
+}
+
 void rgblight_set(void) {
-  if (rgblight_config.enable) {
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
-  } else {
+  if (!rgblight_config.enable) {
     for (uint8_t i = 0; i < RGBLED_NUM; i++) {
       led[i].r = 0;
       led[i].g = 0;
       led[i].b = 0;
     }
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
   }
+  rgblight_driver_write(led, RGBLED_NUM);
+  rgblight_dirty_end = 0;
+}
+#else
+// a custom driver only has to provide rgblight_set(), which pushes the whole strip
+__attribute__ ((weak))
+void rgblight_driver_write(LED_TYPE *leds, uint16_t count) {
+  rgblight_set();
 }
 #endif
 
@@ -436,176 +549,390 @@ void rgblight_show_solid_color(uint8_t r, uint8_t g, uint8_t b) {
   rgblight_setrgb(r, g, b);
 }
 
-void rgblight_task(void) {
-  if (rgblight_timer_enabled) {
-    // mode = 1, static light, do nothing here
-    if (rgblight_config.mode >= 2 && rgblight_config.mode <= 5) {
-      // mode = 2 to 5, breathing mode
-      rgblight_effect_breathing(rgblight_config.mode - 2);
-    } else if (rgblight_config.mode >= 6 && rgblight_config.mode <= 8) {
-      // mode = 6 to 8, rainbow mood mod
-      rgblight_effect_rainbow_mood(rgblight_config.mode - 6);
-    } else if (rgblight_config.mode >= 9 && rgblight_config.mode <= 14) {
-      // mode = 9 to 14, rainbow swirl mode
-      rgblight_effect_rainbow_swirl(rgblight_config.mode - 9);
-    } else if (rgblight_config.mode >= 15 && rgblight_config.mode <= 20) {
-      // mode = 15 to 20, snake mode
-      rgblight_effect_snake(rgblight_config.mode - 15);
-    } else if (rgblight_config.mode >= 21 && rgblight_config.mode <= 23) {
-      // mode = 21 to 23, knight mode
-      rgblight_effect_knight(rgblight_config.mode - 21);
-    } else if (rgblight_config.mode == 24) {
-      // mode = 24, christmas mode
-      rgblight_effect_christmas();
+// Effects
+
+// The state of the built in effects, holding the frame to render and what is needed to step to the next one
+typedef struct {
+  LED_TYPE color;
+  uint8_t pos;
+} rgblight_breathing_state_t;
+
+typedef struct {
+  LED_TYPE color;
+  uint16_t hue;
+} rgblight_rainbow_mood_state_t;
+
+typedef struct {
+  uint16_t hue;
+  uint16_t frame_hue;  // on the wheel of hsv_to_rgb_n()
+  uint16_t hue_step;
+} rgblight_rainbow_swirl_state_t;
+
+typedef struct {
+  uint8_t pos;
+  uint8_t frame_pos;
+  int8_t increment;
+} rgblight_snake_state_t;
+
+typedef struct {
+  int8_t low_bound;
+  int8_t high_bound;
+  int8_t increment;
+  int8_t frame_low_bound;
+  int8_t frame_high_bound;
+  LED_TYPE color;
+} rgblight_knight_state_t;
+
+typedef struct {
+  uint8_t offset;
+  LED_TYPE colors[2];
+} rgblight_christmas_state_t;
+
+typedef struct {
+  rgblight_zone_t zone;  // first, so that rgblight_zone_write() can get back to the slot
+  const rgblight_effect_t *effect;  // NULL when the zone is stopped
+  uint8_t variant;
+  uint8_t next;  // the next LED of the frame to render, zone.count when it's complete
+  uint16_t last_timer;
+  uint16_t interval;
+  union {
+    rgblight_breathing_state_t breathing;
+    rgblight_rainbow_mood_state_t rainbow_mood;
+    rgblight_rainbow_swirl_state_t rainbow_swirl;
+    rgblight_snake_state_t snake;
+    rgblight_knight_state_t knight;
+    rgblight_christmas_state_t christmas;
+    uint8_t raw[RGBLIGHT_EFFECT_STATE_SIZE];
+  } state;
+} rgblight_zone_slot_t;
+
+static rgblight_zone_slot_t rgblight_zones[RGBLIGHT_ZONES];
+
+void rgblight_zone_write(const rgblight_zone_t *zone, uint8_t i, const LED_TYPE *color) {
+  // the zones after this one are drawn over it
+  const rgblight_zone_slot_t *above = (const rgblight_zone_slot_t *)zone + 1;
+  for (; above < rgblight_zones + RGBLIGHT_ZONES; above++) {
+    if (above->effect && i >= above->zone.first && i - above->zone.first < above->zone.count) {
+      return;
     }
   }
+  rgblight_write_rgb(i, color->r, color->g, color->b);
 }
 
-// Effects
-void rgblight_effect_breathing(uint8_t interval) {
-  static uint8_t pos = 0;
-  static uint16_t last_timer = 0;
-
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_BREATHING_INTERVALS[interval])) {
-    return;
+// breathing and rainbow mood light the whole zone in one color, the first member of their state
+static void rgblight_effect_solid_render(const void *state, const rgblight_zone_t *zone, uint8_t first, uint8_t end) {
+  for (uint8_t i = first; i < end; i++) {
+    rgblight_zone_write(zone, i, (const LED_TYPE *)state);
   }
-  last_timer = timer_read();
+}
 
-  rgblight_sethsv_noeeprom(rgblight_config.hue, rgblight_config.sat, pgm_read_byte(&LED_BREATHING_TABLE[pos]));
-  pos = (pos + 1) % 256;
+static uint16_t rgblight_effect_breathing_step(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+  rgblight_breathing_state_t *breathing = state;
+  sethsv(rgblight_config.hue, rgblight_config.sat, pgm_read_byte(&LED_BREATHING_TABLE[breathing->pos]), &breathing->color);
+  breathing->pos++;
+  return pgm_read_byte(&RGBLED_BREATHING_INTERVALS[variant]);
 }
-void rgblight_effect_rainbow_mood(uint8_t interval) {
-  static uint16_t current_hue = 0;
-  static uint16_t last_timer = 0;
 
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[interval])) {
-    return;
-  }
-  last_timer = timer_read();
-  rgblight_sethsv_noeeprom(current_hue, rgblight_config.sat, rgblight_config.val);
-  current_hue = (current_hue + 1) % 360;
+const rgblight_effect_t rgblight_effect_breathing = {
+  .state_size = sizeof(rgblight_breathing_state_t),
+  .step = rgblight_effect_breathing_step,
+  .render = rgblight_effect_solid_render,
+};
+
+static uint16_t rgblight_effect_rainbow_mood_step(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+  rgblight_rainbow_mood_state_t *mood = state;
+  sethsv(mood->hue, rgblight_config.sat, rgblight_config.val, &mood->color);
+  mood->hue = (mood->hue + 1) % 360;
+  return pgm_read_byte(&RGBLED_RAINBOW_MOOD_INTERVALS[variant]);
+}
+
+const rgblight_effect_t rgblight_effect_rainbow_mood = {
+  .state_size = sizeof(rgblight_rainbow_mood_state_t),
+  .step = rgblight_effect_rainbow_mood_step,
+  .render = rgblight_effect_solid_render,
+};
+
+static void rgblight_effect_rainbow_swirl_init(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+  rgblight_rainbow_swirl_state_t *swirl = state;
+  swirl->hue_step = 0x10000UL / zone->count;
 }
-void rgblight_effect_rainbow_swirl(uint8_t interval) {
-  static uint16_t current_hue = 0;
-  static uint16_t last_timer = 0;
-  uint16_t hue;
-  uint8_t i;
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_SWIRL_INTERVALS[interval / 2])) {
-    return;
-  }
-  last_timer = timer_read();
-  for (i = 0; i < RGBLED_NUM; i++) {
-    hue = (360 / RGBLED_NUM * i + current_hue) % 360;
-    sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
-  }
-  rgblight_set();
 
-  if (interval % 2) {
-    current_hue = (current_hue + 1) % 360;
+static uint16_t rgblight_effect_rainbow_swirl_step(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+  rgblight_rainbow_swirl_state_t *swirl = state;
+  swirl->frame_hue = hue_to_wheel(swirl->hue);
+  if (variant % 2) {
+    swirl->hue = (swirl->hue + 1) % 360;
   } else {
-    if (current_hue - 1 < 0) {
-      current_hue = 359;
+    if (swirl->hue - 1 < 0) {
+      swirl->hue = 359;
     } else {
-      current_hue = current_hue - 1;
+      swirl->hue = swirl->hue - 1;
     }
   }
+  return pgm_read_byte(&RGBLED_RAINBOW_SWIRL_INTERVALS[variant / 2]);
 }
-void rgblight_effect_snake(uint8_t interval) {
-  static uint8_t pos = 0;
-  static uint16_t last_timer = 0;
-  uint8_t i, j;
-  int8_t k;
-  int8_t increment = 1;
-  if (interval % 2) {
-    increment = -1;
+
+static void rgblight_effect_rainbow_swirl_render(const void *state, const rgblight_zone_t *zone, uint8_t first, uint8_t end) {
+  const rgblight_rainbow_swirl_state_t *swirl = state;
+  uint16_t hue = swirl->frame_hue + (first - zone->first) * swirl->hue_step;
+  LED_TYPE tmp_leds[8];
+  while (first < end) {
+    uint8_t count = end - first < 8 ? end - first : 8;
+    hsv_to_rgb_n(hue, swirl->hue_step, rgblight_config.sat, rgblight_config.val, tmp_leds, count);
+    for (uint8_t i = 0; i < count; i++) {
+      rgblight_zone_write(zone, first + i, &tmp_leds[i]);
+    }
+    first += count;
+    hue += swirl->hue_step * count;
   }
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_SNAKE_INTERVALS[interval / 2])) {
-    return;
+}
+
+const rgblight_effect_t rgblight_effect_rainbow_swirl = {
+  .state_size = sizeof(rgblight_rainbow_swirl_state_t),
+  .init = rgblight_effect_rainbow_swirl_init,
+  .step = rgblight_effect_rainbow_swirl_step,
+  .render = rgblight_effect_rainbow_swirl_render,
+};
+
+static uint16_t rgblight_effect_snake_step(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+  rgblight_snake_state_t *snake = state;
+  snake->frame_pos = snake->pos;
+  snake->increment = variant % 2 ? -1 : 1;
+  if (snake->increment == -1) {
+    snake->pos = (snake->pos + 1) % zone->count;
+  } else {
+    if (snake->pos - 1 < 0) {
+      snake->pos = zone->count - 1;
+    } else {
+      snake->pos -= 1;
+    }
   }
-  last_timer = timer_read();
-  for (i = 0; i < RGBLED_NUM; i++) {
-    led[i].r = 0;
-    led[i].g = 0;
-    led[i].b = 0;
+  return pgm_read_byte(&RGBLED_SNAKE_INTERVALS[variant / 2]);
+}
+
+static void rgblight_effect_snake_render(const void *state, const rgblight_zone_t *zone, uint8_t first, uint8_t end) {
+  const rgblight_snake_state_t *snake = state;
+  for (uint8_t i = first; i < end; i++) {
+    LED_TYPE tmp_led = {0};
+    uint8_t j;
+    int8_t k;
     for (j = 0; j < RGBLIGHT_EFFECT_SNAKE_LENGTH; j++) {
-      k = pos + j * increment;
+      k = snake->frame_pos + j * snake->increment;
       if (k < 0) {
-        k = k + RGBLED_NUM;
+        k = k + zone->count;
       }
-      if (i == k) {
-        sethsv(rgblight_config.hue, rgblight_config.sat, (uint8_t)(rgblight_config.val*(RGBLIGHT_EFFECT_SNAKE_LENGTH-j)/RGBLIGHT_EFFECT_SNAKE_LENGTH), (LED_TYPE *)&led[i]);
+      if (i - zone->first == k) {
+        sethsv(rgblight_config.hue, rgblight_config.sat, (uint8_t)(rgblight_config.val*(RGBLIGHT_EFFECT_SNAKE_LENGTH-j)/RGBLIGHT_EFFECT_SNAKE_LENGTH), &tmp_led);
       }
     }
-  }
-  rgblight_set();
-  if (increment == 1) {
-    if (pos - 1 < 0) {
-      pos = RGBLED_NUM - 1;
-    } else {
-      pos -= 1;
-    }
-  } else {
-    pos = (pos + 1) % RGBLED_NUM;
+    rgblight_zone_write(zone, i, &tmp_led);
   }
 }
-void rgblight_effect_knight(uint8_t interval) {
-  static uint16_t last_timer = 0;
-  if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_KNIGHT_INTERVALS[interval])) {
-    return;
-  }
-  last_timer = timer_read();
 
-  static int8_t low_bound = 0;
-  static int8_t high_bound = RGBLIGHT_EFFECT_KNIGHT_LENGTH - 1;
-  static int8_t increment = 1;
-  uint8_t i, cur;
+const rgblight_effect_t rgblight_effect_snake = {
+  .state_size = sizeof(rgblight_snake_state_t),
+  .step = rgblight_effect_snake_step,
+  .render = rgblight_effect_snake_render,
+};
+static uint8_t rgblight_knight_led_num(const rgblight_zone_t *zone) {
+  return RGBLIGHT_EFFECT_KNIGHT_LED_NUM < zone->count ? RGBLIGHT_EFFECT_KNIGHT_LED_NUM : zone->count;
+}
+
+static void rgblight_effect_knight_init(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+  rgblight_knight_state_t *knight = state;
+  knight->high_bound = RGBLIGHT_EFFECT_KNIGHT_LENGTH - 1;
+  knight->increment = 1;
+}
+
+static uint16_t rgblight_effect_knight_step(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+  rgblight_knight_state_t *knight = state;
+  knight->frame_low_bound = knight->low_bound;
+  knight->frame_high_bound = knight->high_bound;
+  sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, &knight->color);
+
+  // Move from low_bound to high_bound changing the direction we increment each
+  // time a boundary is hit.
+  knight->low_bound += knight->increment;
+  knight->high_bound += knight->increment;
 
-  // Set all the LEDs to 0
-  for (i = 0; i < RGBLED_NUM; i++) {
-    led[i].r = 0;
-    led[i].g = 0;
-    led[i].b = 0;
+  if (knight->high_bound <= 0 || knight->low_bound >= rgblight_knight_led_num(zone) - 1) {
+    knight->increment = -knight->increment;
   }
-  // Determine which LEDs should be lit up
-  for (i = 0; i < RGBLIGHT_EFFECT_KNIGHT_LED_NUM; i++) {
-    cur = (i + RGBLIGHT_EFFECT_KNIGHT_OFFSET) % RGBLED_NUM;
+  return pgm_read_byte(&RGBLED_KNIGHT_INTERVALS[variant]);
+}
+
+static void rgblight_effect_knight_render(const void *state, const rgblight_zone_t *zone, uint8_t first, uint8_t end) {
+  const rgblight_knight_state_t *knight = state;
+  const LED_TYPE off = {0};
+  uint8_t led_num = rgblight_knight_led_num(zone);
+  for (uint8_t cur = first; cur < end; cur++) {
+    // the position of the LED within the knight rider strip
+    uint8_t i = (cur - zone->first + zone->count - RGBLIGHT_EFFECT_KNIGHT_OFFSET % zone->count) % zone->count;
 
-    if (i >= low_bound && i <= high_bound) {
-      sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[cur]);
+    if (i < led_num && i >= knight->frame_low_bound && i <= knight->frame_high_bound) {
+      rgblight_zone_write(zone, cur, &knight->color);
     } else {
-      led[cur].r = 0;
-      led[cur].g = 0;
-      led[cur].b = 0;
+      rgblight_zone_write(zone, cur, &off);
     }
   }
-  rgblight_set();
+}
 
-  // Move from low_bound to high_bound changing the direction we increment each
-  // time a boundary is hit.
-  low_bound += increment;
-  high_bound += increment;
+const rgblight_effect_t rgblight_effect_knight = {
+  .state_size = sizeof(rgblight_knight_state_t),
+  .init = rgblight_effect_knight_init,
+  .step = rgblight_effect_knight_step,
+  .render = rgblight_effect_knight_render,
+};
+
+static uint16_t rgblight_effect_christmas_step(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+  rgblight_christmas_state_t *christmas = state;
+  christmas->offset = (christmas->offset + 1) % 2;
+  // only red and green, so they're converted once per frame
+  sethsv(0, rgblight_config.sat, rgblight_config.val, &christmas->colors[0]);
+  sethsv(120, rgblight_config.sat, rgblight_config.val, &christmas->colors[1]);
+  return RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL;
+}
+
+static void rgblight_effect_christmas_render(const void *state, const rgblight_zone_t *zone, uint8_t first, uint8_t end) {
+  const rgblight_christmas_state_t *christmas = state;
+  for (uint8_t i = first; i < end; i++) {
+    rgblight_zone_write(zone, i, &christmas->colors[((i - zone->first)/RGBLIGHT_EFFECT_CHRISTMAS_STEP + christmas->offset) % 2]);
+  }
+}
+
+const rgblight_effect_t rgblight_effect_christmas = {
+  .state_size = sizeof(rgblight_christmas_state_t),
+  .step = rgblight_effect_christmas_step,
+  .render = rgblight_effect_christmas_render,
+};
+
+// The animated modes, the effect runs with the variant mode - first_mode
+static const struct {
+  uint8_t first_mode;
+  uint8_t last_mode;
+  const rgblight_effect_t *effect;
+} rgblight_mode_effects[] = {
+  { 2, 5, &rgblight_effect_breathing },
+  { 6, 8, &rgblight_effect_rainbow_mood },
+  { 9, 14, &rgblight_effect_rainbow_swirl },
+  { 15, 20, &rgblight_effect_snake },
+  { 21, 23, &rgblight_effect_knight },
+  { 24, 24, &rgblight_effect_christmas },
+};
+
+// the mode runs on zone 0, covering the whole strip
+static void rgblight_mode_zone(uint8_t mode) {
+  for (uint8_t i = 0; i < sizeof(rgblight_mode_effects) / sizeof(rgblight_mode_effects[0]); i++) {
+    if (mode >= rgblight_mode_effects[i].first_mode && mode <= rgblight_mode_effects[i].last_mode) {
+      rgblight_zone_start(0, 0, RGBLED_NUM, rgblight_mode_effects[i].effect, mode - rgblight_mode_effects[i].first_mode);
+      return;
+    }
+  }
+  rgblight_zone_stop(0);
+}
 
-  if (high_bound <= 0 || low_bound >= RGBLIGHT_EFFECT_KNIGHT_LED_NUM - 1) {
-    increment = -increment;
+bool rgblight_zone_start(uint8_t index, uint8_t first, uint8_t count, const rgblight_effect_t *effect, uint8_t variant) {
+  if (index >= RGBLIGHT_ZONES || count == 0 || first + count > RGBLED_NUM) {
+    return false;
+  }
+  rgblight_zone_slot_t *slot = &rgblight_zones[index];
+  if (effect->state_size > sizeof(slot->state)) {
+    return false;
+  }
+  slot->zone.first = first;
+  slot->zone.count = count;
+  slot->effect = effect;
+  slot->variant = variant;
+  slot->next = count;
+  // step to the first frame on the next task
+  slot->last_timer = timer_read();
+  slot->interval = 0;
+  memset(&slot->state, 0, sizeof(slot->state));
+  if (effect->init) {
+    effect->init(&slot->state, &slot->zone, variant);
+  }
+  return true;
+}
+
+// Redraws the static mode on the LEDs [first, end), under the running zones
+static void rgblight_static_render(uint8_t first, uint8_t end) {
+  const rgblight_zone_t *zone = &rgblight_zones[0].zone;
+  LED_TYPE tmp_leds[8];
+  if (rgblight_config.mode >= 25 && rgblight_config.mode <= 34) {
+    int16_t step = rgblight_gradient_step(rgblight_config.mode);
+    uint16_t hue = hue_to_wheel(rgblight_config.hue) + step * first;
+    while (first < end) {
+      uint8_t count = end - first < 8 ? end - first : 8;
+      hsv_to_rgb_n(hue, step, rgblight_config.sat, rgblight_config.val, tmp_leds, count);
+      for (uint8_t i = 0; i < count; i++) {
+        rgblight_zone_write(zone, first + i, &tmp_leds[i]);
+      }
+      first += count;
+      hue += step * count;
+    }
+  } else {
+    sethsv(inmem_config.hue, inmem_config.sat, inmem_config.val, &tmp_leds[0]);
+    for (; first < end; first++) {
+      rgblight_zone_write(zone, first, &tmp_leds[0]);
+    }
   }
 }
 
+void rgblight_zone_stop(uint8_t index) {
+  if (index >= RGBLIGHT_ZONES || !rgblight_zones[index].effect) {
+    return;
+  }
+  rgblight_zone_slot_t *slot = &rgblight_zones[index];
+  slot->effect = NULL;
+  if (index == 0 || !rgblight_config.enable) {
+    return;
+  }
+  // the LEDs below show through again: the static mode right away, and the
+  // zones below with their current frame, pushed by rgblight_task()
+  if (!rgblight_zones[0].effect) {
+    rgblight_static_render(slot->zone.first, slot->zone.first + slot->zone.count);
+  }
+  for (uint8_t z = 0; z < index; z++) {
+    if (rgblight_zones[z].effect) {
+      rgblight_zones[z].next = 0;
+    }
+  }
+}
 
-void rgblight_effect_christmas(void) {
-  static uint16_t current_offset = 0;
-  static uint16_t last_timer = 0;
-  uint16_t hue;
-  uint8_t i;
-  if (timer_elapsed(last_timer) < RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL) {
+void rgblight_task(void) {
+  if (!rgblight_config.enable || rgblight_driver_busy()) {
+    // while the previous frame is still being sent, don't start rendering into the LEDs
     return;
   }
-  last_timer = timer_read();
-  current_offset = (current_offset + 1) % 2;
-  for (i = 0; i < RGBLED_NUM; i++) {
-    hue = 0 + ((i/RGBLIGHT_EFFECT_CHRISTMAS_STEP + current_offset) % 2) * 120;
-    sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
+  uint8_t budget = RGBLIGHT_LEDS_PER_TASK;
+  bool rendering = false;
+  for (uint8_t z = 0; z < RGBLIGHT_ZONES; z++) {
+    rgblight_zone_slot_t *slot = &rgblight_zones[z];
+    // zone 0 runs the mode, which can be paused
+    if (!slot->effect || (z == 0 && !rgblight_timer_enabled)) {
+      continue;
+    }
+    if (slot->next == slot->zone.count && timer_elapsed(slot->last_timer) >= slot->interval) {
+      slot->last_timer = timer_read();
+      slot->interval = slot->effect->step(&slot->state, &slot->zone, slot->variant);
+      slot->next = 0;
+    }
+    if (slot->next < slot->zone.count) {
+      uint8_t count = slot->zone.count - slot->next;
+      if (count > budget) {
+        count = budget;
+      }
+      uint8_t first = slot->zone.first + slot->next;
+      slot->effect->render(&slot->state, &slot->zone, first, first + count);
+      slot->next += count;
+      budget -= count;
+      rendering |= slot->next < slot->zone.count;
+    }
+  }
+  // a frame is pushed once all zones have completed theirs
+  if (!rendering) {
+    rgblight_flush();
   }
-  rgblight_set();
 }
 
 #endif
@@ -46,6 +46,28 @@
 #define RGBLIGHT_EFFECT_CHRISTMAS_STEP 2
 #endif
 
+/*
+ * How many LEDs of an animation frame are computed per call of rgblight_task().
+ * A frame is spread over as many scans as needed and pushed once complete, so
+ * long strips don't stall the scan loop.
+ */
+#ifndef RGBLIGHT_LEDS_PER_TASK
+#define RGBLIGHT_LEDS_PER_TASK 8
+#endif
+
+/*
+ * The number of zones effects can run on at the same time; zone 0 runs the
+ * current mode, over the whole strip.
+ */
+#ifndef RGBLIGHT_ZONES
+#define RGBLIGHT_ZONES 1
+#endif
+
+/* the size of the state an effect of a zone can keep, in bytes */
+#ifndef RGBLIGHT_EFFECT_STATE_SIZE
+#define RGBLIGHT_EFFECT_STATE_SIZE 8
+#endif
+
 #ifndef RGBLIGHT_HUE_STEP
 #define RGBLIGHT_HUE_STEP 10
 #endif
@@ -67,6 +89,10 @@
 #endif
 #include "rgblight_types.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 extern LED_TYPE led[RGBLED_NUM];
 
 extern const uint8_t RGBLED_BREATHING_INTERVALS[4] PROGMEM;
@@ -112,9 +138,33 @@ void eeconfig_update_rgblight_default(void);
 void eeconfig_debug_rgblight(void);
 
 void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1);
+
+/*
+ * Converts 'count' colors at once without any division, for the animations.
+ * The hue is on a wheel of 0x10000 steps, of which the top 12 bits are used,
+ * and advances by 'hue_step' for every LED, wrapping around, so a ramp of
+ * hues costs nothing extra; use 0 for a single color.
+ */
+void hsv_to_rgb_n(uint16_t hue, int16_t hue_step, uint8_t sat, uint8_t val, LED_TYPE *leds, uint8_t count);
+
+/* the position of a hue in degrees (0-359) on the wheel of hsv_to_rgb_n() */
+static inline uint16_t hue_to_wheel(uint16_t hue) {
+  return ((uint32_t)hue * 46603) >> 8;
+}
 void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1);
 void rgblight_sethsv_noeeprom(uint16_t hue, uint8_t sat, uint8_t val);
 
+/*
+ * Driver hooks. rgblight_driver_write() sends the first 'count' LEDs of the
+ * strip; the default drives ws2812 and returns when done. A driver that sends
+ * from a timer or DMA interrupt instead overrides it to start the transfer,
+ * copying 'leds' since the next frame is rendered into them right away, and
+ * overrides rgblight_driver_busy() so that the animations wait for it.
+ * With RGBLIGHT_CUSTOM_DRIVER the default calls rgblight_set() instead.
+ */
+void rgblight_driver_write(LED_TYPE *leds, uint16_t count);
+bool rgblight_driver_busy(void);
+
 #define EZ_RGB(val) rgblight_show_solid_color((val >> 16) & 0xFF, (val >> 8) & 0xFF, val & 0xFF)
 void rgblight_show_solid_color(uint8_t r, uint8_t g, uint8_t b);
 
@@ -124,11 +174,50 @@ void rgblight_timer_init(void);
 void rgblight_timer_enable(void);
 void rgblight_timer_disable(void);
 void rgblight_timer_toggle(void);
-void rgblight_effect_breathing(uint8_t interval);
-void rgblight_effect_rainbow_mood(uint8_t interval);
-void rgblight_effect_rainbow_swirl(uint8_t interval);
-void rgblight_effect_snake(uint8_t interval);
-void rgblight_effect_knight(uint8_t interval);
-void rgblight_effect_christmas(void);
+
+#ifdef RGBLIGHT_ANIMATIONS
+/* the LEDs [first, first + count) of the strip */
+typedef struct {
+  uint8_t first;
+  uint8_t count;
+} rgblight_zone_t;
+
+/*
+ * An animation effect. It keeps all of its state in the 'state_size' bytes
+ * that the zone it runs on provides, cleared before 'init' (which may be NULL)
+ * is called, so the same effect can run on several zones. 'step' advances the
+ * state to the next frame and returns the number of ms until the one after,
+ * 'render' then draws the LEDs [first, end) of that frame, possibly over
+ * several calls, with rgblight_zone_write().
+ */
+typedef struct {
+  uint8_t state_size;
+  void (*init)(void *state, const rgblight_zone_t *zone, uint8_t variant);
+  uint16_t (*step)(void *state, const rgblight_zone_t *zone, uint8_t variant);
+  void (*render)(const void *state, const rgblight_zone_t *zone, uint8_t first, uint8_t end);
+} rgblight_effect_t;
+
+extern const rgblight_effect_t rgblight_effect_breathing;      // variants 0-3
+extern const rgblight_effect_t rgblight_effect_rainbow_mood;   // variants 0-2
+extern const rgblight_effect_t rgblight_effect_rainbow_swirl;  // variants 0-5
+extern const rgblight_effect_t rgblight_effect_snake;          // variants 0-5
+extern const rgblight_effect_t rgblight_effect_knight;         // variants 0-2
+extern const rgblight_effect_t rgblight_effect_christmas;
+
+/*
+ * Runs 'effect' on the LEDs [first, first + count), replacing what zone
+ * 'index' ran before. Zones with a higher index are drawn over the lower ones
+ * where they overlap. Returns false if the zone doesn't fit the strip or the
+ * effect needs more than RGBLIGHT_EFFECT_STATE_SIZE bytes of state.
+ */
+bool rgblight_zone_start(uint8_t index, uint8_t first, uint8_t count, const rgblight_effect_t *effect, uint8_t variant);
+/* Stops zone 'index', its LEDs show the zones below it or the static mode again */
+void rgblight_zone_stop(uint8_t index);
+void rgblight_zone_write(const rgblight_zone_t *zone, uint8_t i, const LED_TYPE *color);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
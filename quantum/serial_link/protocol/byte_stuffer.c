@@ -102,41 +102,54 @@ void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
     }
 }
 
-static void send_block(uint8_t link, uint8_t* start, uint8_t* end, uint8_t num_non_zero) {
-    send_data(link, &num_non_zero, 1);
-    if (end > start) {
-        send_data(link, start, end-start);
+// The frames are encoded into one buffer, so that the driver gets a whole
+// frame in a single write instead of two writes per block. The buffer fits
+// the largest frame that can be received, bigger ones are sent in pieces.
+#define TX_BUFFER_SIZE (MAX_FRAME_SIZE + MAX_FRAME_SIZE / 254 + 2)
+static uint8_t tx_buffer[TX_BUFFER_SIZE];
+
+// Makes sure that the next block and the frame end fit into the buffer
+static uint8_t* reserve_block(uint8_t link, uint8_t* out, uint16_t remaining) {
+    uint16_t needed = (remaining < 254 ? remaining : 254) + 2;
+    if (tx_buffer + TX_BUFFER_SIZE - out < needed) {
+        send_data(link, tx_buffer, out - tx_buffer);
+        out = tx_buffer;
     }
+    return out;
 }
 
 void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
-    const uint8_t zero = 0;
     if (size > 0) {
-        uint16_t num_non_zero = 1;
+        uint8_t num_non_zero = 1;
         uint8_t* end = data + size;
-        uint8_t* start = data;
+        uint8_t* out = reserve_block(link, tx_buffer, size);
+        uint8_t* block = out++;
         while (data < end) {
             if (num_non_zero == 0xFF) {
                 // There's more data after big non-zero block
-                // So send it, and start a new block
-                send_block(link, start, data, num_non_zero);
-                start = data;
+                // So finish it, and start a new block
+                *block = num_non_zero;
+                out = reserve_block(link, out, end - data);
+                block = out++;
                 num_non_zero = 1;
             }
             else {
                 if (*data == 0) {
-                    // A zero encountered, so send the block
-                    send_block(link, start, data, num_non_zero);
-                    start = data + 1;
+                    // A zero encountered, so finish the block
+                    *block = num_non_zero;
+                    out = reserve_block(link, out, end - data - 1);
+                    block = out++;
                     num_non_zero = 1;
                 }
                 else {
+                    *out++ = *data;
                     num_non_zero++;
                 }
                 ++data;
             }
         }
-        send_block(link, start, data, num_non_zero);
-        send_data(link, &zero, 1);
+        *block = num_non_zero;
+        *out++ = 0;
+        send_data(link, tx_buffer, out - tx_buffer);
     }
 }
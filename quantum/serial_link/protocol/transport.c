@@ -31,6 +31,10 @@ SOFTWARE.
 static remote_object_t* remote_objects[MAX_REMOTE_OBJECTS];
 static uint32_t num_remote_objects = 0;
 
+#ifdef SERIAL_LINK_DELTA_TRANSPORT
+static uint8_t* get_delta_object(remote_object_t* obj, bool local, uint8_t index);
+#endif
+
 void reinitialize_serial_link_transport(void) {
     num_remote_objects = 0;
 }
@@ -70,29 +74,45 @@ void add_remote_objects(remote_object_t** _remote_objects, uint32_t _num_remote_
                 start += REMOTE_OBJECT_SIZE(obj->object_size);
             }
         }
+#ifdef SERIAL_LINK_DELTA_TRANSPORT
+        // nothing sent or received yet, the first update is sent in full
+        unsigned int num_delta = obj->object_type == MASTER_TO_ALL_SLAVES ? 2 : NUM_SLAVES + 1;
+        memset(get_delta_object(obj, true, 0), 0, num_delta * DELTA_OBJECT_SIZE(obj->object_size));
+#endif
+    }
+}
+
+// The triple buffer that receives the object from 'from'
+static triple_buffer_object_t* get_remote_buffer(remote_object_t* obj, uint8_t from) {
+    uint8_t* start;
+    if (obj->object_type == MASTER_TO_ALL_SLAVES) {
+        start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
+    }
+    else if(obj->object_type == SLAVE_TO_MASTER) {
+        start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
+        start += (from - 1) * REMOTE_OBJECT_SIZE(obj->object_size);
     }
+    else {
+        start = obj->buffer + NUM_SLAVES * LOCAL_OBJECT_SIZE(obj->object_size);
+    }
+    return (triple_buffer_object_t*)start;
+}
+
+static void write_remote_object(remote_object_t* obj, uint8_t from, uint8_t* data) {
+    triple_buffer_object_t* tb = get_remote_buffer(obj, from);
+    void* ptr = triple_buffer_begin_write_internal(obj->object_size, tb);
+    memcpy(ptr, data, obj->object_size);
+    triple_buffer_end_write_internal(tb);
 }
 
+#ifndef SERIAL_LINK_DELTA_TRANSPORT
+
 void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size) {
     uint8_t id = data[size-1];
     if (id < num_remote_objects) {
         remote_object_t* obj = remote_objects[id];
         if (obj->object_size == size - 1) {
-            uint8_t* start;
-            if (obj->object_type == MASTER_TO_ALL_SLAVES) {
-                start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
-            }
-            else if(obj->object_type == SLAVE_TO_MASTER) {
-                start = obj->buffer + LOCAL_OBJECT_SIZE(obj->object_size);
-                start += (from - 1) * REMOTE_OBJECT_SIZE(obj->object_size);
-            }
-            else {
-                start = obj->buffer + NUM_SLAVES * LOCAL_OBJECT_SIZE(obj->object_size);
-            }
-            triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
-            void* ptr = triple_buffer_begin_write_internal(obj->object_size, tb);
-            memcpy(ptr, data, size - 1);
-            triple_buffer_end_write_internal(tb);
+            write_remote_object(obj, from, data);
         }
     }
 }
@@ -126,3 +146,214 @@ void update_transport(void) {
         }
     }
 }
+
+#else
+
+// Every record of a packed frame starts with the object id, with DELTA_RECORD
+// set if the data is a delta, the sequence number and the length of the data,
+// in one byte below 0x80 and otherwise in two, the first with the top bit set
+#define DELTA_RECORD 0x80
+#define MAX_RECORD_HEADER_SIZE 4
+#define DELTA_VALID 1
+
+static uint8_t packed_frame[SERIAL_LINK_PACKED_FRAME_SIZE + LOCAL_OBJECT_EXTRA];
+static uint16_t packed_size = 0;
+
+// The copy of the last version sent to, or received from, a destination,
+// behind the triple buffers of the object. The local ones come first.
+static uint8_t* get_delta_object(remote_object_t* obj, bool local, uint8_t index) {
+    unsigned int num_local = obj->object_type == MASTER_TO_SINGLE_SLAVE ? NUM_SLAVES : 1;
+    unsigned int num_remote = obj->object_type == SLAVE_TO_MASTER ? NUM_SLAVES : 1;
+    uint8_t* start = obj->buffer + num_local * LOCAL_OBJECT_SIZE(obj->object_size);
+    start += num_remote * REMOTE_OBJECT_SIZE(obj->object_size);
+    if (!local) {
+        index += num_local;
+    }
+    return start + index * DELTA_OBJECT_SIZE(obj->object_size);
+}
+
+// Writes 'data' xor 'base' as runs of a count of unchanged bytes, a count of
+// changed bytes and the changed bytes, leaving out the unchanged tail.
+// Returns false if the result isn't shorter than 'limit'.
+static bool delta_encode(uint8_t* data, uint8_t* base, uint16_t size, uint8_t* out, uint16_t limit, uint16_t* length) {
+    uint16_t pos = 0;
+    uint16_t len = 0;
+    while (pos < size) {
+        uint8_t skip = 0;
+        while (pos < size && data[pos] == base[pos] && skip < 255) {
+            skip++;
+            pos++;
+        }
+        if (pos == size) {
+            break;
+        }
+        uint16_t start = pos;
+        uint8_t run = 0;
+        while (pos < size && data[pos] != base[pos] && run < 255) {
+            run++;
+            pos++;
+        }
+        if (len + 2 + run >= limit) {
+            return false;
+        }
+        out[len++] = skip;
+        out[len++] = run;
+        for (uint16_t i = start; i < pos; i++) {
+            out[len++] = data[i] ^ base[i];
+        }
+    }
+    *length = len;
+    return true;
+}
+
+static bool delta_apply(uint8_t* base, uint16_t size, uint8_t* delta, uint16_t length) {
+    uint16_t pos = 0;
+    uint16_t i = 0;
+    while (i < length) {
+        if (i + 2 > length) {
+            return false;
+        }
+        pos += delta[i++];
+        uint8_t run = delta[i++];
+        if (pos + run > size || i + run > length) {
+            return false;
+        }
+        while (run--) {
+            base[pos++] ^= delta[i++];
+        }
+    }
+    return true;
+}
+
+static void recv_record(uint8_t from, uint8_t id, uint8_t seq, uint8_t* data, uint16_t size) {
+    bool is_delta = id & DELTA_RECORD;
+    id &= ~DELTA_RECORD;
+    if (id >= num_remote_objects) {
+        return;
+    }
+    remote_object_t* obj = remote_objects[id];
+    uint8_t* delta = get_delta_object(obj, false, obj->object_type == SLAVE_TO_MASTER ? from - 1 : 0);
+    if (is_delta) {
+        // a delta of another version than the one we have is useless, wait for the next keyframe
+        if (!(delta[1] & DELTA_VALID) || (uint8_t)(delta[0] + 1) != seq) {
+            return;
+        }
+        if (!delta_apply(delta + 2, obj->object_size, data, size)) {
+            delta[1] = 0;
+            return;
+        }
+    }
+    else {
+        if (size != obj->object_size) {
+            return;
+        }
+        memcpy(delta + 2, data, size);
+    }
+    delta[0] = seq;
+    delta[1] = DELTA_VALID;
+    write_remote_object(obj, from, delta + 2);
+}
+
+void transport_recv_frame(uint8_t from, uint8_t* data, uint16_t size) {
+    uint16_t pos = 0;
+    while (pos + 3 <= size) {
+        uint8_t* record = data + pos;
+        uint16_t length = record[2];
+        pos += 3;
+        if (length & 0x80) {
+            if (pos == size) {
+                return;
+            }
+            length = (length & 0x7F) | (data[pos++] << 7);
+        }
+        if (length > size - pos) {
+            return;
+        }
+        recv_record(from, record[0], record[1], data + pos, length);
+        pos += length;
+    }
+}
+
+static void flush_packed_frame(uint8_t dest) {
+    if (packed_size) {
+        router_send_frame(dest, packed_frame, packed_size);
+        packed_size = 0;
+    }
+}
+
+static void pack_object(uint8_t dest, uint8_t id, remote_object_t* obj, uint8_t* data, uint8_t* delta) {
+    if (packed_size + MAX_RECORD_HEADER_SIZE + obj->object_size > SERIAL_LINK_PACKED_FRAME_SIZE) {
+        flush_packed_frame(dest);
+    }
+    uint8_t* record = packed_frame + packed_size;
+    uint8_t seq = delta[0] + 1;
+    uint16_t length;
+    bool keyframe = !(delta[1] & DELTA_VALID) || seq % SERIAL_LINK_KEYFRAME_INTERVAL == 0;
+    if (!keyframe && delta_encode(data, delta + 2, obj->object_size, record + 3, obj->object_size, &length)) {
+        record[0] = id | DELTA_RECORD;
+    }
+    else {
+        length = obj->object_size;
+        memcpy(record + 3, data, length);
+        record[0] = id;
+    }
+    record[1] = seq;
+    if (length < 0x80) {
+        record[2] = length;
+        packed_size += 3 + length;
+    }
+    else {
+        memmove(record + 4, record + 3, length);
+        record[2] = length | 0x80;
+        record[3] = length >> 7;
+        packed_size += 4 + length;
+    }
+    memcpy(delta + 2, data, obj->object_size);
+    delta[0] = seq;
+    delta[1] = DELTA_VALID;
+}
+
+// Packs the objects to 'dest' that changed, 0xFF being all slaves
+static void update_destination(uint8_t dest) {
+    unsigned int i;
+    for(i=0;i<num_remote_objects;i++) {
+        remote_object_t* obj = remote_objects[i];
+        uint8_t local;
+        if (obj->object_type == MASTER_TO_ALL_SLAVES) {
+            if (dest != 0xFF) {
+                continue;
+            }
+            local = 0;
+        }
+        else if (obj->object_type == SLAVE_TO_MASTER) {
+            if (dest != 0) {
+                continue;
+            }
+            local = 0;
+        }
+        else {
+            if (dest == 0 || dest == 0xFF) {
+                continue;
+            }
+            local = dest - 1;
+        }
+        uint8_t* start = obj->buffer + local * LOCAL_OBJECT_SIZE(obj->object_size);
+        triple_buffer_object_t* tb = (triple_buffer_object_t*)start;
+        uint8_t* ptr = (uint8_t*)triple_buffer_read_internal(obj->object_size + LOCAL_OBJECT_EXTRA, tb);
+        if (ptr) {
+            pack_object(dest, i, obj, ptr, get_delta_object(obj, true, local));
+        }
+    }
+    flush_packed_frame(dest);
+}
+
+void update_transport(void) {
+    update_destination(0xFF);
+    update_destination(0);
+    unsigned int j;
+    for (j=0;j<NUM_SLAVES;j++) {
+        update_destination(j + 1);
+    }
+}
+
+#endif
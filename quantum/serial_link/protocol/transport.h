@@ -31,6 +31,30 @@ SOFTWARE.
 #define NUM_SLAVES 8
 #define LOCAL_OBJECT_EXTRA 16
 
+// With SERIAL_LINK_DELTA_TRANSPORT defined, all the objects that changed
+// since the last update_transport() are packed into one frame per
+// destination. An object is sent as the xor with the previous version sent
+// to the same destination, run length encoded, and in full every
+// SERIAL_LINK_KEYFRAME_INTERVAL updates, so that a receiver that missed a
+// frame gets back in sync. Both sides have to be built with the same option.
+#ifdef SERIAL_LINK_DELTA_TRANSPORT
+#ifndef SERIAL_LINK_PACKED_FRAME_SIZE
+#define SERIAL_LINK_PACKED_FRAME_SIZE 256
+#endif
+#ifndef SERIAL_LINK_KEYFRAME_INTERVAL
+#define SERIAL_LINK_KEYFRAME_INTERVAL 16
+#endif
+// the sequence number, a valid flag and the previous version of the object
+#define DELTA_OBJECT_SIZE(objectsize) (2 + objectsize)
+// an object has to fit a packed frame with the longest record header
+#define SERIAL_LINK_MAX_OBJECT_SIZE (SERIAL_LINK_PACKED_FRAME_SIZE - 4)
+#define CHECK_OBJECT_SIZE(name, type) \
+    typedef char remote_object_##name##_fits_a_packed_frame[sizeof(type) <= SERIAL_LINK_MAX_OBJECT_SIZE ? 1 : -1];
+#else
+#define DELTA_OBJECT_SIZE(objectsize) 0
+#define CHECK_OBJECT_SIZE(name, type)
+#endif
+
 // master -> slave = 1 local(target all), 1 remote object
 // slave -> master = 1 local(target 0), multiple remote objects
 // master -> single slave (multiple local, target id), 1 remote object
@@ -43,7 +67,7 @@ typedef enum {
 typedef struct {
     remote_object_type object_type;
     uint16_t object_size;
-    uint8_t buffer[] __attribute__((aligned(4)));
+    uint8_t buffer[0] __attribute__((aligned(4)));
 } remote_object_t;
 
 #define REMOTE_OBJECT_SIZE(objectsize) \
@@ -52,11 +76,13 @@ typedef struct {
     (sizeof(triple_buffer_object_t) + (objectsize + LOCAL_OBJECT_EXTRA) * 3)
 
 #define REMOTE_OBJECT_HELPER(name, type, num_local, num_remote) \
+CHECK_OBJECT_SIZE(name, type) \
 typedef struct { \
     remote_object_t object; \
     uint8_t buffer[ \
         num_remote * REMOTE_OBJECT_SIZE(sizeof(type)) + \
-        num_local * LOCAL_OBJECT_SIZE(sizeof(type))]; \
+        num_local * LOCAL_OBJECT_SIZE(sizeof(type)) + \
+        (num_local + num_remote) * DELTA_OBJECT_SIZE(sizeof(type))]; \
 } remote_object_##name##_t;
 
 #define MASTER_TO_ALL_SLAVES_OBJECT(name, type) \
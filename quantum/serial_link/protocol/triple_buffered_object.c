@@ -27,52 +27,89 @@ SOFTWARE.
 #include <stdbool.h>
 #include <stddef.h>
 
-#define GET_READ_INDEX() object->state & 3
-#define GET_WRITE_INDEX() (object->state >> 2) & 3
-#define GET_SHARED_INDEX() (object->state >> 4) & 3
-#define GET_DATA_AVAILABLE() (object->state >> 6) & 1
+#define GET_READ_INDEX(state) ((state) & 3)
+#define GET_WRITE_INDEX(state) (((state) >> 2) & 3)
+#define GET_SHARED_INDEX(state) (((state) >> 4) & 3)
+#define GET_DATA_AVAILABLE(state) (((state) >> 6) & 1)
 
-#define SET_READ_INDEX(i) object->state = ((object->state & ~3) | i)
-#define SET_WRITE_INDEX(i) object->state = ((object->state & ~(3 << 2)) | (i << 2))
-#define SET_SHARED_INDEX(i) object->state = ((object->state & ~(3 << 4)) | (i << 4))
-#define SET_DATA_AVAILABLE(i) object->state = ((object->state & ~(1 << 6)) | (i << 6))
+#define SET_READ_INDEX(state, i) state = (((state) & ~3) | (i))
+#define SET_WRITE_INDEX(state, i) state = (((state) & ~(3 << 2)) | ((i) << 2))
+#define SET_SHARED_INDEX(state, i) state = (((state) & ~(3 << 4)) | ((i) << 4))
+#define SET_DATA_AVAILABLE(state, i) state = (((state) & ~(1 << 6)) | ((i) << 6))
 
-void triple_buffer_init(triple_buffer_object_t* object) {
-    object->state = 0;
-    SET_WRITE_INDEX(0);
-    SET_READ_INDEX(1);
-    SET_SHARED_INDEX(2);
-    SET_DATA_AVAILABLE(0);
+// The reader and the writer each compute the next state from the one they
+// saw, and store it with a compare and swap, retrying if the other side got
+// in between. Where there's no lock free byte compare and swap, like on AVR
+// and Cortex-M0, the swap takes the serial link lock instead.
+#if !defined(__AVR__) && defined(__GCC_ATOMIC_CHAR_LOCK_FREE) && __GCC_ATOMIC_CHAR_LOCK_FREE == 2
+
+static inline uint8_t load_state(triple_buffer_object_t* object) {
+    return __atomic_load_n(&object->state, __ATOMIC_ACQUIRE);
 }
 
-void* triple_buffer_read_internal(uint16_t object_size, triple_buffer_object_t* object) {
+static inline bool swap_state(triple_buffer_object_t* object, uint8_t* expected, uint8_t desired) {
+    return __atomic_compare_exchange_n(&object->state, expected, desired, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+#else
+
+static inline uint8_t load_state(triple_buffer_object_t* object) {
+    return *(volatile uint8_t*)&object->state;
+}
+
+static inline bool swap_state(triple_buffer_object_t* object, uint8_t* expected, uint8_t desired) {
+    bool swapped = false;
     serial_link_lock();
-    if (GET_DATA_AVAILABLE()) {
-        uint8_t shared_index = GET_SHARED_INDEX();
-        uint8_t read_index = GET_READ_INDEX();
-        SET_READ_INDEX(shared_index);
-        SET_SHARED_INDEX(read_index);
-        SET_DATA_AVAILABLE(false);
-        serial_link_unlock();
-        return object->buffer + object_size * shared_index;
+    if (object->state == *expected) {
+        object->state = desired;
+        swapped = true;
     }
     else {
-        serial_link_unlock();
-        return NULL;
+        *expected = object->state;
     }
+    serial_link_unlock();
+    return swapped;
+}
+
+#endif
+
+void triple_buffer_init(triple_buffer_object_t* object) {
+    uint8_t state = 0;
+    SET_WRITE_INDEX(state, 0);
+    SET_READ_INDEX(state, 1);
+    SET_SHARED_INDEX(state, 2);
+    SET_DATA_AVAILABLE(state, 0);
+    object->state = state;
+}
+
+void* triple_buffer_read_internal(uint16_t object_size, triple_buffer_object_t* object) {
+    uint8_t state = load_state(object);
+    uint8_t new_state;
+    do {
+        if (!GET_DATA_AVAILABLE(state)) {
+            return NULL;
+        }
+        new_state = state;
+        SET_READ_INDEX(new_state, GET_SHARED_INDEX(state));
+        SET_SHARED_INDEX(new_state, GET_READ_INDEX(state));
+        SET_DATA_AVAILABLE(new_state, 0);
+    } while (!swap_state(object, &state, new_state));
+    return object->buffer + object_size * GET_SHARED_INDEX(state);
 }
 
 void* triple_buffer_begin_write_internal(uint16_t object_size, triple_buffer_object_t* object) {
-    uint8_t write_index = GET_WRITE_INDEX();
+    // only the writer changes the write index
+    uint8_t write_index = GET_WRITE_INDEX(load_state(object));
     return object->buffer + object_size * write_index;
 }
 
 void triple_buffer_end_write_internal(triple_buffer_object_t* object) {
-    serial_link_lock();
-    uint8_t shared_index = GET_SHARED_INDEX();
-    uint8_t write_index = GET_WRITE_INDEX();
-    SET_SHARED_INDEX(write_index);
-    SET_WRITE_INDEX(shared_index);
-    SET_DATA_AVAILABLE(true);
-    serial_link_unlock();
+    uint8_t state = load_state(object);
+    uint8_t new_state;
+    do {
+        new_state = state;
+        SET_SHARED_INDEX(new_state, GET_WRITE_INDEX(state));
+        SET_WRITE_INDEX(new_state, GET_SHARED_INDEX(state));
+        SET_DATA_AVAILABLE(new_state, 1);
+    } while (!swap_state(object, &state, new_state));
 }
@@ -27,6 +27,8 @@ SOFTWARE.
 
 #include <stdint.h>
 
+// One writer and one reader can use the object at the same time, from
+// different threads or from an interrupt, without taking a lock
 typedef struct {
     uint8_t state;
     uint8_t buffer[] __attribute__((aligned(4)));
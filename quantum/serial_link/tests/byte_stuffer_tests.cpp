@@ -26,6 +26,7 @@ SOFTWARE.
 #include "gmock/gmock.h"
 #include <vector>
 #include <algorithm>
+#include <random>
 extern "C" {
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/frame_validator.h"
@@ -50,9 +51,11 @@ public:
     MOCK_METHOD3(validator_recv_frame, void (uint8_t link, uint8_t* data, uint16_t size));
 
     void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
-        std::copy(data, data + size, std::back_inserter(sent_data));
+        sent_data.insert(sent_data.end(), data, data + size);
+        send_calls++;
     }
     std::vector<uint8_t> sent_data;
+    int send_calls = 0;
 
     static ByteStuffer* Instance;
 };
@@ -481,3 +484,88 @@ TEST_F(ByteStuffer, sends_and_receives_full_roundtrip_254_bytes_and_then_zero) {
        byte_stuffer_recv_byte(1, d);
     }
 }
+
+namespace {
+    // The encoder as it was before the frames were built in one buffer,
+    // with two writes for every block
+    void reference_send_block(uint8_t link, uint8_t* start, uint8_t* end, uint8_t num_non_zero) {
+        send_data(link, &num_non_zero, 1);
+        if (end > start) {
+            send_data(link, start, end-start);
+        }
+    }
+
+    void reference_send_frame(uint8_t link, uint8_t* data, uint16_t size) {
+        const uint8_t zero = 0;
+        if (size > 0) {
+            uint16_t num_non_zero = 1;
+            uint8_t* end = data + size;
+            uint8_t* start = data;
+            while (data < end) {
+                if (num_non_zero == 0xFF) {
+                    reference_send_block(link, start, data, num_non_zero);
+                    start = data;
+                    num_non_zero = 1;
+                }
+                else {
+                    if (*data == 0) {
+                        reference_send_block(link, start, data, num_non_zero);
+                        start = data + 1;
+                        num_non_zero = 1;
+                    }
+                    else {
+                        num_non_zero++;
+                    }
+                    ++data;
+                }
+            }
+            reference_send_block(link, start, data, num_non_zero);
+            send_data(link, &zero, 1);
+        }
+    }
+
+    std::vector<uint8_t> random_frame(std::mt19937& random, uint16_t size, unsigned zero_percent) {
+        std::vector<uint8_t> frame(size);
+        for (auto& d : frame) {
+            d = random() % 100 < zero_percent ? 0 : random() % 255 + 1;
+        }
+        return frame;
+    }
+}
+
+TEST_F(ByteStuffer, sends_a_frame_in_a_single_write) {
+    uint8_t data[300] = {1, 0, 3};
+    byte_stuffer_send_frame(0, data, sizeof(data));
+    EXPECT_EQ(send_calls, 1);
+}
+
+TEST_F(ByteStuffer, sends_the_same_bytes_as_the_block_by_block_encoder) {
+    std::mt19937 random(1);
+    const uint16_t sizes[] = {1, 2, 253, 254, 255, 256, 508, 509, 700, MAX_FRAME_SIZE};
+    const unsigned zero_percents[] = {0, 1, 10, 50, 100};
+    for (uint16_t size : sizes) {
+        for (unsigned zero_percent : zero_percents) {
+            std::vector<uint8_t> frame = random_frame(random, size, zero_percent);
+            sent_data.clear();
+            reference_send_frame(0, frame.data(), size);
+            std::vector<uint8_t> expected = sent_data;
+            sent_data.clear();
+            send_calls = 0;
+            byte_stuffer_send_frame(0, frame.data(), size);
+            EXPECT_EQ(sent_data, expected) << "size " << size << ", " << zero_percent << "% zeroes";
+            EXPECT_EQ(send_calls, 1);
+        }
+    }
+}
+
+TEST_F(ByteStuffer, sends_a_frame_bigger_than_the_buffer_in_pieces) {
+    std::mt19937 random(2);
+    std::vector<uint8_t> frame = random_frame(random, 3 * MAX_FRAME_SIZE, 0);
+    reference_send_frame(0, frame.data(), frame.size());
+    std::vector<uint8_t> expected = sent_data;
+    sent_data.clear();
+    send_calls = 0;
+    byte_stuffer_send_frame(0, frame.data(), frame.size());
+    EXPECT_EQ(sent_data, expected);
+    EXPECT_GT(send_calls, 1);
+}
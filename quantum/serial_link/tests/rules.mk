@@ -20,3 +20,9 @@ serial_link_transport_SRC := \
 	$(SERIAL_PATH)/tests/transport_tests.cpp \
 	$(SERIAL_PATH)/protocol/transport.c \
 	$(SERIAL_PATH)/protocol/triple_buffered_object.c 
+
+serial_link_transport_delta_DEFS := -DSERIAL_LINK_DELTA_TRANSPORT
+serial_link_transport_delta_SRC := \
+	$(SERIAL_PATH)/tests/transport_delta_tests.cpp \
+	$(SERIAL_PATH)/protocol/transport.c \
+	$(SERIAL_PATH)/protocol/triple_buffered_object.c
@@ -0,0 +1,303 @@
+/*
+The MIT License (MIT)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <vector>
+#include <random>
+
+using testing::_;
+using testing::AnyNumber;
+
+extern "C" {
+#include "serial_link/protocol/transport.h"
+}
+
+// Like the status the visualizer sends to the slaves
+struct status_object {
+    uint32_t layer;
+    uint32_t default_layer;
+    uint32_t leds;
+    uint8_t mods;
+    uint8_t suspended;
+    uint16_t backlight;
+};
+
+// Like the half of the matrix a slave sends to the master
+struct matrix_object {
+    uint8_t rows[16];
+};
+
+MASTER_TO_ALL_SLAVES_OBJECT(status, status_object);
+MASTER_TO_ALL_SLAVES_OBJECT(status2, status_object);
+SLAVE_TO_MASTER_OBJECT(matrix, matrix_object);
+
+static remote_object_t* test_remote_objects[] = {
+    REMOTE_OBJECT(status),
+    REMOTE_OBJECT(status2),
+    REMOTE_OBJECT(matrix),
+};
+
+// The largest object that fits a packed frame
+struct big_object {
+    uint8_t data[SERIAL_LINK_MAX_OBJECT_SIZE];
+};
+
+MASTER_TO_ALL_SLAVES_OBJECT(big, big_object);
+
+static remote_object_t* big_remote_objects[] = {
+    REMOTE_OBJECT(big),
+};
+
+class TransportDelta : public testing::Test {
+public:
+    TransportDelta() {
+        Instance = this;
+        add_remote_objects(test_remote_objects, sizeof(test_remote_objects) / sizeof(remote_object_t*));
+        EXPECT_CALL(*this, signal_data_written()).Times(AnyNumber());
+    }
+
+    ~TransportDelta() {
+        Instance = nullptr;
+        reinitialize_serial_link_transport();
+    }
+
+    MOCK_METHOD0(signal_data_written, void ());
+    MOCK_METHOD1(router_send_frame, void (uint8_t destination));
+
+    void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
+        router_send_frame(destination);
+        frames.emplace_back(data, data + size);
+    }
+
+    void write_status(const status_object& value) {
+        *begin_write_status() = value;
+        end_write_status();
+    }
+
+    void write_matrix(const matrix_object& value) {
+        *begin_write_matrix() = value;
+        end_write_matrix();
+    }
+
+    // Sends what changed, and receives it as 'from' unless the frames are dropped
+    void update(uint8_t from, bool drop = false) {
+        frames.clear();
+        update_transport();
+        if (!drop) {
+            for (auto& frame : frames) {
+                transport_recv_frame(from, frame.data(), frame.size());
+            }
+        }
+    }
+
+    static TransportDelta* Instance;
+
+    std::vector<std::vector<uint8_t>> frames;
+};
+
+TransportDelta* TransportDelta::Instance = nullptr;
+
+extern "C" {
+void signal_data_written(void) {
+    TransportDelta::Instance->signal_data_written();
+}
+
+void router_send_frame(uint8_t destination, uint8_t* data, uint16_t size) {
+    TransportDelta::Instance->router_send_frame(destination, data, size);
+}
+}
+
+TEST_F(TransportDelta, the_first_update_is_sent_in_full) {
+    status_object status = {5, 1, 0x3, 0x22, 0, 100};
+    write_status(status);
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    update(0);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].size(), 3 + sizeof(status_object));
+    status_object* received = read_status();
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &status, sizeof(status)), 0);
+}
+
+TEST_F(TransportDelta, only_the_changed_bytes_of_later_updates_are_sent) {
+    status_object status = {5, 1, 0x3, 0x22, 0, 100};
+    write_status(status);
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(2);
+    update(0);
+    read_status();
+    status.mods = 0x20;
+    write_status(status);
+    update(0);
+    ASSERT_EQ(frames.size(), 1u);
+    // the header, and one run of one byte
+    EXPECT_EQ(frames[0].size(), 3u + 3u);
+    status_object* received = read_status();
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &status, sizeof(status)), 0);
+}
+
+TEST_F(TransportDelta, an_unchanged_update_is_still_received) {
+    status_object status = {5, 1, 0x3, 0x22, 0, 100};
+    write_status(status);
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(2);
+    update(0);
+    read_status();
+    write_status(status);
+    update(0);
+    EXPECT_EQ(frames[0].size(), 3u);
+    status_object* received = read_status();
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &status, sizeof(status)), 0);
+}
+
+TEST_F(TransportDelta, objects_to_the_same_destination_share_a_frame) {
+    status_object status = {5, 1, 0x3, 0x22, 0, 100};
+    write_status(status);
+    *begin_write_status2() = status;
+    end_write_status2();
+    matrix_object matrix = {{1, 2, 3}};
+    write_matrix(matrix);
+    EXPECT_CALL(*this, router_send_frame(0xFF));
+    EXPECT_CALL(*this, router_send_frame(0));
+    update(2);
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_NE(read_status(), nullptr);
+    EXPECT_NE(read_status2(), nullptr);
+    matrix_object* received = read_matrix(1);
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &matrix, sizeof(matrix)), 0);
+}
+
+TEST_F(TransportDelta, after_a_lost_frame_deltas_are_ignored_until_the_next_keyframe) {
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(AnyNumber());
+    status_object status = {};
+    write_status(status);
+    update(0);
+    read_status();
+    status.layer = 1;
+    write_status(status);
+    update(0, true);
+
+    int updates = 1;
+    for (;;) {
+        status.layer++;
+        write_status(status);
+        update(0);
+        updates++;
+        status_object* received = read_status();
+        if (received) {
+            EXPECT_EQ(memcmp(received, &status, sizeof(status)), 0);
+            break;
+        }
+        ASSERT_LT(updates, SERIAL_LINK_KEYFRAME_INTERVAL);
+    }
+    // and the deltas apply again
+    status.leds = 0x7;
+    write_status(status);
+    update(0);
+    status_object* received = read_status();
+    ASSERT_NE(received, nullptr);
+    EXPECT_EQ(memcmp(received, &status, sizeof(status)), 0);
+}
+
+TEST_F(TransportDelta, a_corrupt_delta_is_ignored) {
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(AnyNumber());
+    status_object status = {};
+    write_status(status);
+    update(0);
+    read_status();
+    status.backlight = 0x1234;
+    write_status(status);
+    update(0, true);
+    ASSERT_EQ(frames[0].size(), 3u + 4u);
+    // a run past the end of the object
+    frames[0][3] = 15;
+    transport_recv_frame(0, frames[0].data(), frames[0].size());
+    EXPECT_EQ(read_status(), nullptr);
+}
+
+TEST_F(TransportDelta, the_largest_object_fills_a_packed_frame) {
+    add_remote_objects(big_remote_objects, 1);
+    big_object big;
+    for (unsigned i = 0; i < sizeof(big.data); i++) {
+        big.data[i] = i;
+    }
+    EXPECT_CALL(*this, router_send_frame(0xFF)).Times(2);
+    for (int update_number = 0; update_number < 2; update_number++) {
+        *begin_write_big() = big;
+        end_write_big();
+        update(0);
+        ASSERT_EQ(frames.size(), 1u);
+        EXPECT_EQ(frames[0].size(), (size_t)SERIAL_LINK_PACKED_FRAME_SIZE);
+        big_object* received = read_big();
+        ASSERT_NE(received, nullptr);
+        EXPECT_EQ(memcmp(received, &big, sizeof(big)), 0);
+        // every byte changes, so the delta is not shorter
+        for (unsigned i = 0; i < sizeof(big.data); i++) {
+            big.data[i] ^= 0xFF;
+        }
+    }
+}
+
+TEST_F(TransportDelta, packed_deltas_take_a_third_less_bytes_than_one_frame_per_object) {
+    EXPECT_CALL(*this, router_send_frame(_)).Times(AnyNumber());
+    // the router address, crc and byte stuffing of every frame
+    const unsigned frame_overhead = 1 + 4 + 2;
+    std::mt19937 random(1);
+    status_object status = {0, 1, 0, 0, 0, 128};
+    matrix_object matrix = {};
+    unsigned legacy_bytes = 0;
+    unsigned delta_bytes = 0;
+    const int updates = 2000;
+    for (int i = 0; i < updates; i++) {
+        // a key changes every scan that is sent, the status now and then
+        matrix.rows[random() % 5] ^= 1 << (random() % 7);
+        write_matrix(matrix);
+        legacy_bytes += sizeof(matrix_object) + 1 + frame_overhead;
+        bool status_changed = i % 20 == 0;
+        if (status_changed) {
+            if (random() % 2) {
+                status.layer ^= 1 << (random() % 4);
+            } else {
+                status.mods ^= 1 << (random() % 8);
+            }
+            write_status(status);
+            legacy_bytes += sizeof(status_object) + 1 + frame_overhead;
+        }
+
+        update(1);
+        for (auto& frame : frames) {
+            delta_bytes += frame.size() + frame_overhead;
+        }
+        matrix_object* received = read_matrix(0);
+        ASSERT_NE(received, nullptr);
+        EXPECT_EQ(memcmp(received, &matrix, sizeof(matrix)), 0);
+        if (status_changed) {
+            status_object* received_status = read_status();
+            ASSERT_NE(received_status, nullptr);
+            EXPECT_EQ(memcmp(received_status, &status, sizeof(status)), 0);
+        }
+    }
+    EXPECT_LT(delta_bytes * 3, legacy_bytes * 2);
+}
@@ -23,6 +23,8 @@ SOFTWARE.
 */
 
 #include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
 extern "C" {
 #include "serial_link/protocol/triple_buffered_object.h"
 }
@@ -82,3 +84,82 @@ TEST_F(TripleBufferedObject, performs_two_writes_in_the_middle_of_read) {
     EXPECT_EQ(*triple_buffer_read(&test_object), 3);
     EXPECT_EQ(triple_buffer_read(&test_object), nullptr);
 }
+
+struct stress_payload {
+    uint32_t words[16];
+};
+
+struct stress_object {
+    uint8_t state;
+    stress_payload buffer[3];
+};
+
+static const uint32_t stress_writes = 200000;
+
+struct stress_result {
+    uint32_t reads;
+    uint32_t torn_reads;
+    uint32_t out_of_order_reads;
+    uint32_t last;
+};
+
+// Writes every payload with all words set to the sequence number, while the
+// reader checks that it never sees a mix of two writes or an older one
+template<typename Write, typename Read>
+static stress_result run_stress(Write write, Read read) {
+    stress_result result = {};
+    std::atomic<bool> done(false);
+    std::thread reader([&]() {
+        bool finished = false;
+        while (!finished) {
+            finished = done.load();
+            const stress_payload* payload = read();
+            if (!payload) {
+                std::this_thread::yield();
+                continue;
+            }
+            result.reads++;
+            for (int i = 1; i < 16; i++) {
+                if (payload->words[i] != payload->words[0]) {
+                    result.torn_reads++;
+                    break;
+                }
+            }
+            if (payload->words[0] <= result.last) {
+                result.out_of_order_reads++;
+            }
+            result.last = payload->words[0];
+        }
+    });
+    for (uint32_t sequence = 1; sequence <= stress_writes; sequence++) {
+        write(sequence);
+        // let the reader in regularly even on a single core
+        if ((sequence & 15) == 0) {
+            std::this_thread::yield();
+        }
+    }
+    done = true;
+    reader.join();
+    return result;
+}
+
+TEST(TripleBufferedObjectStress, does_not_tear_reads_with_concurrent_writer) {
+    static stress_object object;
+    triple_buffer_init((triple_buffer_object_t*)&object);
+    stress_result result = run_stress(
+        [](uint32_t sequence) {
+            stress_payload* payload = triple_buffer_begin_write(&object);
+            for (int i = 0; i < 16; i++) {
+                payload->words[i] = sequence;
+            }
+            triple_buffer_end_write(&object);
+        },
+        []() -> const stress_payload* {
+            return triple_buffer_read(&object);
+        });
+    EXPECT_GT(result.reads, 0u);
+    EXPECT_EQ(result.torn_reads, 0u);
+    EXPECT_EQ(result.out_of_order_reads, 0u);
+    // the last write is always seen, since the reader polls once more after it
+    EXPECT_EQ(result.last, stress_writes);
+}
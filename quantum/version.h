@@ -0,0 +1,2 @@
+#define QMK_VERSION "8bbb15-dirty"
+#define QMK_BUILDDATE "2026-10-18-04:44:24"
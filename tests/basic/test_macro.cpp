@@ -29,71 +29,54 @@ TEST_F(Macro, PlayASimpleMacro) {
     InSequence s;
     press_key(8, 0);
     uint32_t current_time = timer_read32();
-    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)))
-        .AT_TIME(0);
+    // The macro is sent one report every OUTPUT_QUEUE_INTERVAL, a report
+    // carries the changes until one of them touches a key or a mod again
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_H)))
         .AT_TIME(0);
-    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)))
-        .AT_TIME(0);
-    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(0);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_E)))
-        .AT_TIME(0);
-    // The macro system could actually skip these empty keyboard reports
-    // it should be enough to just send a report with the next key down
-    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(0);
+        .AT_TIME(10);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_L)))
-        .AT_TIME(0);
+        .AT_TIME(20);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(0);
+        .AT_TIME(30);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_L)))
-        .AT_TIME(0);
-    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(0);
+        .AT_TIME(40);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_O)))
-        .AT_TIME(0);
-    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(0);
+        .AT_TIME(50);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_SPACE)))
-        .AT_TIME(0);
+        .AT_TIME(60);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(0);
-    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)))
-        .AT_TIME(100);
+        .AT_TIME(70);
+    // W(100) adds to the interval
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_W)))
-        .AT_TIME(100);
-    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)))
-        .AT_TIME(100);
+        .AT_TIME(180);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(100);
+        .AT_TIME(190);
+    // and so does I(10), after every step of the macro
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_O)))
-    // BUG: The timer should not really have advanced 10 ms here
-    // See issue #1477
-        .AT_TIME(110);
+        .AT_TIME(210);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-    // BUG: The timer should not advance on both keydown and key-up
-    // See issue #1477
-        .AT_TIME(120);
+        .AT_TIME(230);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_R)))
-        .AT_TIME(130);
+        .AT_TIME(250);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(140);
+        .AT_TIME(270);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_L)))
-        .AT_TIME(150);
+        .AT_TIME(290);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(160);
+        .AT_TIME(310);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_D)))
-        .AT_TIME(170);
+        .AT_TIME(330);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(180);
+        .AT_TIME(350);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)))
-        .AT_TIME(190);
+        .AT_TIME(370);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_1)))
-        .AT_TIME(200);
+        .AT_TIME(390);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)))
-        .AT_TIME(210);
+        .AT_TIME(410);
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
-        .AT_TIME(220);
+        .AT_TIME(430);
     run_one_scan_loop();
+    idle_for(430);
 }
\ No newline at end of file
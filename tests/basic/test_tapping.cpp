@@ -18,7 +18,9 @@
 #include "action_tapping.h"
 
 using testing::_;
+using testing::AnyNumber;
 using testing::InSequence;
+using testing::Invoke;
 
 class Tapping : public TestFixture {};
 
@@ -95,3 +97,69 @@ TEST_F(Tapping, ANewTapWithinTappingTermIsBuggy) {
     EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT))).Times(1);
     idle_for(TAPPING_TERM);
 }
+
+TEST_F(Tapping, TypingMoreKeysThanTheWaitingBufferHoldsWhileHoldingAModTapKeepsAllOfThem) {
+    TestDriver driver;
+    InSequence s;
+
+    press_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    // The buffer fills up long before the tapping term, so the mod tap is settled as held
+    const int taps = 12;
+    static_assert(taps * 2 > WAITING_BUFFER_SIZE, "the taps have to overflow the waiting buffer");
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    for (int i = 0; i < taps; i++) {
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, i % 2 ? KC_B : KC_A)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    }
+    for (int i = 0; i < taps; i++) {
+        press_key(i % 2, 0);
+        run_one_scan_loop();
+        release_key(i % 2, 0);
+        run_one_scan_loop();
+    }
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(Tapping, ManyOverlappingModTapRollsLeaveNothingStuck) {
+    TestDriver driver;
+    std::vector<report_keyboard_t> reports;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber())
+        .WillRepeatedly(Invoke([&reports](report_keyboard_t& report) { reports.push_back(report); }));
+
+    // Every mod tap is pressed before the previous one is released
+    const int rolls = 24;
+    for (int i = 0; i < rolls; i++) {
+        press_key(i % 4, 1);
+        run_one_scan_loop();
+        if (i > 0) {
+            release_key((i - 1) % 4, 1);
+            run_one_scan_loop();
+        }
+    }
+    release_key((rolls - 1) % 4, 1);
+    idle_for(TAPPING_TERM + 1);
+
+    const uint8_t taps[] = {KC_Q, KC_R, KC_S, KC_T};
+    const uint8_t mods[] = {MOD_BIT(KC_LSFT), MOD_BIT(KC_LCTL), MOD_BIT(KC_LALT), MOD_BIT(KC_LGUI)};
+    for (int k = 0; k < 4; k++) {
+        bool seen = false;
+        for (auto& report : reports) {
+            seen |= (report.mods & mods[k]) != 0;
+            for (size_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+                seen |= report.keys[i] == taps[k];
+            }
+        }
+        EXPECT_TRUE(seen) << "mod tap " << k << " was dropped";
+    }
+    ASSERT_FALSE(reports.empty());
+    report_keyboard_t empty = {};
+    EXPECT_TRUE(reports.back() == empty);
+}
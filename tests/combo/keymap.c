@@ -0,0 +1,70 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0    1      2      3      4      5      6      7      8            9
+        {KC_A,  KC_B,  KC_C,  KC_D,  KC_E,  KC_F,  KC_G,  KC_H,  LCTL(KC_Z),  LSFT(KC_Z)},
+        {KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO,       KC_NO},
+        {KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO,       KC_NO},
+        {KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO,       KC_NO},
+    },
+};
+
+const uint16_t PROGMEM ab_combo[] = {KC_A, KC_B, COMBO_END};
+const uint16_t PROGMEM cde_combo[] = {KC_C, KC_D, KC_E, COMBO_END};
+const uint16_t PROGMEM fg_combo[] = {KC_F, KC_G, COMBO_END};
+const uint16_t PROGMEM last_combo[] = {LCTL(KC_Z), LSFT(KC_Z), COMBO_END};
+
+// The combos in between use modified keycodes that are not on the keymap,
+// every one of them with its own pair of keys
+static uint16_t filler_combos[COMBO_COUNT][3];
+
+combo_t key_combos[COMBO_COUNT] = {
+    [0] = COMBO(ab_combo, KC_ESC),
+    [1] = COMBO(cde_combo, KC_TAB),
+    [2] = COMBO_ACTION(fg_combo),
+    [COMBO_COUNT - 1] = COMBO(last_combo, KC_ENT),
+};
+
+void init_filler_combos(void) {
+    for (uint16_t i = 3; i < COMBO_COUNT - 1; i++) {
+        uint8_t mods = 1 + i % 15;
+        uint8_t key = KC_F1 + 2 * (i / 15);
+        filler_combos[i][0] = (mods << 8) | key;
+        filler_combos[i][1] = (mods << 8) | (key + 1);
+        filler_combos[i][2] = COMBO_END;
+        key_combos[i].keys = filler_combos[i];
+        key_combos[i].keycode = KC_F1 + i % 12;
+    }
+}
+
+uint16_t last_combo_event_index = 0xFFFF;
+bool last_combo_event_pressed = false;
+
+// COMBO_COUNT is above 255
+void process_combo_event16(uint16_t combo_index, bool pressed) {
+    last_combo_event_index = combo_index;
+    last_combo_event_pressed = pressed;
+}
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    return MACRO_NONE;
+};
+
+void action_function(keyrecord_t *record, uint8_t id, uint8_t opt) {
+}
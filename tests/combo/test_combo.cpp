@@ -0,0 +1,142 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+
+extern "C" {
+    void init_filler_combos(void);
+    extern uint16_t last_combo_event_index;
+    extern bool last_combo_event_pressed;
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+
+class Combo : public TestFixture {
+public:
+    static void SetUpTestCase() {
+        init_filler_combos();
+        TestFixture::SetUpTestCase();
+        combo_index_init();
+    }
+};
+
+TEST_F(Combo, PressingAllKeysSendsTheComboKeycode) {
+    TestDriver driver;
+    InSequence s;
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    run_one_scan_loop();
+    release_key(1, 0);
+    run_one_scan_loop();
+}
+
+TEST_F(Combo, ThreeKeyCombo) {
+    TestDriver driver;
+    InSequence s;
+    press_key(2, 0);
+    press_key(3, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    run_one_scan_loop();
+    press_key(4, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_TAB)));
+    run_one_scan_loop();
+    release_key(2, 0);
+    release_key(3, 0);
+    release_key(4, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    idle_for(3);
+}
+
+TEST_F(Combo, TheLastComboInTheTableIsFound) {
+    TestDriver driver;
+    InSequence s;
+    press_key(8, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    press_key(9, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ENT)));
+    run_one_scan_loop();
+    release_key(8, 0);
+    release_key(9, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    idle_for(2);
+}
+
+TEST_F(Combo, ActionComboCallsProcessComboEvent) {
+    TestDriver driver;
+    // No key is reported, only the releases of the combo keys go through
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    press_key(5, 0);
+    run_one_scan_loop();
+    press_key(6, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(last_combo_event_index, 2);
+    EXPECT_TRUE(last_combo_event_pressed);
+    release_key(5, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(last_combo_event_index, 2);
+    EXPECT_FALSE(last_combo_event_pressed);
+    release_key(6, 0);
+    run_one_scan_loop();
+}
+
+TEST_F(Combo, TappingAComboKeySendsTheKey) {
+    TestDriver driver;
+    InSequence s;
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    // The explicit send_keyboard_report after register_code16 has nothing new to send
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(Combo, HoldingAComboKeySendsTheKeyAfterTheComboTerm) {
+    TestDriver driver;
+    InSequence s;
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(COMBO_TERM);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    idle_for(2);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    run_one_scan_loop();
+}
+
+TEST_F(Combo, AKeyOutsideOfAllCombosIsSentImmediately) {
+    TestDriver driver;
+    InSequence s;
+    press_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_H)));
+    run_one_scan_loop();
+    release_key(7, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
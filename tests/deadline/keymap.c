@@ -0,0 +1,50 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+// One key of every feature that waits for some time to pass
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0      1        2              3           4      5      6      7      8      9
+        {TD(0),   KC_LEAD, OSM(MOD_LSFT), LT(1, KC_A), KC_C,  KC_D,  KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,   KC_NO,   KC_NO,         KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,   KC_NO,   KC_NO,         KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,   KC_NO,   KC_NO,         KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+    },
+    [1] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS,       KC_TRNS,     KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_TRNS,       KC_TRNS,     KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_TRNS,       KC_TRNS,     KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_TRNS,       KC_TRNS,     KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+};
+
+qk_tap_dance_action_t tap_dance_actions[] = {
+    [0] = ACTION_TAP_DANCE_DOUBLE(KC_E, KC_F),
+};
+
+const uint16_t PROGMEM cd_combo[] = {KC_C, KC_D, COMBO_END};
+
+combo_t key_combos[COMBO_COUNT] = {
+    [0] = COMBO(cd_combo, KC_ESC),
+};
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    return MACRO_NONE;
+};
+
+void action_function(keyrecord_t *record, uint8_t id, uint8_t opt) {
+}
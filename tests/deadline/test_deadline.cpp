@@ -0,0 +1,217 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include "deadline.h"
+
+extern "C" {
+    void set_time(uint32_t t);
+    void advance_time(uint32_t ms);
+}
+
+using testing::_;
+using testing::AnyNumber;
+
+namespace {
+int user_calls;
+int other_calls;
+int rearm_left;
+
+void user_callback(void) {
+    user_calls++;
+}
+
+void other_callback(void) {
+    other_calls++;
+}
+
+void rearm_callback(void) {
+    user_calls++;
+    if (--rearm_left > 0) {
+        deadline_set(DEADLINE_USER, timer_read() + 10, rearm_callback);
+    }
+}
+}
+
+class Deadline : public TestFixture {
+public:
+    Deadline() {
+        user_calls = 0;
+        other_calls = 0;
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    }
+
+    ~Deadline() {
+        deadline_clear(DEADLINE_USER);
+    }
+
+    uint16_t next() {
+        uint16_t remaining = UINT16_MAX;
+        EXPECT_TRUE(deadline_next(&remaining));
+        return remaining;
+    }
+
+    // Runs only the scheduler for a while, one call per ms
+    void run(uint16_t ms) {
+        for (uint16_t i = 0; i < ms; i++) {
+            deadline_task();
+            advance_time(1);
+        }
+    }
+
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+
+    TestDriver driver;
+};
+
+TEST_F(Deadline, NothingIsPendingWhenIdle) {
+    idle_for(TAPPING_TERM);
+    for (int id = 0; id < DEADLINE_COUNT; id++) {
+        EXPECT_FALSE(deadline_pending((deadline_id_t)id)) << id;
+    }
+    uint16_t remaining;
+    EXPECT_FALSE(deadline_next(&remaining));
+}
+
+TEST_F(Deadline, TheCallbackIsCalledOnceWhenDue) {
+    deadline_set(DEADLINE_USER, timer_read() + 10, user_callback);
+    run(10);
+    EXPECT_EQ(user_calls, 0);
+    run(1);
+    EXPECT_EQ(user_calls, 1);
+    EXPECT_FALSE(deadline_pending(DEADLINE_USER));
+    run(100);
+    EXPECT_EQ(user_calls, 1);
+}
+
+TEST_F(Deadline, EveryDeadlineIsCalledOnTime) {
+    deadline_set(DEADLINE_USER, timer_read() + 50, user_callback);
+    deadline_set(DEADLINE_TAP_DANCE, timer_read() + 20, other_callback);
+    run(20);
+    EXPECT_EQ(other_calls, 0);
+    run(1);
+    EXPECT_EQ(other_calls, 1);
+    EXPECT_EQ(user_calls, 0);
+    run(29);
+    EXPECT_EQ(user_calls, 0);
+    run(1);
+    EXPECT_EQ(user_calls, 1);
+}
+
+TEST_F(Deadline, MovingTheEarliestBackLetsAnotherOneComeFirst) {
+    deadline_set(DEADLINE_USER, timer_read() + 10, user_callback);
+    deadline_set(DEADLINE_TAP_DANCE, timer_read() + 30, other_callback);
+    deadline_set(DEADLINE_USER, timer_read() + 60, user_callback);
+    // a later time doesn't replace a pending deadline
+    deadline_set_earliest(DEADLINE_TAP_DANCE, timer_read() + 40, other_callback);
+    run(30);
+    EXPECT_EQ(other_calls, 0);
+    run(1);
+    EXPECT_EQ(other_calls, 1);
+    EXPECT_EQ(user_calls, 0);
+    deadline_set_earliest(DEADLINE_TAP_DANCE, timer_read() + 20, other_callback);
+    deadline_set_earliest(DEADLINE_TAP_DANCE, timer_read() + 5, other_callback);
+    run(5);
+    EXPECT_EQ(other_calls, 1);
+    run(1);
+    EXPECT_EQ(other_calls, 2);
+    deadline_set(DEADLINE_TAP_DANCE, timer_read() + 5, other_callback);
+    deadline_clear(DEADLINE_TAP_DANCE);
+    run(30);
+    EXPECT_EQ(other_calls, 2);
+    EXPECT_EQ(user_calls, 1);
+}
+
+TEST_F(Deadline, ACallbackCanSetItsDeadlineAgain) {
+    rearm_left = 3;
+    deadline_set(DEADLINE_USER, timer_read() + 10, rearm_callback);
+    run(25);
+    EXPECT_EQ(user_calls, 2);
+    run(100);
+    EXPECT_EQ(user_calls, 3);
+    EXPECT_FALSE(deadline_pending(DEADLINE_USER));
+}
+
+TEST_F(Deadline, WorksWhenTheTimerWrapsAround) {
+    set_time(UINT16_MAX - 5);
+    deadline_set(DEADLINE_USER, timer_read() + 10, user_callback);
+    run(10);
+    EXPECT_EQ(user_calls, 0);
+    run(1);
+    EXPECT_EQ(user_calls, 1);
+}
+
+TEST_F(Deadline, TapDanceAndLeaderTimeOutFromTheScheduler) {
+    tap(0);
+    EXPECT_TRUE(deadline_pending(DEADLINE_TAP_DANCE));
+    idle_for(TAPPING_TERM);
+    EXPECT_FALSE(deadline_pending(DEADLINE_TAP_DANCE));
+
+    tap(1);
+    idle_for(LEADER_TIMEOUT - 5);
+    EXPECT_TRUE(deadline_pending(DEADLINE_LEADER));
+    idle_for(10);
+    EXPECT_FALSE(deadline_pending(DEADLINE_LEADER));
+}
+
+TEST_F(Deadline, NextIsTheTimeUntilTheEarliestDeadline) {
+    deadline_set(DEADLINE_USER, timer_read() + 50, user_callback);
+    deadline_set(DEADLINE_TAP_DANCE, timer_read() + 20, other_callback);
+    EXPECT_EQ(next(), 20);
+    run(20);
+    EXPECT_EQ(next(), 0);
+    run(1);
+    EXPECT_EQ(next(), 29);
+    deadline_clear(DEADLINE_USER);
+    uint16_t remaining;
+    EXPECT_FALSE(deadline_next(&remaining));
+}
+
+TEST_F(Deadline, TappingAndOneshotKeepTheLoopAwake) {
+    press_key(3, 0);
+    run_one_scan_loop();
+    EXPECT_TRUE(deadline_pending(DEADLINE_TAPPING));
+    EXPECT_LE(next(), TAPPING_TERM);
+    release_key(3, 0);
+    run_one_scan_loop();
+    idle_for(TAPPING_TERM);
+
+    tap(2);
+    EXPECT_TRUE(deadline_pending(DEADLINE_ONESHOT_MODS));
+    // the tapping term of the one-shot key comes first
+    EXPECT_LE(next(), TAPPING_TERM);
+    idle_for(TAPPING_TERM);
+    EXPECT_TRUE(deadline_pending(DEADLINE_ONESHOT_MODS));
+    EXPECT_GT(next(), 0);
+    EXPECT_LE(next(), ONESHOT_TIMEOUT - TAPPING_TERM);
+    idle_for(ONESHOT_TIMEOUT);
+    tap(4);
+}
+
+TEST_F(Deadline, AComboKeyWaitsForTheComboTerm) {
+    press_key(4, 0);
+    run_one_scan_loop();
+    idle_for(COMBO_TERM - 1);
+    EXPECT_TRUE(deadline_pending(DEADLINE_COMBO));
+    idle_for(2);
+    EXPECT_FALSE(deadline_pending(DEADLINE_COMBO));
+    release_key(4, 0);
+    run_one_scan_loop();
+}
@@ -0,0 +1,109 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+
+class KeyboardReportBuilder : public TestFixture {};
+
+TEST_F(KeyboardReportBuilder, KeysThatDoNotFitAreAddedWhenAPlaceBecomesFree) {
+    TestDriver driver;
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B, KC_C)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B, KC_C, KC_D)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B, KC_C, KC_D, KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B, KC_C, KC_D, KC_E, KC_F)));
+    // The seventh and eighth key don't change the report, so nothing is sent
+    for (int c = 0; c < 8; c++) {
+        press_key(c, 0);
+        run_one_scan_loop();
+    }
+    EXPECT_EQ(count_keys(), 8);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    // The key that was held longest of the ones left out gets the place
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B, KC_C, KC_D, KC_E, KC_F, KC_G)));
+    release_key(0, 0);
+    run_one_scan_loop();
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_C, KC_D, KC_E, KC_F, KC_G, KC_H)));
+    release_key(1, 0);
+    run_one_scan_loop();
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_D, KC_E, KC_F, KC_G, KC_H)));
+    release_key(2, 0);
+    run_one_scan_loop();
+}
+
+TEST_F(KeyboardReportBuilder, KeysKeepTheirPlaceInTheReport) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    press_key(0, 0);
+    run_one_scan_loop();
+    press_key(1, 0);
+    run_one_scan_loop();
+    press_key(2, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    press_key(3, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(keyboard_report->keys[0], KC_D);
+    EXPECT_EQ(keyboard_report->keys[1], KC_B);
+    EXPECT_EQ(keyboard_report->keys[2], KC_C);
+}
+
+TEST_F(KeyboardReportBuilder, AnUnchangedReportIsNotSentAgain) {
+    TestDriver driver;
+    InSequence s;
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    run_one_scan_loop();
+    // Another key with the same keycode
+    press_key(2, 3);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    resend_keyboard_report();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    release_key(2, 3);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    run_one_scan_loop();
+}
+
+TEST_F(KeyboardReportBuilder, ModifiersAreSentWithTheKeys) {
+    TestDriver driver;
+    InSequence s;
+    press_key(0, 3);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    run_one_scan_loop();
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+    run_one_scan_loop();
+    release_key(0, 3);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
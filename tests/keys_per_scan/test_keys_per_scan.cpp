@@ -0,0 +1,124 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <cstdlib>
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+using testing::Invoke;
+
+class KeysPerScan : public TestFixture {};
+
+TEST_F(KeysPerScan, AllKeysOfARollAreReportedInTheSameScan) {
+    TestDriver driver;
+    InSequence s;
+    for (uint8_t c = 0; c < 6; c++) {
+        press_key(c, 0);
+    }
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B, KC_C)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B, KC_C, KC_D)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B, KC_C, KC_D, KC_E)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_B, KC_C, KC_D, KC_E, KC_F)));
+    keyboard_task();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(6);
+    clear_all_keys();
+    keyboard_task();
+}
+
+TEST_F(KeysPerScan, KeysInDifferentRowsAreProcessedInMatrixOrder) {
+    TestDriver driver;
+    InSequence s;
+    press_key(3, 2);
+    press_key(1, 0);
+    press_key(4, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B, KC_O)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B, KC_O, KC_X)));
+    keyboard_task();
+    release_key(4, 1);
+    release_key(3, 2);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B, KC_X)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    keyboard_task();
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    keyboard_task();
+}
+
+TEST_F(KeysPerScan, ModifiersPressedWithAKeyAreAppliedInTheSameScan) {
+    TestDriver driver;
+    InSequence s;
+    press_key(0, 3);
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A, KC_LSFT)));
+    keyboard_task();
+    release_key(0, 0);
+    release_key(0, 3);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    keyboard_task();
+}
+
+TEST_F(KeysPerScan, KeysOverTheBudgetAreLeftForTheNextScan) {
+    TestDriver driver;
+    // Ten changes, but only QMK_KEYS_PER_SCAN of them in the first scan
+    for (uint8_t c = 0; c < 10; c++) {
+        press_key(c, 1);
+    }
+    // The 6KRO report stops changing after six keys, so count the keys that are down instead
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    keyboard_task();
+    EXPECT_EQ(count_keys(), QMK_KEYS_PER_SCAN);
+    keyboard_task();
+    EXPECT_EQ(count_keys(), 10);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    keyboard_task();
+}
+
+// Bursts of 2-6 simultaneous key changes, none of which should wait for a
+// later scan
+TEST_F(KeysPerScan, RandomRollsAreReportedWithoutExtraScans) {
+    TestDriver driver;
+    unsigned reports = 0;
+
+    EXPECT_CALL(driver, send_keyboard_mock(_)).WillRepeatedly(Invoke([&](report_keyboard_t&) { reports++; }));
+
+    srand(1);
+    for (unsigned roll = 0; roll < 200; roll++) {
+        unsigned len = 2 + rand() % 5;
+        uint8_t row = rand() % 3;
+        uint8_t first = rand() % (MATRIX_COLS - len + 1);
+        for (unsigned phase = 0; phase < 2; phase++) {
+            for (unsigned i = 0; i < len; i++) {
+                if (phase == 0) {
+                    press_key(first + i, row);
+                } else {
+                    release_key(first + i, row);
+                }
+            }
+            unsigned before = reports;
+            run_one_scan_loop();
+            EXPECT_EQ(reports - before, len) << "roll " << roll;
+        }
+    }
+}
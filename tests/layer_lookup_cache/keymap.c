@@ -0,0 +1,102 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+#define _______ KC_TRNS
+
+// Twelve layers where every layer above the base only overrides two keys,
+// so most lookups have to fall through all active layers
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        {KC_A,    KC_B,    KC_C,    KC_D,    KC_E,    KC_F,    KC_G,    KC_H,    KC_I,    KC_J},
+        {KC_K,    KC_L,    KC_M,    KC_N,    KC_O,    KC_P,    KC_Q,    KC_R,    KC_S,    KC_T},
+        {KC_U,    KC_V,    KC_W,    KC_X,    KC_Y,    KC_Z,    KC_1,    KC_2,    KC_3,    KC_4},
+        {KC_LSFT, KC_LCTL, MO(1),   MO(2),   MO(3),   MO(11),  KC_NO,   KC_NO,   KC_NO,   KC_NO},
+    },
+    [1] = {
+        {_______, KC_F2, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, KC_F7, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [2] = {
+        {_______, _______, _______, _______, _______, _______, KC_F8, _______, _______, _______},
+        {_______, _______, KC_F3, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [3] = {
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, KC_F9},
+        {_______, _______, _______, KC_F4, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [4] = {
+        {_______, _______, _______, _______, KC_F5, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, KC_F10, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [5] = {
+        {_______, _______, _______, _______, _______, KC_F11, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, KC_F6, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [6] = {
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, KC_F12, _______},
+        {_______, _______, _______, _______, _______, _______, KC_F7, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [7] = {
+        {_______, _______, _______, _______, _______, _______, _______, KC_F8, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, KC_F1, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [8] = {
+        {_______, _______, _______, _______, KC_F2, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, KC_F9, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [9] = {
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, KC_F3, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, KC_F10},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [10] = {
+        {KC_F11, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {KC_F4, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+    [11] = {
+        {_______, _______, _______, KC_F5, _______, _______, _______, _______, _______, _______},
+        {_______, KC_F12, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+        {_______, _______, _______, _______, _______, _______, _______, _______, _______, _______},
+    },
+};
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    return MACRO_NONE;
+};
+
+void action_function(keyrecord_t *record, uint8_t id, uint8_t opt) {
+}
@@ -0,0 +1,123 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <cstdlib>
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+
+namespace {
+    const unsigned num_layers = 12;
+
+    // The plain top-down probe that the cache replaces
+    int8_t linear_probe_layer(keypos_t key) {
+        uint32_t layers = layer_state | default_layer_state;
+        for (int8_t i = 31; i >= 0; i--) {
+            if (layers & (1UL << i)) {
+                if (action_for_key(i, key).code != ACTION_TRANSPARENT) {
+                    return i;
+                }
+            }
+        }
+        return 0;
+    }
+
+    keypos_t make_key(uint8_t col, uint8_t row) {
+        keypos_t key = { .col = col, .row = row };
+        return key;
+    }
+}
+
+class LayerLookupCache : public TestFixture {
+public:
+    ~LayerLookupCache() {
+        TestDriver driver;
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+        layer_clear();
+        default_layer_set(1);
+    }
+};
+
+TEST_F(LayerLookupCache, MatchesTheLinearProbeForAllLayerStates) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    srand(1);
+    for (unsigned i = 0; i < 500; i++) {
+        layer_state = rand() & ((1UL << num_layers) - 1);
+        default_layer_state = 1UL << (rand() % 2);
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                keypos_t key = make_key(col, row);
+                ASSERT_EQ(layer_switch_get_layer(key), linear_probe_layer(key));
+                // The second lookup comes from the cache
+                ASSERT_EQ(layer_switch_get_layer(key), linear_probe_layer(key));
+            }
+        }
+    }
+}
+
+TEST_F(LayerLookupCache, LayerOnAndOffAreTracked) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    keypos_t key = make_key(1, 0);
+    default_layer_set(1);
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    layer_on(1);
+    EXPECT_EQ(layer_switch_get_layer(key), 1);
+    layer_on(2);
+    EXPECT_EQ(layer_switch_get_layer(key), 1);
+    layer_off(1);
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+}
+
+TEST_F(LayerLookupCache, DirectWritesToTheLayerStateAreTracked) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    keypos_t key = make_key(3, 2);
+    default_layer_state = 1;
+    layer_state = 0;
+    EXPECT_EQ(layer_switch_get_layer(key), 0);
+    layer_state = 1UL << 1;
+    EXPECT_EQ(layer_switch_get_layer(key), 1);
+    default_layer_state = 1UL << 3;
+    layer_state = 0;
+    EXPECT_EQ(layer_switch_get_layer(key), 3);
+}
+
+TEST_F(LayerLookupCache, MomentaryLayerKeyReportsKeyOfTheUpperLayer) {
+    TestDriver driver;
+    InSequence s;
+    default_layer_set(1);
+    press_key(2, 3);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    run_one_scan_loop();
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_F2)));
+    run_one_scan_loop();
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    release_key(2, 3);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    run_one_scan_loop();
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    run_one_scan_loop();
+    release_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
@@ -0,0 +1,65 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+// The leader key, and then the letters in order
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        {KC_LEAD, KC_A,  KC_B,  KC_C,  KC_D,  KC_E,  KC_F,  KC_G,  KC_H,  KC_I},
+        {KC_J,    KC_K,  KC_L,  KC_M,  KC_N,  KC_O,  KC_P,  KC_Q,  KC_R,  KC_S},
+        {KC_T,    KC_U,  KC_V,  KC_W,  KC_X,  KC_Y,  KC_Z,  KC_NO, KC_NO, KC_NO},
+        {KC_NO,   KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+    },
+};
+
+#define SEQ_ID(first, second) (((first) << 8) | (second))
+#define LONG_SEQ_ID 0xFFFF
+
+// Every letter from A to T on its own, and followed by every letter from A
+// to T, which makes 420 sequences in dictionary order
+#define FIRST_KEYS(X) \
+    X(KC_A) X(KC_B) X(KC_C) X(KC_D) X(KC_E) X(KC_F) X(KC_G) X(KC_H) X(KC_I) X(KC_J) \
+    X(KC_K) X(KC_L) X(KC_M) X(KC_N) X(KC_O) X(KC_P) X(KC_Q) X(KC_R) X(KC_S) X(KC_T)
+#define SECOND_KEYS(X, first) \
+    X(first, KC_A) X(first, KC_B) X(first, KC_C) X(first, KC_D) X(first, KC_E) \
+    X(first, KC_F) X(first, KC_G) X(first, KC_H) X(first, KC_I) X(first, KC_J) \
+    X(first, KC_K) X(first, KC_L) X(first, KC_M) X(first, KC_N) X(first, KC_O) \
+    X(first, KC_P) X(first, KC_Q) X(first, KC_R) X(first, KC_S) X(first, KC_T)
+
+#define TABLE_PAIR(first, second) LEADER_SEQUENCE(SEQ_ID(first, second), first, second),
+#define TABLE_FIRST(first) LEADER_SEQUENCE(SEQ_ID(first, 0), first), SECOND_KEYS(TABLE_PAIR, first)
+
+const uint16_t PROGMEM leader_sequences[] = {
+    FIRST_KEYS(TABLE_FIRST)
+    LEADER_SEQUENCE(LONG_SEQ_ID, KC_X, KC_Y, KC_Z, KC_X, KC_Y, KC_Z, KC_X, KC_Y, KC_Z, KC_X, KC_Y, KC_Z),
+    LEADER_SEQUENCES_END
+};
+
+uint16_t last_leader_id = 0;
+uint16_t leader_matches = 0;
+
+void leader_sequence_user(uint16_t id) {
+    last_leader_id = id;
+    leader_matches++;
+}
+
+bool test_leading(void) {
+    return leading;
+}
+
+bool test_sequences_valid(void) {
+    return leader_sequences_valid();
+}
@@ -0,0 +1,132 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+
+extern "C" {
+    extern uint16_t last_leader_id;
+    extern uint16_t leader_matches;
+    bool test_leading(void);
+    bool test_sequences_valid(void);
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+
+#define SEQ_ID(first, second) (((first) << 8) | (second))
+
+class Leader : public TestFixture {
+public:
+    Leader() {
+        last_leader_id = 0;
+        leader_matches = 0;
+    }
+
+    // The keymap is the leader key followed by the letters
+    void tap(uint16_t keycode) {
+        uint8_t index = keycode == KC_LEAD ? 0 : keycode - KC_A + 1;
+        press_key(index % MATRIX_COLS, index / MATRIX_COLS);
+        run_one_scan_loop();
+        release_key(index % MATRIX_COLS, index / MATRIX_COLS);
+        run_one_scan_loop();
+    }
+};
+
+TEST_F(Leader, TheTableIsSorted) {
+    EXPECT_TRUE(test_sequences_valid());
+}
+
+TEST_F(Leader, MatchesASequenceAsSoonAsNoLongerOneStartsWithIt) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    tap(KC_LEAD);
+    tap(KC_C);
+    EXPECT_TRUE(test_leading());
+    tap(KC_D);
+    EXPECT_FALSE(test_leading());
+    EXPECT_EQ(last_leader_id, SEQ_ID(KC_C, KC_D));
+    EXPECT_EQ(leader_matches, 1);
+}
+
+TEST_F(Leader, MatchesAPrefixOfLongerSequencesOnTimeout) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    tap(KC_LEAD);
+    tap(KC_F);
+    idle_for(LEADER_TIMEOUT - 10);
+    EXPECT_TRUE(test_leading());
+    EXPECT_EQ(leader_matches, 0);
+    idle_for(20);
+    EXPECT_FALSE(test_leading());
+    EXPECT_EQ(last_leader_id, SEQ_ID(KC_F, 0));
+    EXPECT_EQ(leader_matches, 1);
+}
+
+TEST_F(Leader, EndsAsSoonAsNothingCanMatch) {
+    TestDriver driver;
+    InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    tap(KC_LEAD);
+    tap(KC_X);
+    EXPECT_TRUE(test_leading());
+    tap(KC_A);
+    EXPECT_FALSE(test_leading());
+    EXPECT_EQ(leader_matches, 0);
+    // and the keys work normally again
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    tap(KC_B);
+}
+
+TEST_F(Leader, EndsWithoutAMatchOnTimeout) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    tap(KC_LEAD);
+    tap(KC_X);
+    tap(KC_Y);
+    idle_for(LEADER_TIMEOUT);
+    EXPECT_FALSE(test_leading());
+    EXPECT_EQ(leader_matches, 0);
+}
+
+TEST_F(Leader, MatchesSequencesLongerThanFiveKeys) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    tap(KC_LEAD);
+    for (int i = 0; i < 4; i++) {
+        tap(KC_X);
+        tap(KC_Y);
+        tap(KC_Z);
+    }
+    EXPECT_FALSE(test_leading());
+    EXPECT_EQ(last_leader_id, 0xFFFF);
+    EXPECT_EQ(leader_matches, 1);
+}
+
+TEST_F(Leader, MatchesEveryTwoKeySequence) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    for (uint16_t first = KC_A; first <= KC_T; first++) {
+        for (uint16_t second = KC_A; second <= KC_T; second++) {
+            tap(KC_LEAD);
+            tap(first);
+            tap(second);
+            EXPECT_FALSE(test_leading());
+            EXPECT_EQ(last_leader_id, SEQ_ID(first, second));
+        }
+    }
+    EXPECT_EQ(leader_matches, 400);
+}
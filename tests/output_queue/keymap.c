@@ -0,0 +1,61 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+enum {
+    STRING = SAFE_RANGE,
+    LONG_STRING,
+};
+
+// One key of every kind of generated output, and plain, one-shot and shifted keys
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0      1            2      3         4      5              6           7      8      9
+        {STRING,  LONG_STRING, M(0),  UC(0xE9), KC_B,  OSM(MOD_LSFT), LSFT(KC_1), KC_NO, KC_NO, KC_NO},
+        {KC_NO,   KC_NO,       KC_NO, KC_NO,    KC_NO, KC_NO,         KC_NO,      KC_NO, KC_NO, KC_NO},
+        {KC_NO,   KC_NO,       KC_NO, KC_NO,    KC_NO, KC_NO,         KC_NO,      KC_NO, KC_NO, KC_NO},
+        {KC_NO,   KC_NO,       KC_NO, KC_NO,    KC_NO, KC_NO,         KC_NO,      KC_NO, KC_NO, KC_NO},
+    },
+};
+
+bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    if (record->event.pressed) {
+        switch (keycode) {
+            case STRING:
+                send_string("Hi!");
+                return false;
+            case LONG_STRING:
+                send_string_with_delay("the quick brown fox jumps over the lazy dog", 5);
+                return false;
+        }
+    }
+    return true;
+}
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    if (record->event.pressed) {
+        return MACRO(T(X), W(50), T(Y), END);
+    }
+    return MACRO_NONE;
+};
+
+void action_function(keyrecord_t *record, uint8_t id, uint8_t opt) {
+}
+
+// for the test, quantum.h has no C++ guards
+void test_set_unicode_input_mode(uint8_t mode) {
+    set_unicode_input_mode(mode);
+}
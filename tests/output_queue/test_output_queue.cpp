@@ -0,0 +1,240 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+#include "output_queue.h"
+
+extern "C" {
+    void advance_time(uint32_t ms);
+    void test_set_unicode_input_mode(uint8_t mode);
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+
+namespace {
+struct SentReport {
+    uint32_t time;
+    report_keyboard_t report;
+};
+}
+
+class OutputQueue : public TestFixture {
+public:
+    OutputQueue() {
+        EXPECT_CALL(driver, send_keyboard_mock(_))
+            .WillRepeatedly(Invoke([this](report_keyboard_t &report) {
+                sent.push_back({timer_read32(), report});
+            }));
+    }
+
+    ~OutputQueue() {
+        while (output_queue_busy()) {
+            run_one_scan_loop();
+        }
+    }
+
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        scan();
+        release_key(col, 0);
+        scan();
+    }
+
+    // A scan loop that returns how long keyboard_task() kept it waiting
+    uint32_t scan() {
+        uint32_t start = timer_read32();
+        keyboard_task();
+        uint32_t stalled = timer_read32() - start;
+        if (stalled > max_stall) {
+            max_stall = stalled;
+        }
+        advance_time(1);
+        return stalled;
+    }
+
+    void drain() {
+        while (output_queue_busy()) {
+            scan();
+        }
+    }
+
+    void expect_report(size_t index, testing::Matcher<report_keyboard_t&> matcher) {
+        EXPECT_TRUE(matcher.Matches(sent[index].report))
+            << "report " << index << " is " << sent[index].report;
+    }
+
+    uint32_t since_first(size_t index) {
+        return sent[index].time - sent[0].time;
+    }
+
+    TestDriver driver;
+    std::vector<SentReport> sent;
+    uint32_t max_stall = 0;
+};
+
+TEST_F(OutputQueue, SendStringIsSentOneReportPerInterval) {
+    press_key(0, 0);
+    EXPECT_EQ(scan(), 0u);
+    // the first report goes out right away
+    ASSERT_EQ(sent.size(), 1u);
+    EXPECT_TRUE(output_queue_busy());
+    release_key(0, 0);
+    drain();
+
+    // a shift and the key it shifts share a report, a release and the next
+    // press too
+    ASSERT_EQ(sent.size(), 4u);
+    expect_report(0, KeyboardReport(KC_LSFT, KC_H));
+    expect_report(1, KeyboardReport(KC_I));
+    expect_report(2, KeyboardReport(KC_LSFT, KC_1));
+    expect_report(3, KeyboardReport());
+    for (size_t i = 1; i < sent.size(); i++) {
+        EXPECT_EQ(sent[i].time - sent[i - 1].time, OUTPUT_QUEUE_INTERVAL);
+    }
+    EXPECT_EQ(max_stall, 0u);
+}
+
+TEST_F(OutputQueue, AKeyPressedMeanwhileComesAfterTheString) {
+    press_key(0, 0);
+    scan();
+    release_key(0, 0);
+    scan();
+    press_key(4, 0);
+    scan();
+    drain();
+    ASSERT_EQ(sent.size(), 4u);
+    expect_report(2, KeyboardReport(KC_LSFT, KC_1));
+    // the release of '!' and the press of B
+    expect_report(3, KeyboardReport(KC_B));
+
+    // once the queue is empty the key goes out in the same scan
+    sent.clear();
+    release_key(4, 0);
+    scan();
+    ASSERT_EQ(sent.size(), 1u);
+    expect_report(0, KeyboardReport());
+    EXPECT_FALSE(output_queue_busy());
+}
+
+TEST_F(OutputQueue, AShiftedKeyPressedMeanwhileKeepsItsShift) {
+    press_key(0, 0);
+    scan();
+    release_key(0, 0);
+    scan();
+    tap(6);
+    drain();
+    ASSERT_EQ(sent.size(), 6u);
+    expect_report(0, KeyboardReport(KC_LSFT, KC_H));
+    expect_report(1, KeyboardReport(KC_I));
+    expect_report(2, KeyboardReport(KC_LSFT, KC_1));
+    expect_report(3, KeyboardReport());
+    expect_report(4, KeyboardReport(KC_LSFT, KC_1));
+    expect_report(5, KeyboardReport());
+}
+
+TEST_F(OutputQueue, AOneShotModTappedMeanwhileShiftsTheNextKeyOnly) {
+    press_key(0, 0);
+    scan();
+    release_key(0, 0);
+    scan();
+    tap(5);
+    tap(4);
+    tap(4);
+    drain();
+    ASSERT_EQ(sent.size(), 8u);
+    expect_report(0, KeyboardReport(KC_LSFT, KC_H));
+    expect_report(1, KeyboardReport(KC_I));
+    expect_report(2, KeyboardReport(KC_LSFT, KC_1));
+    expect_report(3, KeyboardReport());
+    expect_report(4, KeyboardReport(KC_LSFT, KC_B));
+    expect_report(5, KeyboardReport());
+    expect_report(6, KeyboardReport(KC_B));
+    expect_report(7, KeyboardReport());
+}
+
+TEST_F(OutputQueue, MacroWaitsAreQueued) {
+    press_key(2, 0);
+    EXPECT_EQ(scan(), 0u);
+    release_key(2, 0);
+    drain();
+    ASSERT_EQ(sent.size(), 4u);
+    expect_report(0, KeyboardReport(KC_X));
+    expect_report(1, KeyboardReport());
+    expect_report(2, KeyboardReport(KC_Y));
+    expect_report(3, KeyboardReport());
+    EXPECT_EQ(since_first(1), OUTPUT_QUEUE_INTERVAL);
+    EXPECT_EQ(since_first(2), 2 * OUTPUT_QUEUE_INTERVAL + 50u);
+    EXPECT_EQ(max_stall, 0u);
+}
+
+TEST_F(OutputQueue, UnicodeInputIsQueued) {
+    test_set_unicode_input_mode(UC_OSX);
+    press_key(3, 0);
+    EXPECT_EQ(scan(), 0u);
+    release_key(3, 0);
+    drain();
+    std::vector<testing::Matcher<report_keyboard_t&>> expected = {
+        KeyboardReport(KC_LALT),
+        KeyboardReport(KC_LALT, KC_0),
+        KeyboardReport(KC_LALT),
+        KeyboardReport(KC_LALT, KC_0),
+        KeyboardReport(KC_LALT, KC_E),
+        KeyboardReport(KC_LALT, KC_9),
+        KeyboardReport(),
+    };
+    ASSERT_EQ(sent.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        expect_report(i, expected[i]);
+    }
+    // UNICODE_TYPE_DELAY after the alt
+    EXPECT_EQ(since_first(1), OUTPUT_QUEUE_INTERVAL + UNICODE_TYPE_DELAY);
+    EXPECT_EQ(max_stall, 0u);
+}
+
+TEST_F(OutputQueue, FlushSendsEverythingRightAway) {
+    press_key(0, 0);
+    keyboard_task();
+    output_queue_flush();
+    EXPECT_FALSE(output_queue_busy());
+    ASSERT_EQ(sent.size(), 4u);
+    EXPECT_EQ(since_first(3), 3 * OUTPUT_QUEUE_INTERVAL);
+    release_key(0, 0);
+    run_one_scan_loop();
+}
+
+TEST_F(OutputQueue, ALongStringNeverStallsTheScan) {
+    // 43 characters, with the delay of send_string_with_delay() in between
+    press_key(1, 0);
+    scan();
+    release_key(1, 0);
+    drain();
+    EXPECT_EQ(max_stall, 0u);
+    size_t queued_reports = sent.size();
+
+    // flushed it stalls for the whole string, with the same reports
+    sent.clear();
+    press_key(1, 0);
+    uint32_t start = timer_read32();
+    keyboard_task();
+    output_queue_flush();
+    uint32_t flush_stall = timer_read32() - start;
+    release_key(1, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(sent.size(), queued_reports);
+    EXPECT_GE(flush_stall, strlen("the quick brown fox jumps over the lazy dog") * 5);
+}
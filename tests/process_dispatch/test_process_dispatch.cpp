@@ -0,0 +1,85 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+
+class ProcessDispatch : public TestFixture {};
+
+TEST_F(ProcessDispatch, APlainKeyIsReported) {
+    TestDriver driver;
+    InSequence s;
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(ProcessDispatch, ACombinationOfKeysOutsideOfAllRangesReachesTheCombo) {
+    TestDriver driver;
+    press_key(0, 1);
+    press_key(1, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_F12)));
+    run_one_scan_loop();
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(0, 1);
+    release_key(1, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    idle_for(COMBO_TERM + 1);
+}
+
+TEST_F(ProcessDispatch, APlainKeyInterruptsATapDance) {
+    TestDriver driver;
+    press_key(2, 1);
+    run_one_scan_loop();
+    release_key(2, 1);
+    run_one_scan_loop();
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    {
+        InSequence s;
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    }
+    press_key(0, 0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(ProcessDispatch, TheLeaderSeesPlainKeysWhileLeading) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport())).Times(AnyNumber());
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A))).Times(0);
+    press_key(4, 1);
+    run_one_scan_loop();
+    release_key(4, 1);
+    run_one_scan_loop();
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+    idle_for(LEADER_TIMEOUT);
+}
@@ -0,0 +1,58 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+#include "profile.h"
+#include "raw_hid.h"
+#include <string.h>
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0    1      2      3      4      5      6      7      8      9
+        {KC_A,  KC_B,  KC_C,  KC_D,  KC_E,  KC_F,  KC_G,  KC_H,  KC_I,  KC_J},
+        {KC_K,  KC_L,  KC_M,  KC_N,  KC_O,  KC_P,  KC_Q,  KC_R,  KC_S,  KC_T},
+        {KC_U,  KC_V,  KC_W,  KC_X,  KC_Y,  KC_Z,  KC_1,  KC_2,  KC_3,  KC_4},
+        {KC_LSFT, KC_LCTL, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+    },
+};
+
+// A deterministic clock, advanced by the tests and by the keymap
+uint32_t fake_clock = 0;
+uint32_t process_record_cost = 0;
+
+uint32_t profile_read_clock(void) {
+    return fake_clock;
+}
+
+// the last report sent over raw HID
+uint8_t raw_hid_report[32];
+uint8_t raw_hid_length = 0;
+
+void raw_hid_send(uint8_t *data, uint8_t length) {
+    memcpy(raw_hid_report, data, length);
+    raw_hid_length = length;
+}
+
+bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    fake_clock += process_record_cost;
+    return true;
+}
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    return MACRO_NONE;
+};
+
+void action_function(keyrecord_t *record, uint8_t id, uint8_t opt) {
+}
@@ -0,0 +1,157 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+
+extern "C" {
+#include "profile.h"
+    extern uint32_t fake_clock;
+    extern uint32_t process_record_cost;
+    extern uint8_t raw_hid_report[32];
+    extern uint8_t raw_hid_length;
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InvokeWithoutArgs;
+
+class Profile : public TestFixture {
+public:
+    Profile() {
+        fake_clock = 0;
+        process_record_cost = 0;
+        profile_reset();
+    }
+};
+
+TEST_F(Profile, EveryStageOfAKeyPressIsTimed) {
+    TestDriver driver;
+    process_record_cost = 30;
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)))
+        .WillOnce(InvokeWithoutArgs([]() { fake_clock += 200; }));
+    keyboard_task();
+
+    const profile_stats_t *stats = profile_get_stats(PROFILE_PROCESS_RECORD);
+    EXPECT_EQ(stats->count, 1u);
+    EXPECT_EQ(stats->max, 30u);
+    stats = profile_get_stats(PROFILE_SEND_REPORT);
+    EXPECT_EQ(stats->count, 1u);
+    EXPECT_EQ(stats->max, 200u);
+    stats = profile_get_stats(PROFILE_ACTION_EXEC);
+    EXPECT_EQ(stats->count, 1u);
+    EXPECT_EQ(stats->max, 230u);
+    stats = profile_get_stats(PROFILE_MATRIX_SCAN);
+    EXPECT_EQ(stats->count, 1u);
+    EXPECT_EQ(stats->max, 0u);
+    stats = profile_get_stats(PROFILE_KEYBOARD_TASK);
+    EXPECT_EQ(stats->count, 1u);
+    EXPECT_EQ(stats->total, 230u);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()))
+        .WillOnce(InvokeWithoutArgs([]() { fake_clock += 100; }));
+    keyboard_task();
+    stats = profile_get_stats(PROFILE_SEND_REPORT);
+    EXPECT_EQ(stats->count, 2u);
+    EXPECT_EQ(stats->min, 100u);
+    EXPECT_EQ(stats->max, 200u);
+    EXPECT_EQ(stats->total, 300u);
+}
+
+TEST_F(Profile, IdleScansOnlyTimeTheScanLoop) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(10);
+    EXPECT_EQ(profile_get_stats(PROFILE_KEYBOARD_TASK)->count, 10u);
+    EXPECT_EQ(profile_get_stats(PROFILE_MATRIX_SCAN)->count, 10u);
+    EXPECT_EQ(profile_get_stats(PROFILE_ACTION_EXEC)->count, 0u);
+    EXPECT_EQ(profile_get_stats(PROFILE_PROCESS_RECORD)->count, 0u);
+}
+
+TEST_F(Profile, DurationsAreSortedIntoPowerOfTwoBuckets) {
+    static_assert(PROFILE_HISTOGRAM_BUCKETS == 8 && PROFILE_HISTOGRAM_BASE == 16, "the test assumes the default histogram");
+    const uint32_t durations[] = {0, 15, 16, 31, 32, 1000, 1023, 1024, 100000};
+    for (uint32_t d: durations) {
+        profile_record(PROFILE_MATRIX_SCAN, d);
+    }
+    const profile_stats_t *stats = profile_get_stats(PROFILE_MATRIX_SCAN);
+    const uint16_t expected[PROFILE_HISTOGRAM_BUCKETS] = {2, 2, 1, 0, 0, 0, 2, 2};
+    for (int i = 0; i < PROFILE_HISTOGRAM_BUCKETS; i++) {
+        EXPECT_EQ(stats->histogram[i], expected[i]) << "bucket " << i;
+    }
+    EXPECT_EQ(stats->count, 9u);
+    EXPECT_EQ(stats->min, 0u);
+    EXPECT_EQ(stats->max, 100000u);
+}
+
+TEST_F(Profile, ResetClearsAllStages) {
+    profile_record(PROFILE_MATRIX_SCAN, 10);
+    profile_record(PROFILE_SEND_REPORT, 20);
+    profile_reset();
+    for (int i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        const profile_stats_t *stats = profile_get_stats((profile_stage_t)i);
+        EXPECT_EQ(stats->count, 0u);
+        EXPECT_EQ(stats->max, 0u);
+        EXPECT_EQ(stats->histogram[0], 0u);
+    }
+}
+
+TEST_F(Profile, PackFoldsTheBucketsThatDoNotFitIntoTheLastOne) {
+    profile_record(PROFILE_SEND_REPORT, 5);
+    profile_record(PROFILE_SEND_REPORT, 1000);
+    profile_record(PROFILE_SEND_REPORT, 0x12345);
+    uint8_t data[32];
+    // a raw HID report has room for 7 buckets
+    ASSERT_EQ(profile_pack(PROFILE_SEND_REPORT, data, sizeof(data)), 32);
+    EXPECT_EQ(data[0], PROFILE_SEND_REPORT);
+    EXPECT_EQ(data[1], 7);
+    EXPECT_EQ(data[2], 3); // count
+    EXPECT_EQ(data[3], 0);
+    EXPECT_EQ(data[14], 0x45); // max
+    EXPECT_EQ(data[15], 0x23);
+    EXPECT_EQ(data[16], 0x01);
+    EXPECT_EQ(data[17], 0x00);
+    EXPECT_EQ(data[18], 1); // bucket 0
+    EXPECT_EQ(data[30], 2); // bucket 6 and 7
+    EXPECT_EQ(data[31], 0);
+    EXPECT_EQ(profile_pack(PROFILE_SEND_REPORT, data, 19), 0);
+}
+
+TEST_F(Profile, TheHostAsksForAStageOverRawHID) {
+    profile_record(PROFILE_MATRIX_SCAN, 100);
+    uint8_t request[32] = {PROFILE_RAW_HID_ID, PROFILE_MATRIX_SCAN, 0x55};
+    raw_hid_length = 0;
+    ASSERT_TRUE(profile_raw_hid_receive(request, sizeof(request)));
+    ASSERT_EQ(raw_hid_length, 32);
+    EXPECT_EQ(raw_hid_report[0], PROFILE_RAW_HID_ID);
+    EXPECT_EQ(raw_hid_report[1], PROFILE_MATRIX_SCAN);
+    EXPECT_EQ(raw_hid_report[2], 6); // buckets
+    EXPECT_EQ(raw_hid_report[3], 1); // count
+    EXPECT_EQ(raw_hid_report[7], 100); // total
+    // 100 us is in the bucket below 128 us
+    EXPECT_EQ(raw_hid_report[19 + 2 * 3], 1);
+    EXPECT_EQ(raw_hid_report[31], 0);
+
+    uint8_t reset[32] = {PROFILE_RAW_HID_ID, PROFILE_RAW_HID_RESET};
+    ASSERT_TRUE(profile_raw_hid_receive(reset, sizeof(reset)));
+    EXPECT_EQ(profile_get_stats(PROFILE_MATRIX_SCAN)->count, 0u);
+
+    uint8_t other[32] = {0x01, PROFILE_MATRIX_SCAN};
+    raw_hid_length = 0;
+    EXPECT_FALSE(profile_raw_hid_receive(other, sizeof(other)));
+    EXPECT_EQ(raw_hid_length, 0);
+}
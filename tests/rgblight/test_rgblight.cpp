@@ -0,0 +1,262 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <cstring>
+#include <cstdlib>
+
+extern "C" {
+    void advance_time(uint32_t ms);
+
+    extern LED_TYPE test_strip[];
+    extern uint32_t test_strip_pushes;
+    extern bool test_strip_busy;
+}
+
+static const int NUM_LEDS = RGBLED_NUM;
+static const int LEDS_PER_TASK = RGBLIGHT_LEDS_PER_TASK;
+
+class Rgblight : public TestFixture {
+public:
+    Rgblight() {
+        test_strip_busy = false;
+        test_strip_pushes = 0;
+    }
+
+    // rgblight_task() is run by the main loop of the protocol, after keyboard_task()
+    void run_one_rgblight_scan() {
+        rgblight_task();
+        advance_time(1);
+    }
+
+    // Runs until the next push, returns false if there's none within 'limit' scans
+    bool run_until_push(unsigned limit) {
+        uint32_t pushes = test_strip_pushes;
+        for (unsigned i = 0; i < limit; i++) {
+            run_one_rgblight_scan();
+            if (test_strip_pushes != pushes) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+TEST_F(Rgblight, SettingTheSameColorAgainIsNotPushed) {
+    rgblight_mode(1);
+    rgblight_setrgb(10, 20, 30);
+    uint32_t pushes = test_strip_pushes;
+    rgblight_setrgb(10, 20, 30);
+    EXPECT_EQ(test_strip_pushes, pushes);
+    rgblight_setrgb(10, 20, 31);
+    EXPECT_EQ(test_strip_pushes, pushes + 1);
+}
+
+TEST_F(Rgblight, AFrameIsRenderedOverSeveralScansAndPushedWhenComplete) {
+    // christmas changes every LED each frame
+    rgblight_mode(24);
+    ASSERT_TRUE(run_until_push(RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL + 10));
+    uint32_t pushes = test_strip_pushes;
+
+    unsigned scans = 0;
+    while (memcmp(&led[0], &test_strip[0], sizeof(LED_TYPE)) == 0) {
+        ASSERT_LT(scans++, RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL + 10);
+        run_one_rgblight_scan();
+    }
+    // Only the first part of the frame is rendered so far
+    EXPECT_EQ(memcmp(&led[LEDS_PER_TASK], &test_strip[LEDS_PER_TASK], sizeof(LED_TYPE)), 0);
+    EXPECT_EQ(memcmp(&led[NUM_LEDS - 1], &test_strip[NUM_LEDS - 1], sizeof(LED_TYPE)), 0);
+    EXPECT_EQ(test_strip_pushes, pushes);
+
+    const int remaining_scans = (NUM_LEDS + LEDS_PER_TASK - 1) / LEDS_PER_TASK - 1;
+    for (int i = 0; i < remaining_scans - 1; i++) {
+        run_one_rgblight_scan();
+        EXPECT_EQ(test_strip_pushes, pushes);
+    }
+    run_one_rgblight_scan();
+    EXPECT_EQ(test_strip_pushes, pushes + 1);
+    EXPECT_EQ(memcmp(led, test_strip, NUM_LEDS * sizeof(LED_TYPE)), 0);
+}
+
+TEST_F(Rgblight, NothingIsRenderedWhileTheDriverIsBusy) {
+    rgblight_mode(24);
+    ASSERT_TRUE(run_until_push(RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL + 10));
+    test_strip_busy = true;
+    uint32_t pushes = test_strip_pushes;
+    for (int i = 0; i < 2 * RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL; i++) {
+        run_one_rgblight_scan();
+    }
+    EXPECT_EQ(test_strip_pushes, pushes);
+    EXPECT_EQ(memcmp(led, test_strip, NUM_LEDS * sizeof(LED_TYPE)), 0);
+    test_strip_busy = false;
+    EXPECT_TRUE(run_until_push(LEDS_PER_TASK));
+}
+
+TEST_F(Rgblight, BreathingDoesNotPushStepsThatLookTheSame) {
+    // mode 2 steps through the 256 entries of the breathing table every 30 ms
+    rgblight_mode(2);
+    ASSERT_TRUE(run_until_push(100));
+    test_strip_pushes = 0;
+    for (int i = 0; i < 256 * 30; i++) {
+        run_one_rgblight_scan();
+    }
+    EXPECT_GT(test_strip_pushes, 0u);
+    EXPECT_LT(test_strip_pushes, 256u);
+}
+
+// Counts its frames, and shows the count in the red channel of every LED of the zone
+struct CountingState {
+    uint8_t frames;
+};
+
+static uint16_t counting_step(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+    static_cast<CountingState*>(state)->frames++;
+    // the variant is the interval
+    return variant;
+}
+
+static void counting_render(const void *state, const rgblight_zone_t *zone, uint8_t first, uint8_t end) {
+    LED_TYPE color = {};
+    color.r = static_cast<const CountingState*>(state)->frames;
+    for (uint8_t i = first; i < end; i++) {
+        rgblight_zone_write(zone, i, &color);
+    }
+}
+
+static const rgblight_effect_t counting_effect = {
+    sizeof(CountingState), nullptr, counting_step, counting_render,
+};
+
+TEST_F(Rgblight, KnightFramesAreRenderedInOrder) {
+    rgblight_mode(21);
+    for (int frame = 0; frame < 4; frame++) {
+        ASSERT_TRUE(run_until_push(200));
+        for (int i = 0; i < NUM_LEDS; i++) {
+            bool lit = i >= frame && i < frame + RGBLIGHT_EFFECT_KNIGHT_LENGTH;
+            EXPECT_EQ(test_strip[i].r != 0, lit) << "frame " << frame << " LED " << i;
+        }
+    }
+}
+
+TEST_F(Rgblight, AZoneIsDrawnOverTheZonesBelowIt) {
+    rgblight_mode(9);
+    ASSERT_TRUE(rgblight_zone_start(1, 10, 10, &counting_effect, 5));
+    for (int i = 0; i < 300; i++) {
+        run_one_rgblight_scan();
+    }
+    for (int i = 0; i < NUM_LEDS; i++) {
+        bool counting = test_strip[i].g == 0 && test_strip[i].b == 0;
+        EXPECT_EQ(counting, i >= 10 && i < 20) << i;
+    }
+
+    rgblight_zone_stop(1);
+    for (int i = 0; i < 300; i++) {
+        run_one_rgblight_scan();
+    }
+    for (int i = 10; i < 20; i++) {
+        EXPECT_FALSE(test_strip[i].g == 0 && test_strip[i].b == 0) << i;
+    }
+}
+
+TEST_F(Rgblight, AStaticModeIsRedrawnWhenAZoneStops) {
+    for (uint8_t mode : {1, 25, 30}) {
+        // static modes are pushed right away
+        rgblight_mode(mode);
+        LED_TYPE before[RGBLED_NUM];
+        memcpy(before, test_strip, sizeof(before));
+        ASSERT_TRUE(rgblight_zone_start(1, 10, 10, &counting_effect, 5));
+        ASSERT_TRUE(run_until_push(10));
+        ASSERT_NE(memcmp(before, test_strip, sizeof(before)), 0);
+
+        rgblight_zone_stop(1);
+        ASSERT_TRUE(run_until_push(1));
+        EXPECT_EQ(memcmp(before, test_strip, sizeof(before)), 0) << "mode " << (int)mode;
+    }
+}
+
+TEST_F(Rgblight, AnAnimationIsRedrawnWhenAZoneStops) {
+    // christmas only steps once a second
+    rgblight_mode(24);
+    ASSERT_TRUE(run_until_push(RGBLIGHT_EFFECT_CHRISTMAS_INTERVAL + 10));
+    ASSERT_TRUE(rgblight_zone_start(1, 10, 10, &counting_effect, 5));
+    ASSERT_TRUE(run_until_push(10));
+    LED_TYPE before[RGBLED_NUM];
+    memcpy(before, test_strip, sizeof(before));
+
+    rgblight_zone_stop(1);
+    ASSERT_TRUE(run_until_push(NUM_LEDS / LEDS_PER_TASK + 1));
+    EXPECT_EQ(memcmp(before, test_strip, 10 * sizeof(LED_TYPE)), 0);
+    EXPECT_EQ(memcmp(&before[20], &test_strip[20], 10 * sizeof(LED_TYPE)), 0);
+    // the colors repeat every 2 * RGBLIGHT_EFFECT_CHRISTMAS_STEP LEDs
+    for (int i = 10; i < 20; i++) {
+        int same = i < 18 ? i - 8 : i + 8;
+        EXPECT_EQ(memcmp(&test_strip[i], &test_strip[same], sizeof(LED_TYPE)), 0) << i;
+    }
+}
+
+TEST_F(Rgblight, EveryZoneHasItsOwnState) {
+    rgblight_mode(1);
+    ASSERT_TRUE(rgblight_zone_start(1, 0, 10, &counting_effect, 10));
+    ASSERT_TRUE(rgblight_zone_start(2, 20, 10, &counting_effect, 25));
+    for (int i = 0; i < 100; i++) {
+        run_one_rgblight_scan();
+    }
+    // the first frame is stepped to right away
+    EXPECT_EQ(test_strip[0].r, 10);
+    EXPECT_EQ(test_strip[9].r, 10);
+    EXPECT_EQ(test_strip[20].r, 4);
+    EXPECT_EQ(test_strip[29].r, 4);
+    rgblight_zone_stop(1);
+    rgblight_zone_stop(2);
+}
+
+TEST_F(Rgblight, AZoneHasToFitTheStripAndTheState) {
+    EXPECT_FALSE(rgblight_zone_start(1, 20, 11, &counting_effect, 10));
+    EXPECT_FALSE(rgblight_zone_start(RGBLIGHT_ZONES, 0, 10, &counting_effect, 10));
+    rgblight_effect_t big_effect = counting_effect;
+    big_effect.state_size = 255;
+    EXPECT_FALSE(rgblight_zone_start(1, 0, 10, &big_effect, 10));
+}
+
+TEST_F(Rgblight, HsvToRgbIsWithinAFewStepsOfSethsv) {
+    for (int hue = 0; hue < 360; hue++) {
+        for (int sat : {0, 1, 100, 254, 255}) {
+            for (int val : {0, 1, 60, 128, 255}) {
+                LED_TYPE expected;
+                LED_TYPE actual;
+                sethsv(hue, sat, val, &expected);
+                hsv_to_rgb_n(hue_to_wheel(hue), 0, sat, val, &actual, 1);
+                EXPECT_LE(std::abs(expected.r - actual.r), 4) << hue << " " << sat << " " << val;
+                EXPECT_LE(std::abs(expected.g - actual.g), 4) << hue << " " << sat << " " << val;
+                EXPECT_LE(std::abs(expected.b - actual.b), 4) << hue << " " << sat << " " << val;
+                if (sat == 0) {
+                    EXPECT_EQ(memcmp(&expected, &actual, sizeof(LED_TYPE)), 0);
+                }
+            }
+        }
+    }
+}
+
+TEST_F(Rgblight, HsvToRgbRampIsTheSameAsConvertingEveryHue) {
+    const uint16_t start = 0xF000;
+    const int16_t step = -0x0A3D;
+    LED_TYPE ramp[40];
+    hsv_to_rgb_n(start, step, 200, 180, ramp, 40);
+    for (int i = 0; i < 40; i++) {
+        LED_TYPE single;
+        hsv_to_rgb_n(start + step * i, 0, 200, 180, &single, 1);
+        EXPECT_EQ(memcmp(&ramp[i], &single, sizeof(LED_TYPE)), 0) << i;
+    }
+}
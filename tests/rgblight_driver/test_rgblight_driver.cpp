@@ -0,0 +1,100 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <cstring>
+
+extern "C" {
+    void advance_time(uint32_t ms);
+
+    extern LED_TYPE test_strip[];
+    extern uint16_t test_strip_writes[];
+    extern uint8_t test_strip_write_count;
+}
+
+// Shows the number of frames in the red channel of every LED of the zone
+struct CountingState {
+    uint8_t frames;
+};
+
+static uint16_t counting_step(void *state, const rgblight_zone_t *zone, uint8_t variant) {
+    static_cast<CountingState*>(state)->frames++;
+    return 10;
+}
+
+static void counting_render(const void *state, const rgblight_zone_t *zone, uint8_t first, uint8_t end) {
+    LED_TYPE color = {};
+    color.r = static_cast<const CountingState*>(state)->frames;
+    for (uint8_t i = first; i < end; i++) {
+        rgblight_zone_write(zone, i, &color);
+    }
+}
+
+static const rgblight_effect_t counting_effect = {
+    sizeof(CountingState), nullptr, counting_step, counting_render,
+};
+
+class RgblightDriver : public TestFixture {
+public:
+    RgblightDriver() {
+        rgblight_mode(1);
+        rgblight_setrgb(10, 20, 30);
+        test_strip_write_count = 0;
+    }
+
+    ~RgblightDriver() {
+        rgblight_zone_stop(1);
+    }
+
+    void run_rgblight_scans(unsigned scans) {
+        for (unsigned i = 0; i < scans; i++) {
+            rgblight_task();
+            advance_time(1);
+        }
+    }
+};
+
+TEST_F(RgblightDriver, AColorChangePushesTheWholeStrip) {
+    rgblight_setrgb(10, 20, 31);
+    ASSERT_EQ(test_strip_write_count, 1);
+    EXPECT_EQ(test_strip_writes[0], RGBLED_NUM);
+    EXPECT_EQ(memcmp(test_strip, led, RGBLED_NUM * sizeof(LED_TYPE)), 0);
+}
+
+TEST_F(RgblightDriver, OnlyTheLedsUpToTheLastChangedOneArePushed) {
+    ASSERT_TRUE(rgblight_zone_start(1, 5, 10, &counting_effect, 0));
+    run_rgblight_scans(100);
+    ASSERT_GT(test_strip_write_count, 1);
+    for (uint8_t i = 0; i < test_strip_write_count; i++) {
+        EXPECT_EQ(test_strip_writes[i], 15) << "write " << (int)i;
+    }
+    EXPECT_EQ(memcmp(test_strip, led, 15 * sizeof(LED_TYPE)), 0);
+}
+
+TEST_F(RgblightDriver, NothingIsPushedWhenNothingChanged) {
+    rgblight_setrgb(10, 20, 30);
+    run_rgblight_scans(100);
+    EXPECT_EQ(test_strip_write_count, 0);
+}
+
+TEST_F(RgblightDriver, TurningTheLightOffPushesTheWholeStrip) {
+    ASSERT_TRUE(rgblight_zone_start(1, 0, 5, &counting_effect, 0));
+    run_rgblight_scans(20);
+    test_strip_write_count = 0;
+    rgblight_toggle();
+    ASSERT_GE(test_strip_write_count, 1);
+    EXPECT_EQ(test_strip_writes[test_strip_write_count - 1], RGBLED_NUM);
+    rgblight_toggle();
+}
@@ -0,0 +1,173 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "simulator.hpp"
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include "keyboard.h"
+#include "test_matrix.h"
+
+extern "C" {
+    uint32_t timer_read32(void);
+    void advance_time(uint32_t ms);
+}
+
+ScanLoopSimulator* ScanLoopSimulator::m_this = nullptr;
+
+ScanLoopSimulator::ScanLoopSimulator()
+    : m_driver{
+        &ScanLoopSimulator::keyboard_leds,
+        &ScanLoopSimulator::send_keyboard,
+        &ScanLoopSimulator::send_mouse,
+        &ScanLoopSimulator::send_system,
+        &ScanLoopSimulator::send_consumer
+    }
+{
+    host_set_driver(&m_driver);
+    m_this = this;
+}
+
+ScanLoopSimulator::~ScanLoopSimulator() {
+    host_set_driver(nullptr);
+    m_this = nullptr;
+}
+
+bool ScanLoopSimulator::parse_trace(std::istream& input, std::vector<TraceEvent>& trace, std::string& error) {
+    std::string line;
+    unsigned line_number = 0;
+    while (std::getline(input, line)) {
+        line_number++;
+        std::istringstream fields(line);
+        std::string first;
+        if (!(fields >> first) || first[0] == '#') {
+            continue;
+        }
+        std::istringstream time_field(first);
+        unsigned long time;
+        unsigned row, col;
+        std::string state;
+        if (!(time_field >> time) || !(fields >> row >> col >> state) || (state != "d" && state != "u")) {
+            error = "line " + std::to_string(line_number) + ": expected <milliseconds> <row> <column> <d|u>";
+            return false;
+        }
+        if (row >= MATRIX_ROWS || col >= MATRIX_COLS) {
+            error = "line " + std::to_string(line_number) + ": key outside of the matrix";
+            return false;
+        }
+        if (!trace.empty() && time < trace.back().time) {
+            error = "line " + std::to_string(line_number) + ": events are not in time order";
+            return false;
+        }
+        trace.push_back(TraceEvent{(uint32_t)time, (uint8_t)row, (uint8_t)col, state == "d"});
+    }
+    return true;
+}
+
+void ScanLoopSimulator::run(const std::vector<TraceEvent>& trace, uint32_t settle_time) {
+    m_reports.clear();
+    m_stats = SimulationStats();
+    m_start = timer_read32();
+
+    std::vector<uint32_t> latencies;
+    uint32_t end = (trace.empty() ? 0 : trace.back().time) + settle_time;
+    size_t next = 0;
+    // the events since the last report, waiting for one
+    size_t waiting = 0;
+    for (uint32_t now = 0; now <= end; now++) {
+        if (next < trace.size() && trace[next].time <= now && waiting < next) {
+            // nothing was sent for the previous events before this one
+            m_stats.silent_events += next - waiting;
+            waiting = next;
+        }
+        for (; next < trace.size() && trace[next].time <= now; next++) {
+            const TraceEvent& event = trace[next];
+            if (event.pressed) {
+                press_key(event.col, event.row);
+            } else {
+                release_key(event.col, event.row);
+            }
+        }
+
+        size_t reports = m_reports.size();
+        auto start = std::chrono::steady_clock::now();
+        keyboard_task();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        m_stats.cpu_ns_total += ns;
+        if (ns > m_stats.cpu_ns_max_scan) {
+            m_stats.cpu_ns_max_scan = ns;
+        }
+        m_stats.scans++;
+
+        if (m_reports.size() != reports) {
+            for (; waiting < next; waiting++) {
+                latencies.push_back(now - trace[waiting].time);
+            }
+        }
+        advance_time(1);
+    }
+    m_stats.silent_events += next - waiting;
+    m_stats.events = trace.size();
+
+    if (!latencies.empty()) {
+        uint64_t total = 0;
+        m_stats.latency_min = latencies[0];
+        for (uint32_t latency : latencies) {
+            total += latency;
+            m_stats.latency_min = std::min(m_stats.latency_min, latency);
+            m_stats.latency_max = std::max(m_stats.latency_max, latency);
+        }
+        m_stats.latency_avg = (double)total / latencies.size();
+    }
+}
+
+void ScanLoopSimulator::print_reports(std::ostream& output) const {
+    for (auto& sent : m_reports) {
+        output << std::setw(6) << sent.time << " mods=" << std::hex << std::setw(2) << std::setfill('0')
+            << (unsigned)sent.report.mods << " keys=";
+        for (size_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+            output << std::setw(2) << (unsigned)sent.report.keys[i] << (i + 1 < KEYBOARD_REPORT_KEYS ? " " : "");
+        }
+        output << std::dec << std::setfill(' ') << std::endl;
+    }
+}
+
+void ScanLoopSimulator::print_stats(std::ostream& output) const {
+    output << "events: " << m_stats.events << ", scans: " << m_stats.scans
+        << ", reports: " << m_reports.size() << ", silent events: " << m_stats.silent_events << std::endl;
+    output << "latency (ms): min " << m_stats.latency_min << ", avg " << std::fixed << std::setprecision(2)
+        << m_stats.latency_avg << ", max " << m_stats.latency_max << std::endl;
+    output << "cpu (ns): " << std::setprecision(1) << m_stats.cpu_ns_total / (m_stats.scans ? m_stats.scans : 1)
+        << " per scan, " << m_stats.cpu_ns_total / (m_stats.events ? m_stats.events : 1)
+        << " per event, " << m_stats.cpu_ns_max_scan << " slowest scan" << std::endl;
+    output.unsetf(std::ios::fixed);
+}
+
+uint8_t ScanLoopSimulator::keyboard_leds(void) {
+    return 0;
+}
+
+void ScanLoopSimulator::send_keyboard(report_keyboard_t* report) {
+    m_this->m_reports.push_back(SentReport{timer_read32() - m_this->m_start, *report});
+}
+
+void ScanLoopSimulator::send_mouse(report_mouse_t* report) {
+}
+
+void ScanLoopSimulator::send_system(uint16_t data) {
+}
+
+void ScanLoopSimulator::send_consumer(uint16_t data) {
+}
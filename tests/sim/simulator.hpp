@@ -0,0 +1,92 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TESTS_SIM_SIMULATOR_H_
+#define TESTS_SIM_SIMULATOR_H_
+
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "host.h"
+
+// One matrix change of a recorded trace, at a time in milliseconds
+struct TraceEvent {
+    uint32_t time;
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+};
+
+// A keyboard report as the host saw it
+struct SentReport {
+    uint32_t time;
+    report_keyboard_t report;
+};
+
+struct SimulationStats {
+    uint32_t events = 0;
+    uint32_t scans = 0;
+    // events that no report followed before the next event
+    uint32_t silent_events = 0;
+    // virtual milliseconds from a matrix change to the report it caused
+    uint32_t latency_min = 0;
+    uint32_t latency_max = 0;
+    double latency_avg = 0;
+    // host CPU time spent in keyboard_task
+    double cpu_ns_total = 0;
+    double cpu_ns_max_scan = 0;
+};
+
+/*
+ * Replays a trace of matrix changes through keyboard_task() on a virtual
+ * clock that advances one millisecond per scan, and records the reports
+ * that reach the host.
+ *
+ * A trace is a text file with one event per line:
+ *     <milliseconds> <row> <column> <d|u>
+ * Empty lines and lines starting with # are ignored.
+ */
+class ScanLoopSimulator {
+public:
+    ScanLoopSimulator();
+    ~ScanLoopSimulator();
+
+    // Returns false and describes the problem in 'error' if the trace is malformed
+    static bool parse_trace(std::istream& input, std::vector<TraceEvent>& trace, std::string& error);
+
+    // Runs the trace plus 'settle_time' milliseconds to let timers expire
+    void run(const std::vector<TraceEvent>& trace, uint32_t settle_time = 500);
+
+    const std::vector<SentReport>& reports() const { return m_reports; }
+    const SimulationStats& stats() const { return m_stats; }
+
+    void print_reports(std::ostream& output) const;
+    void print_stats(std::ostream& output) const;
+private:
+    static uint8_t keyboard_leds(void);
+    static void send_keyboard(report_keyboard_t *report);
+    static void send_mouse(report_mouse_t* report);
+    static void send_system(uint16_t data);
+    static void send_consumer(uint16_t data);
+    host_driver_t m_driver;
+    uint32_t m_start = 0;
+    std::vector<SentReport> m_reports;
+    SimulationStats m_stats;
+    static ScanLoopSimulator* m_this;
+};
+
+#endif /* TESTS_SIM_SIMULATOR_H_ */
@@ -0,0 +1,134 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include "simulator.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+class Simulator : public TestFixture {};
+
+namespace {
+    // The trace replayed by default, QMK_SIM_TRACE selects another one
+    std::string trace_path() {
+        const char* path = std::getenv("QMK_SIM_TRACE");
+        if (path) {
+            return path;
+        }
+        std::string file = __FILE__;
+        return file.substr(0, file.find_last_of('/') + 1) + "traces/quick_brown_fox.trace";
+    }
+
+    // The characters that were typed, as the host would see them
+    std::string typed_text(const std::vector<SentReport>& reports) {
+        const char* letters = "abcdefghijklmnopqrstuvwxyz";
+        std::string text;
+        report_keyboard_t previous = {};
+        for (auto& sent : reports) {
+            for (size_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+                uint8_t code = sent.report.keys[i];
+                bool was_down = false;
+                for (size_t j = 0; j < KEYBOARD_REPORT_KEYS; j++) {
+                    was_down |= previous.keys[j] == code;
+                }
+                if (!code || was_down) {
+                    continue;
+                }
+                if (code >= KC_A && code <= KC_Z) {
+                    text += letters[code - KC_A];
+                } else if (code == KC_SPC) {
+                    text += ' ';
+                } else {
+                    text += '?';
+                }
+            }
+            previous = sent.report;
+        }
+        return text;
+    }
+}
+
+TEST_F(Simulator, ParsesATrace) {
+    std::istringstream input("# comment\n\n0 0 1 d\n  12 3 9 u\n");
+    std::vector<TraceEvent> trace;
+    std::string error;
+    ASSERT_TRUE(ScanLoopSimulator::parse_trace(input, trace, error)) << error;
+    ASSERT_EQ(trace.size(), 2);
+    EXPECT_EQ(trace[0].time, 0);
+    EXPECT_EQ(trace[0].col, 1);
+    EXPECT_TRUE(trace[0].pressed);
+    EXPECT_EQ(trace[1].time, 12);
+    EXPECT_EQ(trace[1].row, 3);
+    EXPECT_EQ(trace[1].col, 9);
+    EXPECT_FALSE(trace[1].pressed);
+}
+
+TEST_F(Simulator, RejectsAMalformedTrace) {
+    std::vector<TraceEvent> trace;
+    std::string error;
+    std::istringstream bad_state("0 0 1 x\n");
+    EXPECT_FALSE(ScanLoopSimulator::parse_trace(bad_state, trace, error));
+    std::istringstream outside("0 9 1 d\n");
+    EXPECT_FALSE(ScanLoopSimulator::parse_trace(outside, trace, error));
+    std::istringstream unordered("5 0 1 d\n4 0 1 u\n");
+    EXPECT_FALSE(ScanLoopSimulator::parse_trace(unordered, trace, error));
+    EXPECT_EQ(error, "line 2: events are not in time order");
+}
+
+TEST_F(Simulator, ReportsTheLatencyOfEachEvent) {
+    std::vector<TraceEvent> trace = {
+        {10, 0, 0, true},
+        {20, 0, 0, false},
+    };
+    ScanLoopSimulator simulator;
+    simulator.run(trace, 10);
+    ASSERT_EQ(simulator.reports().size(), 2);
+    EXPECT_EQ(simulator.reports()[0].time, 10);
+    EXPECT_EQ(simulator.reports()[1].time, 20);
+    EXPECT_EQ(simulator.stats().events, 2);
+    EXPECT_EQ(simulator.stats().scans, 31);
+    EXPECT_EQ(simulator.stats().silent_events, 0);
+    EXPECT_EQ(simulator.stats().latency_max, 0);
+}
+
+// Replays the trace and prints the report stream and the statistics. Set
+// QMK_SIM_OUTPUT to write the report stream to a file instead.
+TEST_F(Simulator, ReplaysATrace) {
+    std::ifstream input(trace_path());
+    ASSERT_TRUE(input.good()) << "can't open " << trace_path();
+    std::vector<TraceEvent> trace;
+    std::string error;
+    ASSERT_TRUE(ScanLoopSimulator::parse_trace(input, trace, error)) << error;
+
+    ScanLoopSimulator simulator;
+    simulator.run(trace);
+
+    const char* output_path = std::getenv("QMK_SIM_OUTPUT");
+    if (output_path) {
+        std::ofstream output(output_path);
+        simulator.print_reports(output);
+    } else {
+        simulator.print_reports(std::cout);
+    }
+    std::cout << "[ SIMULATOR] " << trace_path() << std::endl;
+    simulator.print_stats(std::cout);
+
+    if (!std::getenv("QMK_SIM_TRACE")) {
+        EXPECT_EQ(typed_text(simulator.reports()), "the quick brown fox jumps over the lazy dog");
+    }
+    EXPECT_EQ(simulator.reports().back().report, report_keyboard_t{});
+}
@@ -0,0 +1,34 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+#include "keymap_steno.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0            1                2       3      4      5      6      7       8       9
+        {STN_SL,        STN_TL,          STN_KL, STN_A, STN_O, STN_E, STN_U, STN_FR, STN_TR, STN_ZR},
+        {QK_STENO_BOLT, QK_STENO_GEMINI, KC_NO,  KC_NO, KC_NO, KC_NO, KC_NO, KC_NO,  KC_NO,  KC_NO},
+        {KC_NO,         KC_NO,           KC_NO,  KC_NO, KC_NO, KC_NO, KC_NO, KC_NO,  KC_NO,  KC_NO},
+        {KC_NO,         KC_NO,           KC_NO,  KC_NO, KC_NO, KC_NO, KC_NO, KC_NO,  KC_NO,  KC_NO},
+    },
+};
+
+const macro_t *action_get_macro(keyrecord_t *record, uint8_t id, uint8_t opt) {
+    return MACRO_NONE;
+};
+
+void action_function(keyrecord_t *record, uint8_t id, uint8_t opt) {
+}
@@ -0,0 +1,144 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <initializer_list>
+#include <vector>
+
+using testing::_;
+
+typedef std::vector<uint8_t> Packet;
+
+// every write to the virtual serial port, as the host gets it
+static std::vector<Packet> writes;
+
+extern "C" {
+    void virtser_send(const uint8_t byte) {
+        writes.push_back(Packet(1, byte));
+    }
+
+    void virtser_send_buffer(const uint8_t *data, const uint8_t length) {
+        writes.push_back(Packet(data, data + length));
+    }
+}
+
+// the columns of the steno keys in row 0
+enum { sl, tl, kl, a, o, e, u, fr, tr, zr };
+
+class Steno : public TestFixture {
+public:
+    Steno() {
+        // steno keys don't send any reports
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    }
+
+    // with the keys of row 1, which are in the order of steno_mode_t
+    void set_mode(steno_mode_t mode) {
+        press_key(mode, 1);
+        run_one_scan_loop();
+        release_key(mode, 1);
+        run_one_scan_loop();
+        writes.clear();
+    }
+
+    // presses the keys one after the other, then releases them in the same order
+    void stroke(std::initializer_list<uint8_t> keys) {
+        for (uint8_t key : keys) {
+            press_key(key, 0);
+            run_one_scan_loop();
+        }
+        for (uint8_t key : keys) {
+            release_key(key, 0);
+            run_one_scan_loop();
+        }
+    }
+
+    TestDriver driver;
+};
+
+TEST_F(Steno, AGeminiStrokeIsOneWrite) {
+    set_mode(STENO_MODE_GEMINI);
+    stroke({kl, a, tr});
+    ASSERT_EQ(writes.size(), 1u);
+    EXPECT_EQ(writes[0], Packet({0x80, 0x08, 0x20, 0x00, 0x04, 0x00}));
+}
+
+TEST_F(Steno, ABoltStrokeIsOneWrite) {
+    set_mode(STENO_MODE_BOLT);
+    stroke({kl, a, tr});
+    ASSERT_EQ(writes.size(), 1u);
+    EXPECT_EQ(writes[0], Packet({0x04, 0x42, 0xC1, 0x00}));
+}
+
+TEST_F(Steno, BoltLeavesOutTheGroupsWithoutKeys) {
+    set_mode(STENO_MODE_BOLT);
+    stroke({zr});
+    ASSERT_EQ(writes.size(), 1u);
+    EXPECT_EQ(writes[0], Packet({0xC8, 0x00}));
+}
+
+TEST_F(Steno, TheStrokeIsSentInTheScanOfTheLastRelease) {
+    set_mode(STENO_MODE_GEMINI);
+    press_key(sl, 0);
+    press_key(tl, 0);
+    run_one_scan_loop();
+    run_one_scan_loop();
+    release_key(sl, 0);
+    run_one_scan_loop();
+    EXPECT_TRUE(writes.empty());
+    release_key(tl, 0);
+    run_one_scan_loop();
+    ASSERT_EQ(writes.size(), 1u);
+    EXPECT_EQ(writes[0], Packet({0x80, 0x50, 0x00, 0x00, 0x00, 0x00}));
+}
+
+// "STAT KOEFR UZ": what the host gets for a few recorded strokes
+TEST_F(Steno, RecordedGeminiStrokes) {
+    set_mode(STENO_MODE_GEMINI);
+    stroke({sl, tl, a, tr});
+    stroke({kl, o, e, fr});
+    stroke({u, zr});
+    std::vector<Packet> expected = {
+        {0x80, 0x50, 0x20, 0x00, 0x04, 0x00},
+        {0x80, 0x08, 0x10, 0x0A, 0x00, 0x00},
+        {0x80, 0x00, 0x00, 0x04, 0x00, 0x01},
+    };
+    EXPECT_EQ(writes, expected);
+}
+
+TEST_F(Steno, RecordedBoltStrokes) {
+    set_mode(STENO_MODE_BOLT);
+    stroke({sl, tl, a, tr});
+    stroke({kl, o, e, fr});
+    stroke({u, zr});
+    std::vector<Packet> expected = {
+        {0x03, 0x42, 0xC1, 0x00},
+        {0x04, 0x54, 0x81, 0x00},
+        {0x60, 0xC8, 0x00},
+    };
+    EXPECT_EQ(writes, expected);
+}
+
+TEST_F(Steno, EveryStrokeIsASingleWrite) {
+    set_mode(STENO_MODE_GEMINI);
+    for (int i = 0; i < 100; i++) {
+        stroke({sl, a, e, tr});
+    }
+    // every byte used to be a write of its own, each with its own flush
+    ASSERT_EQ(writes.size(), 100u);
+    for (auto &write : writes) {
+        EXPECT_EQ(write.size(), 6u);
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+
+using testing::_;
+
+typedef std::vector<uint8_t> Packet;
+
+// every write to the virtual serial port, as the host gets it
+static std::vector<Packet> writes;
+
+extern "C" {
+    void virtser_send(const uint8_t byte) {
+        writes.push_back(Packet(1, byte));
+    }
+
+    void virtser_send_buffer(const uint8_t *data, const uint8_t length) {
+        writes.push_back(Packet(data, data + length));
+    }
+}
+
+// the columns of the steno keys in row 0
+enum { sl, tl, kl, a, o, e, u, fr, tr, zr };
+
+class StenoFirstUp : public TestFixture {
+public:
+    StenoFirstUp() {
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    }
+
+    // with the keys of row 1, which are in the order of steno_mode_t
+    void set_mode(steno_mode_t mode) {
+        press_key(mode, 1);
+        run_one_scan_loop();
+        release_key(mode, 1);
+        run_one_scan_loop();
+        writes.clear();
+    }
+
+    void press(uint8_t key) {
+        press_key(key, 0);
+        run_one_scan_loop();
+    }
+
+    void release(uint8_t key) {
+        release_key(key, 0);
+        run_one_scan_loop();
+    }
+
+    TestDriver driver;
+};
+
+TEST_F(StenoFirstUp, TheFirstReleaseSendsTheStroke) {
+    set_mode(STENO_MODE_GEMINI);
+    press(kl);
+    press(a);
+    press(tr);
+    release(a);
+    ASSERT_EQ(writes.size(), 1u);
+    EXPECT_EQ(writes[0], Packet({0x80, 0x08, 0x20, 0x00, 0x04, 0x00}));
+    release(kl);
+    release(tr);
+    EXPECT_EQ(writes.size(), 1u);
+}
+
+TEST_F(StenoFirstUp, HeldKeysArePartOfTheNextStroke) {
+    set_mode(STENO_MODE_BOLT);
+    press(sl);
+    press(a);
+    release(a);
+    press(o);
+    release(o);
+    release(sl);
+    std::vector<Packet> expected = {
+        {0x01, 0x42, 0x00},
+        {0x01, 0x44, 0x00},
+    };
+    EXPECT_EQ(writes, expected);
+}
+
+TEST_F(StenoFirstUp, StrokesThatEndInOneScanAreSentInOneWrite) {
+    set_mode(STENO_MODE_GEMINI);
+    press_key(a, 0);
+    press_key(u, 0);
+    run_one_scan_loop();
+    // keys are processed by column: A ends the first stroke, E starts the
+    // next one with U, and U ends that
+    release_key(a, 0);
+    press_key(e, 0);
+    release_key(u, 0);
+    run_one_scan_loop();
+    ASSERT_EQ(writes.size(), 1u);
+    EXPECT_EQ(writes[0], Packet({
+        0x80, 0x00, 0x20, 0x04, 0x00, 0x00,
+        0x80, 0x00, 0x00, 0x0C, 0x00, 0x00,
+    }));
+    release(e);
+    EXPECT_EQ(writes.size(), 1u);
+}
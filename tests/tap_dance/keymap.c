@@ -0,0 +1,71 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+enum {
+    TD_AB,
+    TD_CD,
+    TD_FAST,
+    TD_COUNTED,
+    TD_LAST = 255,
+};
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0       1         2           3              4      5            6      7      8      9
+        {TD(TD_AB), TD(TD_CD), TD(TD_FAST), TD(TD_COUNTED), KC_X,  TD(TD_LAST), KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,     KC_NO,     KC_NO,       KC_NO,          KC_NO, KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,     KC_NO,     KC_NO,       KC_NO,          KC_NO, KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,     KC_NO,     KC_NO,       KC_NO,          KC_NO, KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO},
+    },
+};
+
+uint16_t counted_taps = 0;
+uint16_t counted_finished = 0;
+uint16_t counted_resets = 0;
+
+static void counted_each_tap(qk_tap_dance_state_t *state, void *user_data) {
+    counted_taps++;
+}
+
+static void counted_on_finished(qk_tap_dance_state_t *state, void *user_data) {
+    counted_finished++;
+}
+
+static void counted_on_reset(qk_tap_dance_state_t *state, void *user_data) {
+    counted_resets++;
+}
+
+static void fast_on_finished(qk_tap_dance_state_t *state, void *user_data) {
+    register_code(KC_E);
+}
+
+static void fast_on_reset(qk_tap_dance_state_t *state, void *user_data) {
+    unregister_code(KC_E);
+}
+
+// Every dance that can be bound, the ones in between do nothing
+qk_tap_dance_action_t tap_dance_actions[] = {
+    [TD_AB] = ACTION_TAP_DANCE_DOUBLE(KC_A, KC_B),
+    [TD_CD] = ACTION_TAP_DANCE_DOUBLE(KC_C, KC_D),
+    [TD_FAST] = ACTION_TAP_DANCE_FN_ADVANCED_TIME(NULL, fast_on_finished, fast_on_reset, 50),
+    [TD_COUNTED] = ACTION_TAP_DANCE_FN_ADVANCED(counted_each_tap, counted_on_finished, counted_on_reset),
+    [TD_LAST] = ACTION_TAP_DANCE_DOUBLE(KC_Y, KC_Z),
+};
+
+bool test_tap_dance_in_progress(void) {
+    return tap_dance_in_progress();
+}
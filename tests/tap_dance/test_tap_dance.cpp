@@ -0,0 +1,167 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+
+extern "C" {
+    extern uint16_t counted_taps;
+    extern uint16_t counted_finished;
+    extern uint16_t counted_resets;
+    bool test_tap_dance_in_progress(void);
+}
+
+using testing::_;
+using testing::Invoke;
+
+typedef std::vector<uint8_t> Keys;
+
+// The dances send a few reports that don't change anything, so instead of
+// expecting every one of them, the tests look at the sequence of distinct
+// reports that the host saw
+class TapDance : public TestFixture {
+public:
+    TapDance() {
+        counted_taps = 0;
+        counted_finished = 0;
+        counted_resets = 0;
+        EXPECT_CALL(driver, send_keyboard_mock(_)).WillRepeatedly(Invoke(
+            [this](report_keyboard_t& report) {
+                Keys keys;
+                for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+                    if (report.keys[i]) {
+                        keys.push_back(report.keys[i]);
+                    }
+                }
+                if (reports.empty() ? !keys.empty() : keys != reports.back()) {
+                    reports.push_back(keys);
+                }
+            }));
+    }
+
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        run_one_scan_loop();
+        release_key(col, 0);
+        run_one_scan_loop();
+    }
+
+    TestDriver driver;
+    std::vector<Keys> reports;
+};
+
+TEST_F(TapDance, NothingIsInProgressWhenIdle) {
+    EXPECT_FALSE(test_tap_dance_in_progress());
+    idle_for(TAPPING_TERM * 2);
+    EXPECT_TRUE(reports.empty());
+}
+
+TEST_F(TapDance, ASingleTapFinishesAfterTheTappingTerm) {
+    tap(0);
+    EXPECT_TRUE(test_tap_dance_in_progress());
+    idle_for(TAPPING_TERM - 10);
+    EXPECT_TRUE(reports.empty());
+    idle_for(20);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_A}, {}}));
+    EXPECT_FALSE(test_tap_dance_in_progress());
+}
+
+TEST_F(TapDance, ADoubleTapSendsTheSecondKey) {
+    tap(0);
+    idle_for(TAPPING_TERM / 2);
+    tap(0);
+    idle_for(TAPPING_TERM / 2);
+    EXPECT_TRUE(reports.empty());
+    idle_for(TAPPING_TERM);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_B}, {}}));
+}
+
+TEST_F(TapDance, AnotherDanceFinishesTheFirstOne) {
+    tap(0);
+    tap(1);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_A}, {}}));
+    idle_for(TAPPING_TERM + 10);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_A}, {}, {KC_C}, {}}));
+    EXPECT_FALSE(test_tap_dance_in_progress());
+}
+
+TEST_F(TapDance, InterleavedDancesTimeOutInTheOrderOfTheirDeadlines) {
+    // The fast dance is tapped after the other one but times out first,
+    // while the other one is still held down
+    press_key(0, 0);
+    run_one_scan_loop();
+    tap(2);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_A}}));
+    idle_for(60);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_A}, {KC_A, KC_E}, {KC_A}}));
+    idle_for(TAPPING_TERM);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_A}, {KC_A, KC_E}, {KC_A}}));
+    EXPECT_TRUE(test_tap_dance_in_progress());
+    release_key(0, 0);
+    run_one_scan_loop();
+    run_one_scan_loop();
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_A}, {KC_A, KC_E}, {KC_A}, {}}));
+    EXPECT_FALSE(test_tap_dance_in_progress());
+}
+
+TEST_F(TapDance, AHeldDanceIsResetOnceReleased) {
+    press_key(1, 0);
+    idle_for(TAPPING_TERM * 3);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_C}}));
+    release_key(1, 0);
+    run_one_scan_loop();
+    run_one_scan_loop();
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_C}, {}}));
+    EXPECT_FALSE(test_tap_dance_in_progress());
+}
+
+TEST_F(TapDance, ARegularKeyInterruptsEveryActiveDance) {
+    press_key(0, 0);
+    run_one_scan_loop();
+    tap(5);
+    release_key(0, 0);
+    run_one_scan_loop();
+    tap(4);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_A}, {}, {KC_Y}, {}, {KC_X}, {}}));
+    EXPECT_FALSE(test_tap_dance_in_progress());
+    idle_for(TAPPING_TERM * 2);
+    EXPECT_EQ(reports.size(), 6u);
+}
+
+TEST_F(TapDance, TheCallbacksAreCalledOncePerDance) {
+    tap(3);
+    tap(3);
+    tap(3);
+    EXPECT_EQ(counted_taps, 3);
+    EXPECT_EQ(counted_finished, 0);
+    idle_for(TAPPING_TERM * 2);
+    EXPECT_EQ(counted_finished, 1);
+    EXPECT_EQ(counted_resets, 1);
+    tap(3);
+    tap(0);
+    EXPECT_EQ(counted_taps, 4);
+    EXPECT_EQ(counted_finished, 2);
+    EXPECT_EQ(counted_resets, 2);
+    idle_for(TAPPING_TERM * 2);
+}
+
+TEST_F(TapDance, TheLastOfManyDancesTimesOut) {
+    // The scan used to look at every dance before the one in flight
+    tap(5);
+    idle_for(TAPPING_TERM - 10);
+    EXPECT_TRUE(reports.empty());
+    idle_for(20);
+    EXPECT_EQ(reports, std::vector<Keys>({{KC_Y}, {}}));
+}
@@ -18,7 +18,8 @@ using testing::Between;
 
 void TestFixture::SetUpTestCase() {
     TestDriver driver;
-    EXPECT_CALL(driver, send_keyboard_mock(_));
+    // Only the first test case sends it, the report is the same for the others
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(Between(0, 1));
     keyboard_init();
 }
 
@@ -19,6 +19,8 @@ TMK_COMMON_SRC +=	$(COMMON_DIR)/host.c \
 	$(COMMON_DIR)/util.c \
 	$(COMMON_DIR)/eeconfig.c \
 	$(COMMON_DIR)/report.c \
+	$(COMMON_DIR)/deadline.c \
+	$(COMMON_DIR)/output_queue.c \
 	$(PLATFORM_COMMON_DIR)/suspend.c \
 	$(PLATFORM_COMMON_DIR)/timer.c \
 	$(PLATFORM_COMMON_DIR)/bootloader.c \
@@ -87,6 +89,11 @@ ifeq ($(strip $(SLEEP_LED_ENABLE)), yes)
     TMK_COMMON_DEFS += -DNO_SUSPEND_POWER_DOWN
 endif
 
+ifeq ($(strip $(PROFILE_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/profile.c
+    TMK_COMMON_DEFS += -DPROFILE_ENABLE
+endif
+
 ifeq ($(strip $(NO_UART)), yes)
     TMK_COMMON_DEFS += -DNO_UART
 endif
@@ -27,6 +27,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action_util.h"
 #include "action.h"
 #include "wait.h"
+#include "profile.h"
+#include "output_queue.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -135,7 +137,10 @@ void process_record(keyrecord_t *record)
 {
     if (IS_NOEVENT(record->event)) { return; }
 
-    if(!process_record_quantum(record))
+    PROFILE_BEGIN(PROFILE_PROCESS_RECORD);
+    bool quantum_result = process_record_quantum(record);
+    PROFILE_END(PROFILE_PROCESS_RECORD);
+    if(!quantum_result)
         return;
 
     action_t action = store_or_get_action(record->event.pressed, record->event.key);
@@ -617,6 +622,10 @@ void register_code(uint8_t code)
         return;
     }
 
+    else if (output_queue_defer(OUTPUT_KEY_DOWN, code)) {
+        return;
+    }
+
 #ifdef LOCKING_SUPPORT_ENABLE
     else if (KC_LOCKING_CAPS == code) {
 #ifdef LOCKING_RESYNC_ENABLE
@@ -692,6 +701,10 @@ void unregister_code(uint8_t code)
         return;
     }
 
+    else if (output_queue_defer(OUTPUT_KEY_UP, code)) {
+        return;
+    }
+
 #ifdef LOCKING_SUPPORT_ENABLE
     else if (KC_LOCKING_CAPS == code) {
 #ifdef LOCKING_RESYNC_ENABLE
@@ -743,7 +756,7 @@ void unregister_code(uint8_t code)
 
 void register_mods(uint8_t mods)
 {
-    if (mods) {
+    if (mods && !output_queue_defer(OUTPUT_MODS_DOWN, mods)) {
         add_mods(mods);
         send_keyboard_report();
     }
@@ -751,7 +764,7 @@ void register_mods(uint8_t mods)
 
 void unregister_mods(uint8_t mods)
 {
-    if (mods) {
+    if (mods && !output_queue_defer(OUTPUT_MODS_UP, mods)) {
         del_mods(mods);
         send_keyboard_report();
     }
@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string.h>
 #include "keyboard.h"
 #include "action.h"
 #include "util.h"
@@ -186,14 +187,13 @@ action_t store_or_get_action(bool pressed, keypos_t key)
 }
 
 
-int8_t layer_switch_get_layer(keypos_t key)
-{
 #ifndef NO_ACTION_LAYER
+/* check top layer first */
+static int8_t layer_switch_find_layer(uint32_t layers, keypos_t key)
+{
     action_t action;
     action.code = ACTION_TRANSPARENT;
 
-    uint32_t layers = layer_state | default_layer_state;
-    /* check top layer first */
     for (int8_t i = 31; i >= 0; i--) {
         if (layers & (1UL<<i)) {
             action = action_for_key(i, key);
@@ -204,6 +204,57 @@ int8_t layer_switch_get_layer(keypos_t key)
     }
     /* fall back to layer 0 */
     return 0;
+}
+#endif
+
+#if !defined(NO_ACTION_LAYER) && defined(LAYER_LOOKUP_CACHE)
+/*
+ * Resolved layer of every key for the current layer state. Entries are
+ * filled in on the first lookup of a key and all of them are dropped as
+ * soon as layer_state | default_layer_state differs from the state they
+ * were resolved for, so a layer change costs a memset and each key pays
+ * the linear probe at most once per layer state.
+ */
+static uint8_t layer_lookup_cache[MATRIX_ROWS * MATRIX_COLS];
+static uint8_t layer_lookup_valid[(MATRIX_ROWS * MATRIX_COLS + 7) / 8];
+static uint32_t layer_lookup_state = 0;
+
+void layer_lookup_cache_clear(void)
+{
+    memset(layer_lookup_valid, 0, sizeof(layer_lookup_valid));
+}
+
+static int8_t layer_lookup_cache_get(uint32_t layers, keypos_t key)
+{
+    if (key.row >= MATRIX_ROWS || key.col >= MATRIX_COLS) {
+        return layer_switch_find_layer(layers, key);
+    }
+    if (layers != layer_lookup_state) {
+        layer_lookup_cache_clear();
+        layer_lookup_state = layers;
+    }
+
+    const uint16_t key_number = key.col + (key.row * MATRIX_COLS);
+    const uint8_t storage_row = key_number / 8;
+    const uint8_t storage_bit = 1U << (key_number % 8);
+
+    if (!(layer_lookup_valid[storage_row] & storage_bit)) {
+        layer_lookup_cache[key_number] = layer_switch_find_layer(layers, key);
+        layer_lookup_valid[storage_row] |= storage_bit;
+    }
+    return layer_lookup_cache[key_number];
+}
+#endif
+
+int8_t layer_switch_get_layer(keypos_t key)
+{
+#ifndef NO_ACTION_LAYER
+    uint32_t layers = layer_state | default_layer_state;
+#ifdef LAYER_LOOKUP_CACHE
+    return layer_lookup_cache_get(layers, key);
+#else
+    return layer_switch_find_layer(layers, key);
+#endif
 #else
     return biton32(default_layer_state);
 #endif
@@ -21,6 +21,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "keyboard.h"
 #include "action.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 /*
  * Default Layer
@@ -85,10 +88,22 @@ uint8_t read_source_layers_cache(keypos_t key);
 #endif
 action_t store_or_get_action(bool pressed, keypos_t key);
 
+/* resolved layer cache, refilled lazily when the layer state changes */
+#if !defined(NO_ACTION_LAYER) && defined(LAYER_LOOKUP_CACHE)
+/* call after changing the keymap contents at runtime */
+void layer_lookup_cache_clear(void);
+#else
+#define layer_lookup_cache_clear()
+#endif
+
 /* return the topmost non-transparent layer currently associated with key */
 int8_t layer_switch_get_layer(keypos_t key);
 
 /* return action depending on current layer status */
 action_t layer_switch_get_action(keypos_t key);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
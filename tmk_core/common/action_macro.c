@@ -17,7 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "action.h"
 #include "action_util.h"
 #include "action_macro.h"
-#include "wait.h"
+#include "output_queue.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -35,12 +35,15 @@ void action_macro_play(const macro_t *macro_p)
     uint8_t interval = 0;
 
     if (!macro_p) return;
+    // the steps are sent from keyboard_task(), see output_queue.h
+    output_queue_begin();
     while (true) {
         switch (MACRO_READ()) {
             case KEY_DOWN:
                 MACRO_READ();
                 dprintf("KEY_DOWN(%02X)\n", macro);
                 if (IS_MOD(macro)) {
+                    if (output_queue_defer(OUTPUT_MACRO_MODS_DOWN, MOD_BIT(macro))) break;
                     add_macro_mods(MOD_BIT(macro));
                     send_keyboard_report();
                 } else {
@@ -51,6 +54,7 @@ void action_macro_play(const macro_t *macro_p)
                 MACRO_READ();
                 dprintf("KEY_UP(%02X)\n", macro);
                 if (IS_MOD(macro)) {
+                    if (output_queue_defer(OUTPUT_MACRO_MODS_UP, MOD_BIT(macro))) break;
                     del_macro_mods(MOD_BIT(macro));
                     send_keyboard_report();
                 } else {
@@ -60,7 +64,7 @@ void action_macro_play(const macro_t *macro_p)
             case WAIT:
                 MACRO_READ();
                 dprintf("WAIT(%u)\n", macro);
-                { uint8_t ms = macro; while (ms--) wait_ms(1); }
+                output_queue_delay(macro);
                 break;
             case INTERVAL:
                 interval = MACRO_READ();
@@ -76,10 +80,11 @@ void action_macro_play(const macro_t *macro_p)
                 break;
             case END:
             default:
+                output_queue_end();
                 return;
         }
         // interval
-        { uint8_t ms = interval; while (ms--) wait_ms(1); }
+        output_queue_delay(interval);
     }
 }
 #endif
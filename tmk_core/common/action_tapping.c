@@ -4,7 +4,9 @@
 #include "action_layer.h"
 #include "action_tapping.h"
 #include "keycode.h"
+#include "matrix.h"
 #include "timer.h"
+#include "deadline.h"
 
 #ifdef DEBUG_ACTION
 #include "debug.h"
@@ -26,9 +28,24 @@ static keyrecord_t waiting_buffer[WAITING_BUFFER_SIZE] = {};
 static uint8_t waiting_buffer_head = 0;
 static uint8_t waiting_buffer_tail = 0;
 
+/* Index of the keys in the waiting buffer, so that looking up whether a key
+ * was pressed or released does not need to scan it. A bit is set while at
+ * least one such event of the key is buffered. When the same event of a key
+ * is buffered more than once the index is rebuilt once one of them leaves.
+ */
+static matrix_row_t waiting_buffer_pressed[MATRIX_ROWS];
+static matrix_row_t waiting_buffer_released[MATRIX_ROWS];
+static uint8_t waiting_buffer_duplicates = 0;
+static uint8_t waiting_buffer_presses = 0;
+
+#define WAITING_BUFFER_INDEXED(k)   ((k).row < MATRIX_ROWS && (k).col < MATRIX_COLS)
+
 static bool process_tapping(keyrecord_t *record);
 static bool waiting_buffer_enq(keyrecord_t record);
-static void waiting_buffer_clear(void);
+static void waiting_buffer_deq(void);
+static void waiting_buffer_process(void);
+static void waiting_buffer_overflow(void);
+static bool waiting_buffer_has(keypos_t key, bool pressed);
 static bool waiting_buffer_typed(keyevent_t event);
 static bool waiting_buffer_has_anykey_pressed(void);
 static void waiting_buffer_scan_tap(void);
@@ -36,6 +53,35 @@ static void debug_tapping_key(void);
 static void debug_waiting_buffer(void);
 
 
+/* returns false when the event was already in the index */
+static bool waiting_buffer_index_set(keyevent_t event)
+{
+    if (!WAITING_BUFFER_INDEXED(event.key)) {
+        return true;
+    }
+    matrix_row_t *index = event.pressed ? waiting_buffer_pressed : waiting_buffer_released;
+    matrix_row_t bit = (matrix_row_t)1 << event.key.col;
+    if (index[event.key.row] & bit) {
+        return false;
+    }
+    index[event.key.row] |= bit;
+    return true;
+}
+
+static void waiting_buffer_index_rebuild(void)
+{
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        waiting_buffer_pressed[row] = 0;
+        waiting_buffer_released[row] = 0;
+    }
+    waiting_buffer_duplicates = 0;
+    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
+        if (!waiting_buffer_index_set(waiting_buffer[i].event)) {
+            waiting_buffer_duplicates++;
+        }
+    }
+}
+
 void action_tapping_process(keyrecord_t record)
 {
     if (process_tapping(&record)) {
@@ -44,11 +90,9 @@ void action_tapping_process(keyrecord_t record)
         }
     } else {
         if (!waiting_buffer_enq(record)) {
-            // clear all in case of overflow.
-            debug("OVERFLOW: CLEAR ALL STATES\n");
-            clear_keyboard();
-            waiting_buffer_clear();
-            tapping_key = (keyrecord_t){};
+            // make room, the overflow policy always frees at least one slot
+            waiting_buffer_overflow();
+            waiting_buffer_enq(record);
         }
     }
 
@@ -56,17 +100,19 @@ void action_tapping_process(keyrecord_t record)
     if (!IS_NOEVENT(record.event) && waiting_buffer_head != waiting_buffer_tail) {
         debug("---- action_exec: process waiting_buffer -----\n");
     }
-    for (; waiting_buffer_tail != waiting_buffer_head; waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE) {
-        if (process_tapping(&waiting_buffer[waiting_buffer_tail])) {
-            debug("processed: waiting_buffer["); debug_dec(waiting_buffer_tail); debug("] = ");
-            debug_record(waiting_buffer[waiting_buffer_tail]); debug("\n\n");
-        } else {
-            break;
-        }
-    }
+    waiting_buffer_process();
     if (!IS_NOEVENT(record.event)) {
         debug("\n");
     }
+
+    // The tick events decide about the tapping key, this only makes sure
+    // that there is one once TAPPING_TERM has passed
+    uint16_t tapping_deadline = tapping_key.event.time + TAPPING_TERM;
+    if (IS_TAPPING() && (int16_t)(tapping_deadline - timer_read()) > 0) {
+        deadline_set(DEADLINE_TAPPING, tapping_deadline, NULL);
+    } else {
+        deadline_clear(DEADLINE_TAPPING);
+    }
 }
 
 
@@ -304,34 +350,92 @@ bool waiting_buffer_enq(keyrecord_t record)
 
     waiting_buffer[waiting_buffer_head] = record;
     waiting_buffer_head = (waiting_buffer_head + 1) % WAITING_BUFFER_SIZE;
+    if (record.event.pressed) {
+        waiting_buffer_presses++;
+    }
+    if (!waiting_buffer_index_set(record.event)) {
+        waiting_buffer_duplicates++;
+    }
 
     debug("waiting_buffer_enq: "); debug_waiting_buffer();
     return true;
 }
 
-void waiting_buffer_clear(void)
+/* remove the oldest event */
+void waiting_buffer_deq(void)
 {
-    waiting_buffer_head = 0;
-    waiting_buffer_tail = 0;
+    keyevent_t event = waiting_buffer[waiting_buffer_tail].event;
+    waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE;
+    if (event.pressed) {
+        waiting_buffer_presses--;
+    }
+    if (!WAITING_BUFFER_INDEXED(event.key)) {
+        return;
+    }
+    if (waiting_buffer_duplicates) {
+        waiting_buffer_index_rebuild();
+    } else {
+        matrix_row_t *index = event.pressed ? waiting_buffer_pressed : waiting_buffer_released;
+        index[event.key.row] &= ~((matrix_row_t)1 << event.key.col);
+    }
 }
 
-bool waiting_buffer_typed(keyevent_t event)
+/* process the buffered events until one has to wait for the tapping key again */
+void waiting_buffer_process(void)
+{
+    while (waiting_buffer_tail != waiting_buffer_head) {
+        if (!process_tapping(&waiting_buffer[waiting_buffer_tail])) {
+            break;
+        }
+        debug("processed: waiting_buffer["); debug_dec(waiting_buffer_tail); debug("] = ");
+        debug_record(waiting_buffer[waiting_buffer_tail]); debug("\n\n");
+        waiting_buffer_deq();
+    }
+}
+
+void waiting_buffer_overflow(void)
+{
+#ifdef WAITING_BUFFER_FLUSH_OLDEST
+    debug("waiting_buffer_overflow: process oldest\n");
+    process_record(&waiting_buffer[waiting_buffer_tail]);
+    waiting_buffer_deq();
+#else
+    // events are only buffered while the tapping key is undecided, which
+    // leaves the first buffered event free to be processed afterwards
+    debug("waiting_buffer_overflow: tapping key held\n");
+    if (IS_TAPPING_PRESSED() && tapping_key.tap.count == 0) {
+        process_record(&tapping_key);
+    }
+    tapping_key = (keyrecord_t){};
+    debug_tapping_key();
+    waiting_buffer_process();
+#endif
+}
+
+/* whether an event of the key with the given state is buffered */
+bool waiting_buffer_has(keypos_t key, bool pressed)
 {
+    if (WAITING_BUFFER_INDEXED(key)) {
+        const matrix_row_t *index = pressed ? waiting_buffer_pressed : waiting_buffer_released;
+        return index[key.row] & ((matrix_row_t)1 << key.col);
+    }
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (KEYEQ(event.key, waiting_buffer[i].event.key) && event.pressed !=  waiting_buffer[i].event.pressed) {
+        if (KEYEQ(key, waiting_buffer[i].event.key) && pressed == waiting_buffer[i].event.pressed) {
             return true;
         }
     }
     return false;
 }
 
+bool waiting_buffer_typed(keyevent_t event)
+{
+    return waiting_buffer_has(event.key, !event.pressed);
+}
+
 __attribute__((unused))
 bool waiting_buffer_has_anykey_pressed(void)
 {
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (waiting_buffer[i].event.pressed) return true;
-    }
-    return false;
+    return waiting_buffer_presses > 0;
 }
 
 /* scan buffer for tapping */
@@ -341,6 +445,7 @@ void waiting_buffer_scan_tap(void)
     if (tapping_key.tap.count > 0) return;
     // invalid state: tapping_key released && tap.count == 0
     if (!tapping_key.event.pressed) return;
+    if (!waiting_buffer_has(tapping_key.event.key, false)) return;
 
     for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
         if (IS_TAPPING_KEY(waiting_buffer[i].event.key) &&
@@ -29,7 +29,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define TAPPING_TOGGLE  5
 #endif
 
+/* number of key events that can wait for the tapping key to settle, at most 255 */
+#ifndef WAITING_BUFFER_SIZE
 #define WAITING_BUFFER_SIZE 8
+#endif
+
+/* When the waiting buffer is full the tapping key is settled as held, so
+ * that the buffered events can be processed. Define WAITING_BUFFER_FLUSH_OLDEST
+ * to process the oldest buffered event right away instead and keep the
+ * tapping key undecided.
+ */
 
 
 #ifndef NO_ACTION_TAPPING
@@ -14,13 +14,17 @@ GNU General Public License for more details.
 You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <string.h>
 #include "host.h"
 #include "report.h"
 #include "debug.h"
 #include "action_util.h"
 #include "action_layer.h"
+#include "output_queue.h"
 #include "timer.h"
+#include "deadline.h"
 #include "keycode_config.h"
+#include "util.h"
 
 extern keymap_config_t keymap_config;
 
@@ -29,23 +33,116 @@ static uint8_t real_mods = 0;
 static uint8_t weak_mods = 0;
 static uint8_t macro_mods = 0;
 
-#ifdef USB_6KRO_ENABLE
-#define RO_ADD(a, b) ((a + b) % KEYBOARD_REPORT_KEYS)
-#define RO_SUB(a, b) ((a - b + KEYBOARD_REPORT_KEYS) % KEYBOARD_REPORT_KEYS)
-#define RO_INC(a) RO_ADD(a, 1)
-#define RO_DEC(a) RO_SUB(a, 1)
-static int8_t cb_head = 0;
-static int8_t cb_tail = 0;
-static int8_t cb_count = 0;
-#endif
-
 // TODO: pointer variable is not needed
 //report_keyboard_t keyboard_report = {};
 report_keyboard_t *keyboard_report = &(report_keyboard_t){};
 
-extern inline void add_key(uint8_t key);
-extern inline void del_key(uint8_t key);
-extern inline void clear_keys(void);
+/* Keys
+ *
+ * The keys that are down are kept as a bitmap of all keycodes, from which
+ * keyboard_report is only rebuilt when a key was added or removed. In 6KRO
+ * mode the keys already in the report keep their place, and keys that did
+ * not fit take the places that become free in keycode order.
+ */
+static uint8_t key_bits[32];
+static uint8_t key_count = 0;
+static bool keys_dirty = false;
+#ifdef NKRO_ENABLE
+static bool keys_nkro = false;
+#endif
+
+static report_keyboard_t last_report;
+static bool last_report_valid = false;
+
+#define KEY_BIT_IS_SET(bits, code) ((bits)[(code) >> 3] & (1 << ((code) & 7)))
+
+void add_key(uint8_t key)
+{
+    if (KEY_BIT_IS_SET(key_bits, key)) {
+        return;
+    }
+    key_bits[key >> 3] |= 1 << (key & 7);
+    key_count++;
+    keys_dirty = true;
+}
+
+void del_key(uint8_t key)
+{
+    if (!KEY_BIT_IS_SET(key_bits, key)) {
+        return;
+    }
+    key_bits[key >> 3] &= ~(1 << (key & 7));
+    key_count--;
+    keys_dirty = true;
+}
+
+void clear_keys(void)
+{
+    if (!key_count) {
+        return;
+    }
+    memset(key_bits, 0, sizeof(key_bits));
+    key_count = 0;
+    keys_dirty = true;
+}
+
+uint8_t count_keys(void)
+{
+    return key_count;
+}
+
+static void build_keys_6kro(void)
+{
+    uint8_t pending[sizeof(key_bits)];
+    uint8_t reported = 0;
+    memcpy(pending, key_bits, sizeof(key_bits));
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        uint8_t code = keyboard_report->keys[i];
+        if (code && KEY_BIT_IS_SET(pending, code)) {
+            pending[code >> 3] &= ~(1 << (code & 7));
+            reported++;
+        } else {
+            keyboard_report->keys[i] = 0;
+        }
+    }
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < sizeof(pending) && reported < key_count; i++) {
+        for (uint8_t bits = pending[i]; bits && reported < key_count; bits &= bits - 1) {
+            while (slot < KEYBOARD_REPORT_KEYS && keyboard_report->keys[slot]) {
+                slot++;
+            }
+            if (slot == KEYBOARD_REPORT_KEYS) {
+                return;
+            }
+            keyboard_report->keys[slot] = i << 3 | biton(bits & -bits);
+            reported++;
+        }
+    }
+}
+
+static void build_keys(void)
+{
+#ifdef NKRO_ENABLE
+    bool nkro = keyboard_protocol && keymap_config.nkro;
+    if (nkro != keys_nkro) {
+        // the two layouts share the bytes after mods
+        clear_keys_from_report(keyboard_report);
+        keys_nkro = nkro;
+        keys_dirty = true;
+    }
+#endif
+    if (!keys_dirty) {
+        return;
+    }
+    keys_dirty = false;
+#ifdef NKRO_ENABLE
+    if (keys_nkro) {
+        memcpy(keyboard_report->nkro.bits, key_bits, KEYBOARD_REPORT_BITS < sizeof(key_bits) ? KEYBOARD_REPORT_BITS : sizeof(key_bits));
+        return;
+    }
+#endif
+    build_keys_6kro();
+}
 
 #ifndef NO_ACTION_ONESHOT
 static int8_t oneshot_mods = 0;
@@ -93,12 +190,14 @@ void set_oneshot_layer(uint8_t layer, uint8_t state)
     layer_on(layer);
 #if (defined(ONESHOT_TIMEOUT) && (ONESHOT_TIMEOUT > 0))
     oneshot_layer_time = timer_read();
+    deadline_set(DEADLINE_ONESHOT_LAYER, oneshot_layer_time + ONESHOT_TIMEOUT, NULL);
 #endif
 }
 void reset_oneshot_layer(void) {
     oneshot_layer_data = 0;
 #if (defined(ONESHOT_TIMEOUT) && (ONESHOT_TIMEOUT > 0))
     oneshot_layer_time = 0;
+    deadline_clear(DEADLINE_ONESHOT_LAYER);
 #endif
 }
 void clear_oneshot_layer_state(oneshot_fullfillment_t state)
@@ -119,27 +218,42 @@ bool is_oneshot_layer_active(void)
 #endif
 
 void send_keyboard_report(void) {
+    build_keys();
     keyboard_report->mods  = real_mods;
-    keyboard_report->mods |= weak_mods;
     keyboard_report->mods |= macro_mods;
+    // while queued output is sent they go with the queued keys, see output_queue.h
+    if (output_queue_busy()) {
+        keyboard_report->mods |= output_queue_mods();
+    } else {
+        keyboard_report->mods |= weak_mods;
 #ifndef NO_ACTION_ONESHOT
-    if (oneshot_mods) {
+        if (oneshot_mods) {
 #if (defined(ONESHOT_TIMEOUT) && (ONESHOT_TIMEOUT > 0))
-        if (has_oneshot_mods_timed_out()) {
-            dprintf("Oneshot: timeout\n");
-            clear_oneshot_mods();
-        }
+            if (has_oneshot_mods_timed_out()) {
+                dprintf("Oneshot: timeout\n");
+                clear_oneshot_mods();
+            }
 #endif
-        keyboard_report->mods |= oneshot_mods;
-        if (has_anykey(keyboard_report)) {
-            clear_oneshot_mods();
+            keyboard_report->mods |= oneshot_mods;
+            if (key_count) {
+                clear_oneshot_mods();
+            }
         }
-    }
-
 #endif
+    }
+    if (last_report_valid && !memcmp(&last_report, keyboard_report, sizeof(last_report))) {
+        return;
+    }
+    last_report = *keyboard_report;
+    last_report_valid = true;
     host_keyboard_send(keyboard_report);
 }
 
+void resend_keyboard_report(void) {
+    last_report_valid = false;
+    send_keyboard_report();
+}
+
 /* modifier */
 uint8_t get_mods(void) { return real_mods; }
 void add_mods(uint8_t mods) { real_mods |= mods; }
@@ -168,6 +282,7 @@ void set_oneshot_mods(uint8_t mods)
     oneshot_mods = mods;
 #if (defined(ONESHOT_TIMEOUT) && (ONESHOT_TIMEOUT > 0))
     oneshot_time = timer_read();
+    deadline_set(DEADLINE_ONESHOT_MODS, oneshot_time + ONESHOT_TIMEOUT, NULL);
 #endif
 }
 void clear_oneshot_mods(void)
@@ -175,6 +290,7 @@ void clear_oneshot_mods(void)
     oneshot_mods = 0;
 #if (defined(ONESHOT_TIMEOUT) && (ONESHOT_TIMEOUT > 0))
     oneshot_time = 0;
+    deadline_clear(DEADLINE_ONESHOT_MODS);
 #endif
 }
 uint8_t get_oneshot_mods(void)
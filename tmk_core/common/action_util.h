@@ -26,20 +26,17 @@ extern "C" {
 
 extern report_keyboard_t *keyboard_report;
 
+/* sends keyboard_report if it differs from the last one sent */
 void send_keyboard_report(void);
+/* sends keyboard_report even if it did not change, e.g. after a wakeup */
+void resend_keyboard_report(void);
 
 /* key */
-inline void add_key(uint8_t key) {
-  add_key_to_report(keyboard_report, key);
-}
-
-inline void del_key(uint8_t key) {
-  del_key_from_report(keyboard_report, key);
-}
-
-inline void clear_keys(void) {
-  clear_keys_from_report(keyboard_report);
-}
+void add_key(uint8_t key);
+void del_key(uint8_t key);
+void clear_keys(void);
+/* number of keys that are down, including those that do not fit into a 6KRO report */
+uint8_t count_keys(void);
 
 /* modifier */
 uint8_t get_mods(void);
@@ -33,6 +33,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "led.h"
 #include "command.h"
 #include "backlight.h"
+#include "profile.h"
 #include "quantum.h"
 #include "version.h"
 
@@ -170,6 +171,10 @@ static void command_common_help(void)
 #ifdef SLEEP_LED_ENABLE
 		STR(MAGIC_KEY_SLEEP_LED   ) ":	Sleep LED Test\n"
 #endif
+
+#ifdef PROFILE_ENABLE
+		STR(MAGIC_KEY_PROFILE     ) ":	Print and Reset Profile\n"
+#endif
     );
 }
 
@@ -322,6 +327,15 @@ static bool command_common(uint8_t code)
             break;
 #endif
 
+#ifdef PROFILE_ENABLE
+
+		// print and restart the scan loop profile
+        case MAGIC_KC(MAGIC_KEY_PROFILE):
+            profile_print();
+            profile_reset();
+            break;
+#endif
+
 #ifdef BOOTMAGIC_ENABLE
 
 		// print stored eeprom config
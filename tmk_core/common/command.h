@@ -151,6 +151,10 @@ bool command_proc(uint8_t code);
 
 #endif
 
+#ifndef MAGIC_KEY_PROFILE
+#define MAGIC_KEY_PROFILE        P
+#endif
+
 #define XMAGIC_KC(key) KC_##key
 #define MAGIC_KC(key) XMAGIC_KC(key)
 
@@ -0,0 +1,117 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "deadline.h"
+#include "timer.h"
+
+typedef uint8_t deadline_mask_t;
+
+/* one bit of deadline_mask per slot */
+typedef char deadline_mask_is_wide_enough[DEADLINE_COUNT <= 8 ? 1 : -1];
+
+static uint16_t deadline_time[DEADLINE_COUNT];
+static deadline_callback_t deadline_callback[DEADLINE_COUNT];
+static deadline_mask_t deadline_mask;
+
+/* the earliest of the pending deadlines, valid while deadline_mask is set */
+static uint16_t deadline_earliest;
+
+/* every deadline lies less than 32 seconds after 'now' */
+#define DEADLINE_BEFORE(a, b, now) ((int16_t)((a) - (now)) < (int16_t)((b) - (now)))
+#define DEADLINE_BIT(id) ((deadline_mask_t)1 << (id))
+
+static void deadline_update(uint16_t now) {
+    bool found = false;
+    for (uint8_t i = 0; i < DEADLINE_COUNT; i++) {
+        if ((deadline_mask & DEADLINE_BIT(i)) &&
+            (!found || DEADLINE_BEFORE(deadline_time[i], deadline_earliest, now))) {
+            deadline_earliest = deadline_time[i];
+            found = true;
+        }
+    }
+}
+
+void deadline_set(deadline_id_t id, uint16_t time, deadline_callback_t callback) {
+    uint16_t now = timer_read();
+    bool was_earliest = (deadline_mask & DEADLINE_BIT(id)) && deadline_time[id] == deadline_earliest;
+
+    if (was_earliest && time == deadline_earliest) {
+        deadline_callback[id] = callback;
+        return;
+    }
+    deadline_time[id] = time;
+    deadline_callback[id] = callback;
+    if (!deadline_mask || DEADLINE_BEFORE(time, deadline_earliest, now)) {
+        deadline_mask |= DEADLINE_BIT(id);
+        deadline_earliest = time;
+        return;
+    }
+    deadline_mask |= DEADLINE_BIT(id);
+    if (was_earliest) {
+        // it moved back, another one might come first now
+        deadline_update(now);
+    }
+}
+
+void deadline_set_earliest(deadline_id_t id, uint16_t time, deadline_callback_t callback) {
+    if ((deadline_mask & DEADLINE_BIT(id)) &&
+        !DEADLINE_BEFORE(time, deadline_time[id], timer_read())) {
+        deadline_callback[id] = callback;
+        return;
+    }
+    deadline_set(id, time, callback);
+}
+
+void deadline_clear(deadline_id_t id) {
+    if (!(deadline_mask & DEADLINE_BIT(id))) {
+        return;
+    }
+    deadline_mask &= ~DEADLINE_BIT(id);
+    if (deadline_time[id] == deadline_earliest) {
+        deadline_update(timer_read());
+    }
+}
+
+bool deadline_pending(deadline_id_t id) {
+    return deadline_mask & DEADLINE_BIT(id);
+}
+
+void deadline_task(void) {
+    if (!deadline_mask) {
+        return;
+    }
+    uint16_t now = timer_read();
+    if ((int16_t)(now - deadline_earliest) < 0) {
+        return;
+    }
+    for (uint8_t i = 0; i < DEADLINE_COUNT; i++) {
+        if ((deadline_mask & DEADLINE_BIT(i)) && (int16_t)(now - deadline_time[i]) >= 0) {
+            deadline_mask &= ~DEADLINE_BIT(i);
+            if (deadline_callback[i]) {
+                deadline_callback[i]();
+            }
+        }
+    }
+    deadline_update(now);
+}
+
+bool deadline_next(uint16_t *remaining) {
+    if (!deadline_mask) {
+        return false;
+    }
+    int16_t left = deadline_earliest - timer_read();
+    *remaining = left > 0 ? left : 0;
+    return true;
+}
@@ -0,0 +1,77 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Deadline scheduler
+ *
+ * Features that have to act once some time has passed register a deadline
+ * in timer_read() milliseconds instead of looking at their timers on every
+ * scan. deadline_task() compares the clock against the earliest deadline
+ * only, and calls the callbacks of the ones that are due. Every feature has
+ * a single slot, so a feature that waits for several things registers the
+ * earliest of them and registers the next one from its callback.
+ *
+ * A deadline has to lie less than 32 seconds in the future. A callback is
+ * called once per deadline_set(), and may set the deadline again. Without a
+ * callback a deadline only keeps deadline_next() from sleeping through it,
+ * for the features that still run from the tick events.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    DEADLINE_TAPPING,           // the tapping key turns into a hold
+    DEADLINE_ONESHOT_MODS,      // ONESHOT_TIMEOUT of the oneshot mods
+    DEADLINE_ONESHOT_LAYER,     // ONESHOT_TIMEOUT of the oneshot layer
+    DEADLINE_COMBO,             // COMBO_TERM of the earliest started combo
+    DEADLINE_TAP_DANCE,         // the tapping term of the earliest dance
+    DEADLINE_LEADER,            // LEADER_TIMEOUT
+    DEADLINE_USER,              // free for the keyboard or the keymap
+    DEADLINE_COUNT
+} deadline_id_t;
+
+typedef void (*deadline_callback_t)(void);
+
+void deadline_set(deadline_id_t id, uint16_t time, deadline_callback_t callback);
+/* like deadline_set(), unless the pending deadline of 'id' comes first */
+void deadline_set_earliest(deadline_id_t id, uint16_t time, deadline_callback_t callback);
+void deadline_clear(deadline_id_t id);
+bool deadline_pending(deadline_id_t id);
+
+/* calls the callbacks of the deadlines that are due */
+void deadline_task(void);
+
+/*
+ * The number of milliseconds until the next deadline, 0 if one is already
+ * due, for a main loop that wants to sleep in between. Returns false when
+ * there is nothing to wait for. The main loop of keyboard_task() scans the
+ * matrix on every pass and doesn't sleep, this is for one that waits for a
+ * key press, e.g. on a pin change interrupt.
+ */
+bool deadline_next(uint16_t *remaining);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "keycode.h"
 #include "host.h"
 #include "util.h"
+#include "profile.h"
 #include "debug.h"
 
 static host_driver_t *driver;
@@ -46,7 +47,9 @@ uint8_t host_keyboard_leds(void)
 void host_keyboard_send(report_keyboard_t *report)
 {
     if (!driver) return;
+    PROFILE_BEGIN(PROFILE_SEND_REPORT);
     (*driver->send_keyboard)(report);
+    PROFILE_END(PROFILE_SEND_REPORT);
 
     if (debug_keyboard) {
         dprint("keyboard_report: ");
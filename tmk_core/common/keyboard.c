@@ -31,6 +31,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "eeconfig.h"
 #include "backlight.h"
 #include "action_layer.h"
+#include "profile.h"
+#include "output_queue.h"
 #ifdef BOOTMAGIC_ENABLE
 #   include "bootmagic.h"
 #else
@@ -158,6 +160,20 @@ void keyboard_init(void) {
 #endif
 }
 
+#if QMK_KEYS_PER_SCAN
+/* index of the lowest set bit, rows are walked from column 0 upwards */
+static inline uint8_t matrix_row_first_col(matrix_row_t bits)
+{
+#if (MATRIX_COLS <= 8)
+    return biton(bits & -bits);
+#elif (MATRIX_COLS <= 16)
+    return biton16(bits & -bits);
+#else
+    return biton32(bits & -bits);
+#endif
+}
+#endif
+
 /*
  * Do keyboard routine jobs: scan mantrix, light LEDs, ...
  * This is repeatedly called as fast as possible.
@@ -171,9 +187,21 @@ void keyboard_task(void)
     static uint8_t led_status = 0;
     matrix_row_t matrix_row = 0;
     matrix_row_t matrix_change = 0;
+#if QMK_KEYS_PER_SCAN
+    uint8_t keys_processed = 0;
+    uint16_t scan_time;
+#endif
+
+    PROFILE_BEGIN(PROFILE_KEYBOARD_TASK);
 
+    PROFILE_BEGIN(PROFILE_MATRIX_SCAN);
     matrix_scan();
+    PROFILE_END(PROFILE_MATRIX_SCAN);
     if (is_keyboard_master()) {
+#if QMK_KEYS_PER_SCAN
+        // all events of one scan share the same timestamp (time should not be 0)
+        scan_time = timer_read() | 1;
+#endif
         for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
             matrix_row = matrix_get_row(r);
             matrix_change = matrix_row ^ matrix_prev[r];
@@ -194,27 +222,61 @@ void keyboard_task(void)
 
 #endif
                 if (debug_matrix) matrix_print();
+#if QMK_KEYS_PER_SCAN
+                // walk only the changed bits of the row, lowest column first
+                while (matrix_change) {
+                    uint8_t c = matrix_row_first_col(matrix_change);
+                    matrix_row_t mask = (matrix_row_t)1<<c;
+                    matrix_change &= ~mask;
+                    PROFILE_BEGIN(PROFILE_ACTION_EXEC);
+                    action_exec((keyevent_t){
+                        .key = (keypos_t){ .row = r, .col = c },
+                        .pressed = (matrix_row & mask),
+                        .time = scan_time
+                    });
+                    PROFILE_END(PROFILE_ACTION_EXEC);
+                    // record a processed key
+                    matrix_prev[r] ^= mask;
+                    // leave the rest for the next scan once the budget is used up
+                    if (++keys_processed >= QMK_KEYS_PER_SCAN)
+                        goto MATRIX_LOOP_END;
+                }
+#else
                 for (uint8_t c = 0; c < MATRIX_COLS; c++) {
                     if (matrix_change & ((matrix_row_t)1<<c)) {
+                        PROFILE_BEGIN(PROFILE_ACTION_EXEC);
                         action_exec((keyevent_t){
                             .key = (keypos_t){ .row = r, .col = c },
                             .pressed = (matrix_row & ((matrix_row_t)1<<c)),
                             .time = (timer_read() | 1) /* time should not be 0 */
                         });
+                        PROFILE_END(PROFILE_ACTION_EXEC);
                         // record a processed key
                         matrix_prev[r] ^= ((matrix_row_t)1<<c);
                         // process a key per task call
                         goto MATRIX_LOOP_END;
                     }
                 }
+#endif
             }
         }
     }
+#if QMK_KEYS_PER_SCAN
+    // only send a tick when no real key event was processed
+    if (!keys_processed)
+#endif
     // call with pseudo tick event when no real key event.
     action_exec(TICK);
 
 MATRIX_LOOP_END:
 
+    // one report of queued output per interval
+    output_queue_task();
+
+#ifdef STENO_ENABLE
+    steno_task();
+#endif
+
 #ifdef MOUSEKEY_ENABLE
     // mousekey repeat & acceleration
     mousekey_task();
@@ -233,11 +295,15 @@ MATRIX_LOOP_END:
 #endif
 
 #ifdef SERIAL_LINK_ENABLE
+    PROFILE_BEGIN(PROFILE_SERIAL_LINK);
 	serial_link_update();
+    PROFILE_END(PROFILE_SERIAL_LINK);
 #endif
 
 #ifdef VISUALIZER_ENABLE
+    PROFILE_BEGIN(PROFILE_VISUALIZER);
     visualizer_update(default_layer_state, layer_state, visualizer_get_mods(), host_keyboard_leds());
+    PROFILE_END(PROFILE_VISUALIZER);
 #endif
 
     // update LED
@@ -245,6 +311,8 @@ MATRIX_LOOP_END:
         led_status = host_keyboard_leds();
         keyboard_set_leds(led_status);
     }
+
+    PROFILE_END(PROFILE_KEYBOARD_TASK);
 }
 
 void keyboard_set_leds(uint8_t leds)
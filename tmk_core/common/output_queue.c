@@ -0,0 +1,276 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "output_queue.h"
+#include "action.h"
+#include "action_util.h"
+#include "command.h"
+#include "keycode.h"
+#include "timer.h"
+#include "wait.h"
+
+/* the most keys a single report presses or releases */
+#define OUTPUT_STEP_KEYS 6
+
+typedef struct {
+    uint8_t op;
+    uint8_t code;
+} output_entry_t;
+
+/* output_count is a uint8_t */
+typedef char output_queue_size_fits[OUTPUT_QUEUE_SIZE <= 255 ? 1 : -1];
+
+static output_entry_t output_entries[OUTPUT_QUEUE_SIZE];
+static uint8_t output_head;
+static uint8_t output_count;
+
+static uint8_t output_depth;
+static bool output_draining;
+static uint8_t output_key_mods;
+
+/* the time of the last report and how long the next one has to wait */
+static uint16_t output_last_step;
+static uint16_t output_gap;
+
+#define OUTPUT_HEAD() (&output_entries[output_head])
+
+static void output_pop(void) {
+    output_head = (output_head + 1) % OUTPUT_QUEUE_SIZE;
+    output_count--;
+}
+
+/* whether the change can share a report with the others */
+static bool output_is_plain(const output_entry_t *entry) {
+    switch (entry->op) {
+        case OUTPUT_KEY_DOWN:
+        case OUTPUT_KEY_UP:
+#ifdef LOCKING_SUPPORT_ENABLE
+            if (KC_LOCKING_CAPS <= entry->code && entry->code <= KC_LOCKING_SCROLL) {
+                return false;
+            }
+#endif
+            return IS_KEY(entry->code) || IS_MOD(entry->code);
+        case OUTPUT_DELAY:
+            return false;
+        default:
+            return true;
+    }
+}
+
+static uint8_t output_mods_of(const output_entry_t *entry) {
+    switch (entry->op) {
+        case OUTPUT_KEY_DOWN:
+        case OUTPUT_KEY_UP:
+            return IS_MOD(entry->code) ? MOD_BIT(entry->code) : 0;
+        default:
+            return entry->code;
+    }
+}
+
+static void output_apply(const output_entry_t *entry) {
+    switch (entry->op) {
+        case OUTPUT_KEY_DOWN:
+            if (IS_MOD(entry->code)) {
+                add_mods(MOD_BIT(entry->code));
+            } else if (!command_proc(entry->code)) {
+                add_key(entry->code);
+            }
+            break;
+        case OUTPUT_KEY_UP:
+            if (IS_MOD(entry->code)) {
+                del_mods(MOD_BIT(entry->code));
+            } else {
+                del_key(entry->code);
+            }
+            break;
+        case OUTPUT_MODS_DOWN:
+            add_mods(entry->code);
+            break;
+        case OUTPUT_MODS_UP:
+            del_mods(entry->code);
+            break;
+        case OUTPUT_MACRO_MODS_DOWN:
+            add_macro_mods(entry->code);
+            break;
+        case OUTPUT_MACRO_MODS_UP:
+            del_macro_mods(entry->code);
+            break;
+        case OUTPUT_KEY_MODS_DOWN:
+            output_key_mods |= entry->code;
+            break;
+        case OUTPUT_KEY_MODS_UP:
+            output_key_mods &= ~entry->code;
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Sends the next report. It takes the queued changes up to the first one
+ * that touches a key or a mod again, which the host would miss otherwise.
+ * Delays that follow are added to the wait for the report after it.
+ */
+static void output_step(void) {
+    uint8_t keys[OUTPUT_STEP_KEYS];
+    uint8_t key_count = 0;
+    uint8_t mods = 0;
+    bool sent = false;
+
+    output_draining = true;
+    if (output_count && OUTPUT_HEAD()->op != OUTPUT_DELAY && !output_is_plain(OUTPUT_HEAD())) {
+        // locking, system and consumer keys send what they need themselves
+        if (OUTPUT_HEAD()->op == OUTPUT_KEY_DOWN) {
+            register_code(OUTPUT_HEAD()->code);
+        } else {
+            unregister_code(OUTPUT_HEAD()->code);
+        }
+        output_pop();
+        sent = true;
+    } else {
+        while (output_count && output_is_plain(OUTPUT_HEAD())) {
+            const output_entry_t *entry = OUTPUT_HEAD();
+            uint8_t entry_mods = output_mods_of(entry);
+            if (entry_mods) {
+                if (mods & entry_mods) {
+                    break;
+                }
+                mods |= entry_mods;
+            } else {
+                uint8_t i = 0;
+                while (i < key_count && keys[i] != entry->code) {
+                    i++;
+                }
+                if (i < key_count || key_count == OUTPUT_STEP_KEYS) {
+                    break;
+                }
+                keys[key_count++] = entry->code;
+            }
+            output_apply(entry);
+            output_pop();
+            sent = true;
+        }
+        if (sent) {
+            send_keyboard_report();
+        }
+    }
+    output_draining = false;
+
+    output_gap = sent ? OUTPUT_QUEUE_INTERVAL : 0;
+    while (output_count && OUTPUT_HEAD()->op == OUTPUT_DELAY) {
+        output_gap += OUTPUT_HEAD()->code;
+        output_pop();
+    }
+    output_last_step = timer_read();
+}
+
+static void output_wait_step(void) {
+    uint16_t elapsed = timer_elapsed(output_last_step);
+    while (elapsed < output_gap) {
+        wait_ms(1);
+        elapsed++;
+    }
+    output_step();
+}
+
+void output_queue_begin(void) {
+    output_depth++;
+}
+
+void output_queue_end(void) {
+    if (output_depth) {
+        output_depth--;
+    }
+}
+
+static void output_push(output_op_t op, uint8_t code) {
+    while (output_count == OUTPUT_QUEUE_SIZE) {
+        output_wait_step();
+    }
+    output_entry_t *entry = &output_entries[(output_head + output_count) % OUTPUT_QUEUE_SIZE];
+    entry->op = op;
+    entry->code = code;
+    output_count++;
+}
+
+/*
+ * The weak and one-shot mods that a key pressed meanwhile would have been
+ * sent with. The one-shot mods are used up by it, like they are when the
+ * key is sent right away.
+ */
+static uint8_t output_take_key_mods(void) {
+    uint8_t mods = get_weak_mods();
+#ifndef NO_ACTION_ONESHOT
+    if (get_oneshot_mods()) {
+        if (!has_oneshot_mods_timed_out()) {
+            mods |= get_oneshot_mods();
+        }
+        clear_oneshot_mods();
+    }
+#endif
+    return mods;
+}
+
+bool output_queue_defer(output_op_t op, uint8_t code) {
+    if (output_draining || (!output_depth && !output_count)) {
+        return false;
+    }
+    uint8_t mods = 0;
+    if (op == OUTPUT_KEY_DOWN && !output_depth && IS_KEY(code)) {
+        mods = output_take_key_mods();
+    }
+    // the mods go up right after the key, so that they shift nothing else
+    if (mods) {
+        output_push(OUTPUT_KEY_MODS_DOWN, mods);
+    }
+    output_push(op, code);
+    if (mods) {
+        output_push(OUTPUT_KEY_MODS_UP, mods);
+    }
+    return true;
+}
+
+void output_queue_delay(uint8_t ms) {
+    if (ms && !output_queue_defer(OUTPUT_DELAY, ms)) {
+        while (ms--) {
+            wait_ms(1);
+        }
+    }
+}
+
+bool output_queue_busy(void) {
+    return output_count || output_draining;
+}
+
+uint8_t output_queue_mods(void) {
+    return output_key_mods;
+}
+
+void output_queue_task(void) {
+    if (output_count && timer_elapsed(output_last_step) >= output_gap) {
+        output_step();
+    }
+}
+
+void output_queue_flush(void) {
+    while (output_count) {
+        output_wait_step();
+    }
+}
+
+void output_queue_clear(void) {
+    output_head = 0;
+    output_count = 0;
+    output_key_mods = 0;
+}
@@ -0,0 +1,100 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OUTPUT_QUEUE_H
+#define OUTPUT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Output queue
+ *
+ * Generated output, like send_string(), macros and unicode input, is queued
+ * instead of being sent while the caller waits. Between output_queue_begin()
+ * and output_queue_end(), register_code(), unregister_code(),
+ * register_mods() and unregister_mods() queue their changes, and
+ * output_queue_delay() queues a pause instead of waiting.
+ *
+ * output_queue_task() runs from keyboard_task() and sends one report per
+ * OUTPUT_QUEUE_INTERVAL, so the matrix keeps being scanned meanwhile. A
+ * report carries as many of the queued changes as it can without the host
+ * missing one of them, e.g. a shift and the key it shifts.
+ *
+ * As long as anything is queued, the functions above queue their changes
+ * outside of output_queue_begin() too, so that keys that are pressed
+ * meanwhile reach the host after the output. Such a key takes the weak mods
+ * and pending one-shot mods along into the queue, e.g. the shift of
+ * LSFT(KC_1), and they are sent with that key only. Changes made to the
+ * report directly, with add_key() and send_keyboard_report(), are not
+ * ordered.
+ */
+
+/* in queued changes, at most 255; output that does not fit waits for room */
+#ifndef OUTPUT_QUEUE_SIZE
+#define OUTPUT_QUEUE_SIZE 64
+#endif
+
+/* the boot keyboard endpoint is polled every 10 ms */
+#ifndef OUTPUT_QUEUE_INTERVAL
+#define OUTPUT_QUEUE_INTERVAL 10
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    OUTPUT_KEY_DOWN,            // register_code()
+    OUTPUT_KEY_UP,              // unregister_code()
+    OUTPUT_MODS_DOWN,           // register_mods()
+    OUTPUT_MODS_UP,             // unregister_mods()
+    OUTPUT_MACRO_MODS_DOWN,     // add_macro_mods(), by action_macro_play()
+    OUTPUT_MACRO_MODS_UP,       // del_macro_mods()
+    OUTPUT_DELAY,               // output_queue_delay(), in ms
+    OUTPUT_KEY_MODS_DOWN,       // the weak and one-shot mods of a key pressed meanwhile
+    OUTPUT_KEY_MODS_UP,
+} output_op_t;
+
+void output_queue_begin(void);
+void output_queue_end(void);
+
+/*
+ * Queues the change and returns true if it has to wait for the queue. Used
+ * by the functions that change the report, which otherwise go ahead.
+ */
+bool output_queue_defer(output_op_t op, uint8_t code);
+
+/* queues a pause of 'ms' between the reports, or waits if nothing is queued */
+void output_queue_delay(uint8_t ms);
+
+/* whether anything is waiting to be sent, or being sent */
+bool output_queue_busy(void);
+
+/* the weak and one-shot mods that go with the queued key being sent */
+uint8_t output_queue_mods(void);
+
+void output_queue_task(void);
+
+/* sends everything that is queued, waiting in between */
+void output_queue_flush(void);
+
+/* drops everything that is queued */
+void output_queue_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
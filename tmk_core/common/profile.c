@@ -0,0 +1,216 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "profile.h"
+#include "print.h"
+#ifdef RAW_ENABLE
+#   include "raw_hid.h"
+#endif
+
+#if defined(__AVR__)
+#   include <avr/io.h>
+#   include <util/atomic.h>
+#   include "avr/timer_avr.h"
+#elif defined(PROTOCOL_CHIBIOS)
+#   include "ch.h"
+#else
+#   include <time.h>
+#endif
+
+static profile_stats_t profile_stats[PROFILE_STAGE_COUNT];
+
+#ifndef NO_PRINT
+static const char *profile_stage_names[PROFILE_STAGE_COUNT] = {
+    [PROFILE_KEYBOARD_TASK] = "keyboard_task",
+    [PROFILE_MATRIX_SCAN] = "matrix_scan",
+    [PROFILE_ACTION_EXEC] = "action_exec",
+    [PROFILE_PROCESS_RECORD] = "process_record",
+    [PROFILE_SEND_REPORT] = "send_report",
+    [PROFILE_SERIAL_LINK] = "serial_link",
+    [PROFILE_VISUALIZER] = "visualizer",
+};
+#endif
+
+#if defined(__AVR__)
+
+extern volatile uint32_t timer_count;
+
+/* the millisecond count of the timer plus the fraction still in TCNT0 */
+__attribute__ ((weak))
+uint32_t profile_read_clock(void) {
+    uint32_t ms;
+    uint8_t raw;
+    uint8_t overflow;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = timer_count;
+        raw = TIMER_RAW;
+#ifndef __AVR_ATmega32A__
+        overflow = TIFR0 & (1 << OCF0A);
+#else
+        overflow = TIFR & (1 << OCF0);
+#endif
+    }
+    // the compare match interrupt is pending, so the counter has already restarted
+    if (overflow && raw < TIMER_RAW_TOP / 2) {
+        ms++;
+    }
+    // in 32 bits, raw * 1000 overflows the 16 bit int of AVR
+    return ms * 1000 + (uint32_t)raw * 1000 / (TIMER_RAW_TOP + 1);
+}
+
+#   define PROFILE_TICKS_TO_US(ticks) (ticks)
+
+#elif defined(PROTOCOL_CHIBIOS)
+
+#   if PORT_SUPPORTS_RT && defined(STM32_SYSCLK)
+/* the cycle counter of the core */
+__attribute__ ((weak))
+uint32_t profile_read_clock(void) {
+    return chSysGetRealtimeCounterX();
+}
+
+#       define PROFILE_TICKS_TO_US(ticks) ((ticks) / (STM32_SYSCLK / 1000000))
+#   else
+__attribute__ ((weak))
+uint32_t profile_read_clock(void) {
+    return chVTGetSystemTimeX();
+}
+
+#       define PROFILE_TICKS_TO_US(ticks) ST2US(ticks)
+#   endif
+
+#else
+
+/* the host clock, so that benchmarks of the native build are meaningful */
+__attribute__ ((weak))
+uint32_t profile_read_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#   define PROFILE_TICKS_TO_US(ticks) (ticks)
+
+#endif
+
+/* 'elapsed' is in ticks of profile_read_clock() */
+void profile_record(profile_stage_t stage, uint32_t elapsed) {
+    profile_stats_t *stats = &profile_stats[stage];
+    uint32_t us = PROFILE_TICKS_TO_US(elapsed);
+
+    if (stats->count == 0 || us < stats->min) {
+        stats->min = us;
+    }
+    if (us > stats->max) {
+        stats->max = us;
+    }
+    stats->count++;
+    stats->total += us;
+
+    uint8_t bucket = 0;
+    uint32_t limit = PROFILE_HISTOGRAM_BASE;
+    while (bucket < PROFILE_HISTOGRAM_BUCKETS - 1 && us >= limit) {
+        bucket++;
+        limit <<= 1;
+    }
+    if (stats->histogram[bucket] != UINT16_MAX) {
+        stats->histogram[bucket]++;
+    }
+}
+
+const profile_stats_t *profile_get_stats(profile_stage_t stage) {
+    return &profile_stats[stage];
+}
+
+void profile_reset(void) {
+    memset(profile_stats, 0, sizeof(profile_stats));
+}
+
+void profile_print(void) {
+    print("\n\t- Profile (us) -\n");
+    for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; i++) {
+        const profile_stats_t *stats = &profile_stats[i];
+        if (stats->count == 0) {
+            continue;
+        }
+        xprintf("%s: n=%lu min=%lu avg=%lu max=%lu |", profile_stage_names[i],
+            (unsigned long)stats->count, (unsigned long)stats->min,
+            (unsigned long)(stats->total / stats->count), (unsigned long)stats->max);
+        for (uint8_t j = 0; j < PROFILE_HISTOGRAM_BUCKETS; j++) {
+            xprintf(" %u", stats->histogram[j]);
+        }
+        print("\n");
+    }
+}
+
+static uint8_t profile_pack32(uint8_t *data, uint32_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+    return 4;
+}
+
+uint8_t profile_pack(profile_stage_t stage, uint8_t *data, uint8_t length) {
+    const uint8_t header = 2 + 4 * 4;
+    if (stage >= PROFILE_STAGE_COUNT || length < header + 2) {
+        return 0;
+    }
+    const profile_stats_t *stats = &profile_stats[stage];
+    // the buckets that do not fit are added to the last one
+    uint8_t buckets = (length - header) / 2;
+    if (buckets > PROFILE_HISTOGRAM_BUCKETS) {
+        buckets = PROFILE_HISTOGRAM_BUCKETS;
+    }
+    uint8_t *p = data;
+    *p++ = stage;
+    *p++ = buckets;
+    p += profile_pack32(p, stats->count);
+    p += profile_pack32(p, stats->total);
+    p += profile_pack32(p, stats->min);
+    p += profile_pack32(p, stats->max);
+    for (uint8_t i = 0; i < buckets; i++) {
+        uint32_t count = stats->histogram[i];
+        if (i == buckets - 1) {
+            for (uint8_t j = buckets; j < PROFILE_HISTOGRAM_BUCKETS; j++) {
+                count += stats->histogram[j];
+            }
+            if (count > UINT16_MAX) {
+                count = UINT16_MAX;
+            }
+        }
+        *p++ = count;
+        *p++ = count >> 8;
+    }
+    return p - data;
+}
+
+#ifdef RAW_ENABLE
+bool profile_raw_hid_receive(uint8_t *data, uint8_t length) {
+    if (length < 2 || data[0] != PROFILE_RAW_HID_ID) {
+        return false;
+    }
+    uint8_t packed = 0;
+    if (data[1] == PROFILE_RAW_HID_RESET) {
+        profile_reset();
+    } else {
+        packed = profile_pack(data[1], data + 1, length - 1);
+    }
+    memset(data + 1 + packed, 0, length - 1 - packed);
+    raw_hid_send(data, length);
+    return true;
+}
+#endif
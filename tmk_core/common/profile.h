@@ -0,0 +1,112 @@
+/*
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Scan loop profiler (PROFILE_ENABLE = yes)
+ *
+ * Every stage of keyboard_task() is timed in microseconds and accumulated
+ * into count/min/max/total and a histogram with power of two buckets:
+ * bucket 0 counts everything below PROFILE_HISTOGRAM_BASE us, bucket n
+ * everything below PROFILE_HISTOGRAM_BASE << n us, and the last bucket
+ * everything that is slower.
+ */
+
+#ifndef PROFILE_HISTOGRAM_BUCKETS
+#   define PROFILE_HISTOGRAM_BUCKETS 8
+#endif
+
+#ifndef PROFILE_HISTOGRAM_BASE
+#   define PROFILE_HISTOGRAM_BASE 16
+#endif
+
+/*
+ * With RAW_ENABLE, a raw HID report from the host that starts with
+ * PROFILE_RAW_HID_ID asks for the statistics of the stage in its second
+ * byte, or resets them all if that is PROFILE_RAW_HID_RESET. The reply is
+ * PROFILE_RAW_HID_ID followed by profile_pack() of the stage, zero padded.
+ */
+#ifndef PROFILE_RAW_HID_ID
+#   define PROFILE_RAW_HID_ID 0xFE
+#endif
+
+#define PROFILE_RAW_HID_RESET 0xFF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    PROFILE_KEYBOARD_TASK,      // one whole keyboard_task()
+    PROFILE_MATRIX_SCAN,        // matrix_scan()
+    PROFILE_ACTION_EXEC,        // action_exec() of a key event
+    PROFILE_PROCESS_RECORD,     // process_record_quantum() chain
+    PROFILE_SEND_REPORT,        // host_keyboard_send()
+    PROFILE_SERIAL_LINK,        // serial_link_update()
+    PROFILE_VISUALIZER,         // visualizer_update()
+    PROFILE_STAGE_COUNT
+} profile_stage_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+    uint16_t histogram[PROFILE_HISTOGRAM_BUCKETS];
+} profile_stats_t;
+
+#ifdef PROFILE_ENABLE
+
+/* free running microsecond clock, overflows after about 71 minutes */
+uint32_t profile_read_clock(void);
+
+void profile_record(profile_stage_t stage, uint32_t elapsed);
+const profile_stats_t *profile_get_stats(profile_stage_t stage);
+void profile_reset(void);
+void profile_print(void);
+
+/*
+ * Serializes the statistics of one stage little endian into 'data' for
+ * sending over raw HID: stage, number of buckets, count, total, min, max
+ * and the histogram. Buckets that do not fit into 'length' are added to
+ * the last one that does. Returns the number of bytes written.
+ */
+uint8_t profile_pack(profile_stage_t stage, uint8_t *data, uint8_t length);
+
+#ifdef RAW_ENABLE
+/* answers a profiler request from the host, returns false for other reports */
+bool profile_raw_hid_receive(uint8_t *data, uint8_t length);
+#endif
+
+#   define PROFILE_BEGIN(stage) uint32_t profile_start_##stage = profile_read_clock()
+#   define PROFILE_END(stage) profile_record(stage, profile_read_clock() - profile_start_##stage)
+
+#else
+
+#   define PROFILE_BEGIN(stage)
+#   define PROFILE_END(stage)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
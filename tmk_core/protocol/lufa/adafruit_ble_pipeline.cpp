@@ -0,0 +1,369 @@
+#include "adafruit_ble_pipeline.h"
+#include "debug.h"
+#include "progmem.h"
+#include "timer.h"
+#include "wait.h"
+#include "ringbuffer.hpp"
+#ifdef MOUSE_ENABLE
+#include "report.h"
+#endif
+
+// The recv latency is relatively high, so when we're hammering keys quickly,
+// we want to avoid waiting for the responses in the matrix loop.  We maintain
+// a short queue for that.  Since there is quite a lot of space overhead for
+// the AT command representation wrapped up in SDEP, we queue the minimal
+// information here.
+
+enum queue_type {
+  QTKeyReport, // 1-byte modifier + 6-byte key report
+  QTConsumer,  // 16-bit key code
+#ifdef MOUSE_ENABLE
+  QTMouseMove, // 4-byte mouse report
+#endif
+};
+
+struct queue_item {
+  enum queue_type queue_type;
+  uint16_t added;
+  union __attribute__((packed)) {
+    struct ble_key_report key;
+
+    uint16_t consumer;
+    struct __attribute__((packed)) {
+      int8_t x, y, scroll, pan;
+      uint8_t buttons;
+    } mousemove;
+  };
+};
+
+// Items that we wish to send
+static RingBuffer<queue_item, 40> send_buf;
+// The times at which we sent the commands whose responses we are still
+// expecting, oldest first.
+static RingBuffer<uint16_t, AdafruitBleMaxPending + 1> resp_buf;
+
+// The keys that the host sees once everything queued has been sent, and
+// the ones it sees before the last queued key report
+static struct ble_key_report keys_queued;
+static struct ble_key_report keys_before_tail;
+
+bool sdep_send_command(const char *cmd, uint16_t len, uint16_t timeout) {
+  struct sdep_msg msg;
+
+  while (len > SdepMaxPayload) {
+    sdep_build_pkt(&msg, BleAtWrapper, (const uint8_t *)cmd, SdepMaxPayload,
+                   true);
+    if (!sdep_send_pkt(&msg, timeout)) {
+      return false;
+    }
+    cmd += SdepMaxPayload;
+    len -= SdepMaxPayload;
+  }
+
+  sdep_build_pkt(&msg, BleAtWrapper, (const uint8_t *)cmd, len, false);
+  return sdep_send_pkt(&msg, timeout);
+}
+
+void ble_pipeline_read_responses(bool greedy) {
+  uint16_t last_send;
+  if (!resp_buf.peek(last_send)) {
+    return;
+  }
+
+  if (sdep_recv_ready()) {
+    struct sdep_msg msg;
+
+again:
+    if (sdep_recv_pkt(&msg, SdepTimeout)) {
+      if (!msg.more) {
+        // We got it; consume this entry
+        resp_buf.get(last_send);
+        dprintf("recv latency %dms\n", TIMER_DIFF_16(timer_read(), last_send));
+      }
+
+      if (greedy && resp_buf.peek(last_send) && sdep_recv_ready()) {
+        goto again;
+      }
+    }
+
+  } else if (timer_elapsed(last_send) > SdepTimeout * 2) {
+    dprintf("waiting_for_result: timeout, resp_buf size %d\n",
+            (int)resp_buf.size());
+
+    // Timed out: consume this entry
+    resp_buf.get(last_send);
+  }
+}
+
+void ble_pipeline_expect_response(void) {
+  auto now = timer_read();
+  while (resp_buf.size() >= AdafruitBleMaxPending || !resp_buf.enqueue(now)) {
+    ble_pipeline_read_responses(false);
+  }
+  auto later = timer_read();
+  if (TIMER_DIFF_16(later, now) > 0) {
+    dprintf("waited %dms for resp_buf\n", TIMER_DIFF_16(later, now));
+  }
+}
+
+void ble_pipeline_wait(const char *cmd) {
+  bool didPrint = false;
+  while (!resp_buf.empty()) {
+    if (!didPrint) {
+      dprintf("wait on buf for %s\n", cmd);
+      didPrint = true;
+    }
+    ble_pipeline_read_responses(true);
+  }
+}
+
+bool ble_pipeline_idle(void) {
+  return resp_buf.empty();
+}
+
+static const char hex_digits[16] = {
+  '0', '1', '2', '3', '4', '5', '6', '7',
+  '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+};
+
+static inline char *put_hex8(char *p, uint8_t value) {
+  p[0] = hex_digits[value >> 4];
+  p[1] = hex_digits[value & 0xf];
+  return p + 2;
+}
+
+static char *put_P(char *p, const char *str) {
+  char c;
+  while ((c = pgm_read_byte(str++))) {
+    *p++ = c;
+  }
+  return p;
+}
+
+uint8_t ble_encode_keys(char *cmd, const struct ble_key_report *report) {
+  static const char kKeyboardCode[] PROGMEM = "AT+BLEKEYBOARDCODE=";
+  char *p = put_P(cmd, kKeyboardCode);
+  p = put_hex8(p, report->modifier);
+  *p++ = '-';
+  *p++ = '0';
+  *p++ = '0';
+  for (uint8_t i = 0; i < 6; i++) {
+    *p++ = '-';
+    p = put_hex8(p, report->keys[i]);
+  }
+  return p - cmd;
+}
+
+static uint8_t encode_consumer(char *cmd, uint16_t keycode) {
+  static const char kControlKey[] PROGMEM = "AT+BLEHIDCONTROLKEY=0x";
+  char *p = put_P(cmd, kControlKey);
+  p = put_hex8(p, keycode >> 8);
+  p = put_hex8(p, keycode & 0xff);
+  return p - cmd;
+}
+
+#ifdef MOUSE_ENABLE
+static char *put_dec8(char *p, int8_t value) {
+  uint8_t magnitude = value;
+  if (value < 0) {
+    *p++ = '-';
+    magnitude = -value;
+  }
+  if (magnitude >= 100) {
+    *p++ = '0' + magnitude / 100;
+  }
+  if (magnitude >= 10) {
+    *p++ = '0' + magnitude / 10 % 10;
+  }
+  *p++ = '0' + magnitude % 10;
+  return p;
+}
+
+static uint8_t encode_mouse_move(char *cmd, const struct queue_item *item) {
+  static const char kMouseMove[] PROGMEM = "AT+BLEHIDMOUSEMOVE=";
+  char *p = put_P(cmd, kMouseMove);
+  p = put_dec8(p, item->mousemove.x);
+  *p++ = ',';
+  p = put_dec8(p, item->mousemove.y);
+  *p++ = ',';
+  p = put_dec8(p, item->mousemove.scroll);
+  *p++ = ',';
+  p = put_dec8(p, item->mousemove.pan);
+  return p - cmd;
+}
+
+static uint8_t encode_mouse_buttons(char *cmd, uint8_t buttons) {
+  static const char kMouseButton[] PROGMEM = "AT+BLEHIDMOUSEBUTTON=";
+  char *p = put_P(cmd, kMouseButton);
+  if (buttons & MOUSE_BTN1) {
+    *p++ = 'L';
+  }
+  if (buttons & MOUSE_BTN2) {
+    *p++ = 'R';
+  }
+  if (buttons & MOUSE_BTN3) {
+    *p++ = 'M';
+  }
+  if (buttons == 0) {
+    *p++ = '0';
+  }
+  return p - cmd;
+}
+#endif
+
+static bool send_command(const char *cmd, uint8_t len, uint16_t timeout) {
+  if (!sdep_send_command(cmd, len, timeout)) {
+    return false;
+  }
+  ble_pipeline_expect_response();
+  return true;
+}
+
+static bool process_queue_item(struct queue_item *item, uint16_t timeout) {
+  char cmd[BleMaxCommandLength];
+
+#if 1
+  if (TIMER_DIFF_16(timer_read(), item->added) > 0) {
+    dprintf("send latency %dms\n", TIMER_DIFF_16(timer_read(), item->added));
+  }
+#endif
+
+  switch (item->queue_type) {
+    case QTKeyReport:
+      return send_command(cmd, ble_encode_keys(cmd, &item->key), timeout);
+
+    case QTConsumer:
+      return send_command(cmd, encode_consumer(cmd, item->consumer), timeout);
+
+#ifdef MOUSE_ENABLE
+    case QTMouseMove:
+      if (!send_command(cmd, encode_mouse_move(cmd, item), timeout)) {
+        return false;
+      }
+      return send_command(cmd,
+          encode_mouse_buttons(cmd, item->mousemove.buttons), timeout);
+#endif
+    default:
+      return true;
+  }
+}
+
+uint8_t ble_pipeline_send(uint16_t timeout) {
+  struct queue_item item;
+  uint8_t sent = 0;
+
+  while (resp_buf.size() < AdafruitBleMaxPending && send_buf.peek(item)) {
+    if (!process_queue_item(&item, timeout)) {
+      dprint("failed to send, will retry\n");
+      wait_ms(SdepTimeout);
+      ble_pipeline_read_responses(true);
+      break;
+    }
+    // commit that peek
+    send_buf.get(item);
+    sent++;
+  }
+  if (sent) {
+    dprintf("ble_pipeline_send: have %d remaining\n", (int)send_buf.size());
+  }
+  return sent;
+}
+
+static void enqueue(const struct queue_item &item) {
+  bool didWait = false;
+  while (!send_buf.enqueue(item)) {
+    if (!didWait) {
+      dprint("wait for buf space\n");
+      didWait = true;
+    }
+    ble_pipeline_read_responses(false);
+    ble_pipeline_send(SdepTimeout);
+  }
+}
+
+static bool has_key(const struct ble_key_report *report, uint8_t key) {
+  for (uint8_t i = 0; i < 6; i++) {
+    if (report->keys[i] == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether 'next' can be sent instead of 'queued' without the host missing
+// any of the presses and releases between 'before' and 'queued'
+static bool can_coalesce(const struct ble_key_report *before,
+                         const struct ble_key_report *queued,
+                         const struct ble_key_report *next) {
+  uint8_t changed = before->modifier ^ queued->modifier;
+  if ((queued->modifier ^ next->modifier) & changed) {
+    return false;
+  }
+  bool modifier_changes = queued->modifier != next->modifier;
+  for (uint8_t i = 0; i < 6; i++) {
+    // pressed, and released again by 'next', or pressed before the modifiers
+    // change, like "a" and then shift "a"
+    uint8_t key = queued->keys[i];
+    if (key && !has_key(before, key) && (!has_key(next, key) || modifier_changes)) {
+      return false;
+    }
+    // released, and pressed again by 'next'
+    key = before->keys[i];
+    if (key && !has_key(queued, key) && has_key(next, key)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ble_queue_keys(const struct ble_key_report *report) {
+  if (!send_buf.empty() && send_buf.back().queue_type == QTKeyReport &&
+      can_coalesce(&keys_before_tail, &send_buf.back().key, report)) {
+    send_buf.back().key = *report;
+    keys_queued = *report;
+    return true;
+  }
+
+  struct queue_item item;
+  item.queue_type = QTKeyReport;
+  item.key = *report;
+  item.added = timer_read();
+  enqueue(item);
+
+  keys_before_tail = keys_queued;
+  keys_queued = *report;
+  return true;
+}
+
+bool ble_queue_consumer(uint16_t keycode) {
+  struct queue_item item;
+
+  item.queue_type = QTConsumer;
+  item.consumer = keycode;
+  item.added = timer_read();
+
+  enqueue(item);
+  return true;
+}
+
+#ifdef MOUSE_ENABLE
+bool ble_queue_mouse_move(int8_t x, int8_t y, int8_t scroll, int8_t pan,
+                          uint8_t buttons) {
+  struct queue_item item;
+
+  item.queue_type = QTMouseMove;
+  item.mousemove.x = x;
+  item.mousemove.y = y;
+  item.mousemove.scroll = scroll;
+  item.mousemove.pan = pan;
+  item.mousemove.buttons = buttons;
+  item.added = timer_read();
+
+  enqueue(item);
+  return true;
+}
+#endif
+
+uint8_t ble_queue_size(void) {
+  return send_buf.size();
+}
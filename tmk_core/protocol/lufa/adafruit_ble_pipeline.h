@@ -0,0 +1,110 @@
+/* Send pipeline of the Adafruit BLE module.
+ *
+ * Reports are queued, turned into AT commands and sent wrapped up in SDEP
+ * packets. The responses of the module trickle in much later, and the
+ * reports wait in the queue meanwhile instead of the keyboard. A key report
+ * that is still queued when the next one arrives is replaced by it, as long
+ * as the host doesn't miss a press or a release because of that.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// Pending responses; while one is pending, we can't send any more requests.
+// More than one keeps several commands in flight, which the nRF51 hasn't
+// been shown to accept: if it answers SdepSlaveNotReady, the retries make
+// typing slower than waiting would.
+#ifndef AdafruitBleMaxPending
+#define AdafruitBleMaxPending 1
+#endif
+
+// Commands are encoded using SDEP and sent via SPI
+// https://github.com/adafruit/Adafruit_BluefruitLE_nRF51/blob/master/SDEP.md
+
+#define SdepMaxPayload 16
+struct sdep_msg {
+  uint8_t type;
+  uint8_t cmd_low;
+  uint8_t cmd_high;
+  struct __attribute__((packed)) {
+    uint8_t len:7;
+    uint8_t more:1;
+  };
+  uint8_t payload[SdepMaxPayload];
+} __attribute__((packed));
+
+enum sdep_type {
+  SdepCommand = 0x10,
+  SdepResponse = 0x20,
+  SdepAlert = 0x40,
+  SdepError = 0x80,
+  SdepSlaveNotReady = 0xfe, // Try again later
+  SdepSlaveOverflow = 0xff, // You read more data than is available
+};
+
+enum ble_cmd {
+  BleInitialize = 0xbeef,
+  BleAtWrapper = 0x0a00,
+  BleUartTx = 0x0a01,
+  BleUartRx = 0x0a02,
+};
+
+#define SdepTimeout 150 /* milliseconds */
+#define SdepShortTimeout 10 /* milliseconds */
+
+// The longest AT command that the pipeline generates
+#define BleMaxCommandLength 48
+
+struct ble_key_report {
+  uint8_t modifier;
+  uint8_t keys[6];
+};
+
+static inline void sdep_build_pkt(struct sdep_msg *msg, uint16_t command,
+                                  const uint8_t *payload, uint8_t len,
+                                  bool moredata) {
+  msg->type = SdepCommand;
+  msg->cmd_low = command & 0xff;
+  msg->cmd_high = command >> 8;
+  msg->len = len;
+  msg->more = (moredata && len == SdepMaxPayload) ? 1 : 0;
+
+  static_assert(sizeof(*msg) == 20, "msg is correctly packed");
+
+  memcpy(msg->payload, payload, len);
+}
+
+// The SPI side, implemented by adafruit_ble.cpp
+bool sdep_send_pkt(const struct sdep_msg *msg, uint16_t timeout);
+bool sdep_recv_pkt(struct sdep_msg *msg, uint16_t timeout);
+// Whether the module has a packet for us, i.e. the IRQ pin is high
+bool sdep_recv_ready(void);
+
+// Fragments an AT command into SDEP packets and sends them
+bool sdep_send_command(const char *cmd, uint16_t len, uint16_t timeout);
+
+// Records that a response to a command just sent has to be read later on.
+// Reads responses first if AdafruitBleMaxPending are already outstanding.
+void ble_pipeline_expect_response(void);
+// Reads a pending response if the module has one, or all of them if greedy
+void ble_pipeline_read_responses(bool greedy);
+// Reads responses until none are outstanding
+void ble_pipeline_wait(const char *cmd);
+bool ble_pipeline_idle(void);
+// Sends queued reports while there is room for their responses, and
+// returns how many were sent
+uint8_t ble_pipeline_send(uint16_t timeout);
+
+bool ble_queue_keys(const struct ble_key_report *report);
+bool ble_queue_consumer(uint16_t keycode);
+#ifdef MOUSE_ENABLE
+bool ble_queue_mouse_move(int8_t x, int8_t y, int8_t scroll, int8_t pan,
+                          uint8_t buttons);
+#endif
+uint8_t ble_queue_size(void);
+
+// Writes AT+BLEKEYBOARDCODE for the report into 'cmd', which needs room for
+// BleMaxCommandLength characters, and returns the length
+uint8_t ble_encode_keys(char *cmd, const struct ble_key_report *report);
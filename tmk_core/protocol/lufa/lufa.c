@@ -51,6 +51,7 @@
 
 #include "descriptor.h"
 #include "lufa.h"
+#include "report_queue.h"
 #include "quantum.h"
 #include <util/atomic.h>
 #include "outputselect.h"
@@ -88,6 +89,9 @@
 
 #ifdef RAW_ENABLE
 	#include "raw_hid.h"
+	#ifdef PROFILE_ENABLE
+		#include "profile.h"
+	#endif
 #endif
 
 uint8_t keyboard_idle = 0;
@@ -97,6 +101,26 @@ static uint8_t keyboard_led_stats = 0;
 
 static report_keyboard_t keyboard_report_sent;
 
+/* Reports waiting for their IN endpoint */
+REPORT_QUEUE(keyboard_queue, sizeof(report_keyboard_t), REPORT_QUEUE_KEYBOARD_SLOTS, report_merge_same);
+#ifdef MOUSE_ENABLE
+REPORT_QUEUE(mouse_queue, sizeof(report_mouse_t), REPORT_QUEUE_MOUSE_SLOTS, report_merge_mouse);
+#endif
+REPORT_QUEUE(extra_queue, sizeof(report_extra_t), REPORT_QUEUE_EXTRA_SLOTS, report_merge_same);
+/* The endpoint the queued keyboard reports are laid out for */
+static uint8_t keyboard_queue_endpoint = KEYBOARD_IN_EPNUM;
+
+/* The host forgets about the reports it hasn't picked up when the device
+ * is reset or configured again, so they are not sent after that. */
+static void report_queues_clear(void)
+{
+    report_queue_clear(&keyboard_queue);
+#ifdef MOUSE_ENABLE
+    report_queue_clear(&mouse_queue);
+#endif
+    report_queue_clear(&extra_queue);
+}
+
 #ifdef MIDI_ENABLE
 static void usb_send_func(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2);
 static void usb_get_midi(MidiDevice * device);
@@ -254,6 +278,12 @@ static void raw_hid_task(void)
 
 		if ( data_read )
 		{
+#ifdef PROFILE_ENABLE
+			if ( profile_raw_hid_receive( data, sizeof(data) ) )
+			{
+				return;
+			}
+#endif
 			raw_hid_receive( data, sizeof(data) );
 		}
 	}
@@ -356,6 +386,7 @@ void EVENT_USB_Device_Disconnect(void)
 void EVENT_USB_Device_Reset(void)
 {
     print("[R]");
+    report_queues_clear();
 }
 
 void EVENT_USB_Device_Suspend()
@@ -412,6 +443,8 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 {
     bool ConfigSuccess = true;
 
+    report_queues_clear();
+
     /* Setup Keyboard HID Report Endpoints */
     ConfigSuccess &= ENDPOINT_CONFIG(KEYBOARD_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      KEYBOARD_EPSIZE, ENDPOINT_BANK_SINGLE);
@@ -556,6 +589,7 @@ void EVENT_USB_Device_ControlRequest(void)
                     Endpoint_ClearStatusStage();
 
                     keyboard_protocol = (USB_ControlRequest.wValue & 0xFF);
+                    report_queue_clear(&keyboard_queue);
                     clear_keyboard();
                 }
             }
@@ -597,9 +631,74 @@ static uint8_t keyboard_leds(void)
     return keyboard_led_stats;
 }
 
+/* Select the Keyboard Report Endpoint */
+static inline uint8_t keyboard_endpoint(void)
+{
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro)
+        return NKRO_IN_EPNUM;
+#endif
+    return KEYBOARD_IN_EPNUM;
+}
+
+static inline uint8_t keyboard_length(void)
+{
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro)
+        return NKRO_EPSIZE;
+#endif
+    return KEYBOARD_EPSIZE;
+}
+
+/* Drops the queued keyboard reports when NKRO is toggled, they are laid
+ * out for the other endpoint */
+static void keyboard_queue_check_endpoint(void)
+{
+    uint8_t endpoint = keyboard_endpoint();
+    if (endpoint != keyboard_queue_endpoint) {
+        report_queue_clear(&keyboard_queue);
+        keyboard_queue_endpoint = endpoint;
+    }
+}
+
+bool report_endpoint_ready(uint8_t endpoint)
+{
+    Endpoint_SelectEndpoint(endpoint);
+    return Endpoint_IsReadWriteAllowed();
+}
+
+void report_endpoint_write(uint8_t endpoint, const uint8_t *report, uint8_t length)
+{
+    Endpoint_Write_Stream_LE(report, length, NULL);
+    /* Finalize the stream transfer to send the last packet */
+    Endpoint_ClearIN();
+}
+
+/* a polling interval of 10ms takes REPORT_QUEUE_TIMEOUT of these */
+void report_endpoint_wait(void)
+{
+    _delay_us(40);
+}
+
+/* Writes the queued reports that the endpoints have room for, called from
+ * the main loop so that it never waits for the host. Not from the SOF
+ * interrupt, which would change the selected endpoint under the feet of
+ * the main loop. */
+static void report_queues_task(void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return;
+
+    keyboard_queue_check_endpoint();
+    report_queue_drain(&keyboard_queue, keyboard_endpoint(), keyboard_length());
+#ifdef MOUSE_ENABLE
+    report_queue_drain(&mouse_queue, MOUSE_IN_EPNUM, sizeof(report_mouse_t));
+#endif
+    report_queue_drain(&extra_queue, EXTRAKEY_IN_EPNUM, sizeof(report_extra_t));
+}
+
 static void send_keyboard(report_keyboard_t *report)
 {
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -626,35 +725,11 @@ static void send_keyboard(report_keyboard_t *report)
       return;
     }
 
-    /* Select the Keyboard Report Endpoint */
-#ifdef NKRO_ENABLE
-    if (keyboard_protocol && keymap_config.nkro) {
-        /* Report protocol - NKRO */
-        Endpoint_SelectEndpoint(NKRO_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 1ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(4);
-        if (!Endpoint_IsReadWriteAllowed()) return;
-
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, NKRO_EPSIZE, NULL);
-    }
-    else
-#endif
-    {
-        /* Boot protocol */
-        Endpoint_SelectEndpoint(KEYBOARD_IN_EPNUM);
-
-        /* Check if write ready for a polling interval around 10ms */
-        while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-        if (!Endpoint_IsReadWriteAllowed()) return;
-
-        /* Write Keyboard Report Data */
-        Endpoint_Write_Stream_LE(report, KEYBOARD_EPSIZE, NULL);
-    }
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return;
 
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
+    keyboard_queue_check_endpoint();
+    report_queue_send(&keyboard_queue, report, keyboard_endpoint(), keyboard_length());
 
     keyboard_report_sent = *report;
 }
@@ -662,7 +737,6 @@ static void send_keyboard(report_keyboard_t *report)
 static void send_mouse(report_mouse_t *report)
 {
 #ifdef MOUSE_ENABLE
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -688,25 +762,16 @@ static void send_mouse(report_mouse_t *report)
       return;
     }
 
-    /* Select the Mouse Report Endpoint */
-    Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    /* Write Mouse Report Data */
-    Endpoint_Write_Stream_LE(report, sizeof(report_mouse_t), NULL);
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return;
 
-    /* Finalize the stream transfer to send the last packet */
-    Endpoint_ClearIN();
+    /* Movement is added up while the endpoint is busy */
+    report_queue_send(&mouse_queue, report, MOUSE_IN_EPNUM, sizeof(report_mouse_t));
 #endif
 }
 
 static void send_system(uint16_t data)
 {
-    uint8_t timeout = 255;
-
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
@@ -714,19 +779,11 @@ static void send_system(uint16_t data)
         .report_id = REPORT_ID_SYSTEM,
         .usage = data - SYSTEM_POWER_DOWN + 1
     };
-    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
-
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
-
-    Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
-    Endpoint_ClearIN();
+    report_queue_send(&extra_queue, &r, EXTRAKEY_IN_EPNUM, sizeof(report_extra_t));
 }
 
 static void send_consumer(uint16_t data)
 {
-    uint8_t timeout = 255;
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -769,14 +826,11 @@ static void send_consumer(uint16_t data)
         .report_id = REPORT_ID_CONSUMER,
         .usage = data
     };
-    Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
 
-    /* Check if write ready for a polling interval around 10ms */
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-    if (!Endpoint_IsReadWriteAllowed()) return;
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return;
 
-    Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
-    Endpoint_ClearIN();
+    report_queue_send(&extra_queue, &r, EXTRAKEY_IN_EPNUM, sizeof(report_extra_t));
 }
 
 
@@ -1049,13 +1103,18 @@ void virtser_task(void)
   }
 }
 void virtser_send(const uint8_t byte)
+{
+  virtser_send_buffer(&byte, 1);
+}
+
+void virtser_send_buffer(const uint8_t *data, const uint8_t length)
 {
   uint8_t timeout = 255;
   uint8_t ep = Endpoint_GetCurrentEndpoint();
 
   if (cdc_device.State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR)
   {
-    /* IN packet */
+    /* IN packets, as many as it takes */
     Endpoint_SelectEndpoint(cdc_device.Config.DataINEndpoint.Address);
 
     if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) {
@@ -1065,7 +1124,7 @@ void virtser_send(const uint8_t byte)
 
     while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
 
-    Endpoint_Write_8(byte);
+    Endpoint_Write_Stream_LE(data, length, NULL);
     CDC_Device_Flush(&cdc_device);
 
     if (Endpoint_IsINReady()) {
@@ -1191,6 +1250,7 @@ int main(void)
         #endif
 
         keyboard_task();
+        report_queues_task();
 
 #ifdef MIDI_ENABLE
         midi_device_process(&midi_device);
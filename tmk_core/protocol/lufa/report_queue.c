@@ -0,0 +1,97 @@
+#include <string.h>
+#include "report_queue.h"
+#include "report.h"
+
+static inline uint8_t *slot(const report_queue_t *queue, uint8_t index) {
+  index += queue->head;
+  if (index >= queue->slots) {
+    index -= queue->slots;
+  }
+  return queue->reports + index * queue->size;
+}
+
+bool report_merge_same(uint8_t *queued, const uint8_t *next, uint8_t size) {
+  return memcmp(queued, next, size) == 0;
+}
+
+static inline bool add_motion(int8_t *queued, int8_t next) {
+  int16_t sum = *queued + next;
+  if (sum < -127 || sum > 127) {
+    return false;
+  }
+  *queued = sum;
+  return true;
+}
+
+bool report_merge_mouse(uint8_t *queued, const uint8_t *next, uint8_t size) {
+  report_mouse_t *q = (report_mouse_t *)queued;
+  const report_mouse_t *n = (const report_mouse_t *)next;
+  report_mouse_t merged = *q;
+
+  if (q->buttons != n->buttons) {
+    return false;
+  }
+  if (!add_motion(&merged.x, n->x) || !add_motion(&merged.y, n->y) ||
+      !add_motion(&merged.v, n->v) || !add_motion(&merged.h, n->h)) {
+    return false;
+  }
+  *q = merged;
+  return true;
+}
+
+bool report_queue_push(report_queue_t *queue, const void *report) {
+  if (queue->count && queue->merge &&
+      queue->merge(slot(queue, queue->count - 1), report, queue->size)) {
+    return true;
+  }
+  if (queue->count == queue->slots) {
+    return false;
+  }
+  memcpy(slot(queue, queue->count), report, queue->size);
+  queue->count++;
+  return true;
+}
+
+const uint8_t *report_queue_front(const report_queue_t *queue) {
+  return queue->count ? slot(queue, 0) : NULL;
+}
+
+void report_queue_pop(report_queue_t *queue) {
+  if (!queue->count) {
+    return;
+  }
+  queue->count--;
+  if (++queue->head == queue->slots) {
+    queue->head = 0;
+  }
+}
+
+void report_queue_clear(report_queue_t *queue) {
+  queue->head = 0;
+  queue->count = 0;
+}
+
+uint8_t report_queue_drain(report_queue_t *queue, uint8_t endpoint, uint8_t length) {
+  uint8_t written = 0;
+  while (queue->count && report_endpoint_ready(endpoint)) {
+    report_endpoint_write(endpoint, slot(queue, 0), length);
+    report_queue_pop(queue);
+    written++;
+  }
+  return written;
+}
+
+void report_queue_send(report_queue_t *queue, const void *report, uint8_t endpoint, uint8_t length) {
+  uint8_t timeout = REPORT_QUEUE_TIMEOUT;
+
+  report_queue_drain(queue, endpoint, length);
+  while (!report_queue_push(queue, report)) {
+    if (!timeout--) {
+      report_queue_pop(queue);
+      continue;
+    }
+    report_endpoint_wait();
+    report_queue_drain(queue, endpoint, length);
+  }
+  report_queue_drain(queue, endpoint, length);
+}
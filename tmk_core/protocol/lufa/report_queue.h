@@ -0,0 +1,81 @@
+/* Report queues of the IN endpoints.
+ *
+ * The reports for the host are queued per endpoint and written whenever
+ * the endpoint has room, instead of waiting for it while the matrix isn't
+ * scanned. A report that only repeats the one queued before it is merged
+ * into that one: identical keyboard and extra key reports are dropped, and
+ * mouse movement adds up as long as the buttons stay the same, so that no
+ * press or release ever gets lost.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef REPORT_QUEUE_KEYBOARD_SLOTS
+#define REPORT_QUEUE_KEYBOARD_SLOTS 4
+#endif
+#ifndef REPORT_QUEUE_MOUSE_SLOTS
+#define REPORT_QUEUE_MOUSE_SLOTS 4
+#endif
+#ifndef REPORT_QUEUE_EXTRA_SLOTS
+#define REPORT_QUEUE_EXTRA_SLOTS 4
+#endif
+// How many times report_endpoint_wait() is called for a full queue
+#ifndef REPORT_QUEUE_TIMEOUT
+#define REPORT_QUEUE_TIMEOUT 255
+#endif
+
+// Merges 'next' into 'queued' and returns true, if the host can't tell the
+// difference between getting both and getting only the merged one
+typedef bool (*report_merge_t)(uint8_t *queued, const uint8_t *next, uint8_t size);
+
+typedef struct {
+  uint8_t *reports;
+  uint8_t size;       // bytes per report
+  uint8_t slots;
+  uint8_t head;       // the oldest report
+  uint8_t count;
+  report_merge_t merge;
+} report_queue_t;
+
+#define REPORT_QUEUE(name, report_size, report_slots, merge_fn) \
+  static uint8_t name##_reports[(report_slots) * (report_size)]; \
+  static report_queue_t name = { \
+    .reports = name##_reports, .size = (report_size), .slots = (report_slots), \
+    .merge = (merge_fn) }
+
+// The endpoint side, implemented by lufa.c. ready() selects the endpoint
+// and tells whether it has room for a report.
+bool report_endpoint_ready(uint8_t endpoint);
+void report_endpoint_write(uint8_t endpoint, const uint8_t *report, uint8_t length);
+// Waits a bit for the host to pick up a report, when a queue is full
+void report_endpoint_wait(void);
+
+bool report_merge_same(uint8_t *queued, const uint8_t *next, uint8_t size);
+bool report_merge_mouse(uint8_t *queued, const uint8_t *next, uint8_t size);
+
+// false when the queue is full and the report couldn't be merged either
+bool report_queue_push(report_queue_t *queue, const void *report);
+// the oldest report, or NULL
+const uint8_t *report_queue_front(const report_queue_t *queue);
+void report_queue_pop(report_queue_t *queue);
+void report_queue_clear(report_queue_t *queue);
+
+// Writes the first 'length' bytes of queued reports for as long as the
+// endpoint has room, and returns how many were written
+uint8_t report_queue_drain(report_queue_t *queue, uint8_t endpoint, uint8_t length);
+
+// Queues a report and writes what the endpoint takes. A full queue is given
+// REPORT_QUEUE_TIMEOUT waits for the host to catch up, after that the oldest
+// report is dropped, the way a report used to be dropped when the endpoint
+// didn't get ready in time.
+void report_queue_send(report_queue_t *queue, const void *report, uint8_t endpoint, uint8_t length);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,267 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+#include "adafruit_ble_pipeline.h"
+extern "C" {
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+// Stands in for the module on the other end of the SPI bus. Every command
+// is answered with OK after 'latency' milliseconds. Polling for a response
+// that isn't there yet lets some time pass, so that loops that wait for
+// one come to an end.
+namespace {
+struct MockModule {
+    uint32_t latency = 10;
+    std::string partial;
+    std::vector<std::string> commands;
+    std::deque<uint16_t> responses;
+    uint32_t max_in_flight = 0;
+    uint32_t polls = 0;
+
+    void reset() {
+        partial.clear();
+        commands.clear();
+        responses.clear();
+        max_in_flight = 0;
+    }
+};
+
+MockModule module;
+}
+
+bool sdep_send_pkt(const struct sdep_msg *msg, uint16_t timeout) {
+    module.partial.append((const char *)msg->payload, msg->len);
+    if (!msg->more) {
+        module.commands.push_back(module.partial);
+        module.partial.clear();
+        module.responses.push_back(timer_read() + module.latency);
+        if (module.responses.size() > module.max_in_flight) {
+            module.max_in_flight = module.responses.size();
+        }
+    }
+    return true;
+}
+
+bool sdep_recv_ready(void) {
+    if (!module.responses.empty() &&
+        TIMER_DIFF_16(timer_read(), module.responses.front()) < 0x8000) {
+        return true;
+    }
+    if (++module.polls % 100 == 0) {
+        advance_time(1);
+    }
+    return false;
+}
+
+bool sdep_recv_pkt(struct sdep_msg *msg, uint16_t timeout) {
+    if (module.responses.empty()) {
+        return false;
+    }
+    module.responses.pop_front();
+    msg->type = SdepResponse;
+    msg->len = 4;
+    msg->more = 0;
+    memcpy(msg->payload, "OK\r\n", 4);
+    return true;
+}
+
+class AdafruitBlePipeline : public testing::Test {
+public:
+    AdafruitBlePipeline() {
+        set_time(0);
+        // start with nothing held down on the host
+        ble_key_report none = keys(0);
+        ble_queue_keys(&none);
+        flush();
+        module.reset();
+    }
+
+    ~AdafruitBlePipeline() {
+        flush();
+    }
+
+    // Runs the pipeline like adafruit_ble_task() would, one call per ms
+    void run(uint32_t ms) {
+        for (uint32_t i = 0; i < ms; i++) {
+            ble_pipeline_read_responses(true);
+            ble_pipeline_send(SdepShortTimeout);
+            advance_time(1);
+        }
+    }
+
+    void flush() {
+        while (ble_queue_size() > 0 || !ble_pipeline_idle()) {
+            run(1);
+        }
+    }
+
+    static ble_key_report keys(uint8_t modifier, uint8_t k0 = 0, uint8_t k1 = 0) {
+        ble_key_report report = {modifier, {k0, k1, 0, 0, 0, 0}};
+        return report;
+    }
+
+    static std::string encoded(ble_key_report report) {
+        char cmd[BleMaxCommandLength];
+        return std::string(cmd, ble_encode_keys(cmd, &report));
+    }
+};
+
+TEST_F(AdafruitBlePipeline, encodes_key_reports_like_snprintf) {
+    ble_key_report report = {0xA5, {0x04, 0x1F, 0xE0, 0x00, 0xFF, 0x10}};
+    char expected[64];
+    snprintf(expected, sizeof(expected),
+        "AT+BLEKEYBOARDCODE=%02x-00-%02x-%02x-%02x-%02x-%02x-%02x",
+        report.modifier, report.keys[0], report.keys[1], report.keys[2],
+        report.keys[3], report.keys[4], report.keys[5]);
+    EXPECT_EQ(encoded(report), expected);
+}
+
+TEST_F(AdafruitBlePipeline, sends_a_key_report_as_one_command) {
+    ble_key_report report = keys(0x02, 0x04);
+    ble_queue_keys(&report);
+    run(1);
+    ASSERT_EQ(module.commands.size(), 1u);
+    EXPECT_EQ(module.commands[0], "AT+BLEKEYBOARDCODE=02-00-04-00-00-00-00-00");
+}
+
+TEST_F(AdafruitBlePipeline, coalesces_presses_that_are_still_queued) {
+    ble_key_report a = keys(0, 0x04);
+    ble_key_report ab = keys(0, 0x04, 0x05);
+    ble_queue_keys(&a);
+    ble_queue_keys(&ab);
+    EXPECT_EQ(ble_queue_size(), 1);
+    flush();
+    ASSERT_EQ(module.commands.size(), 1u);
+    EXPECT_EQ(module.commands[0], encoded(ab));
+}
+
+TEST_F(AdafruitBlePipeline, does_not_coalesce_a_press_with_a_later_modifier_change) {
+    // "a" and then shift "a" is not one shifted "A"
+    ble_key_report a = keys(0, 0x04);
+    ble_key_report shift_a = keys(0x02, 0x04);
+    ble_queue_keys(&a);
+    ble_queue_keys(&shift_a);
+    EXPECT_EQ(ble_queue_size(), 2);
+    flush();
+    ASSERT_EQ(module.commands.size(), 2u);
+    EXPECT_EQ(module.commands[0], encoded(a));
+    EXPECT_EQ(module.commands[1], encoded(shift_a));
+}
+
+TEST_F(AdafruitBlePipeline, does_not_coalesce_a_tap) {
+    ble_key_report a = keys(0, 0x04);
+    ble_key_report none = keys(0);
+    ble_queue_keys(&a);
+    ble_queue_keys(&none);
+    EXPECT_EQ(ble_queue_size(), 2);
+    flush();
+    ASSERT_EQ(module.commands.size(), 2u);
+    EXPECT_EQ(module.commands[0], encoded(a));
+    EXPECT_EQ(module.commands[1], encoded(none));
+}
+
+TEST_F(AdafruitBlePipeline, does_not_coalesce_a_release_and_press_again) {
+    ble_key_report a = keys(0, 0x04);
+    ble_key_report none = keys(0);
+    ble_queue_keys(&a);
+    flush();
+    ble_queue_keys(&none);
+    ble_queue_keys(&a);
+    EXPECT_EQ(ble_queue_size(), 2);
+}
+
+TEST_F(AdafruitBlePipeline, does_not_coalesce_a_modifier_tap) {
+    ble_key_report shift = keys(0x02);
+    ble_key_report none = keys(0);
+    ble_queue_keys(&shift);
+    ble_queue_keys(&none);
+    EXPECT_EQ(ble_queue_size(), 2);
+}
+
+TEST_F(AdafruitBlePipeline, coalesces_a_rollover) {
+    ble_key_report a = keys(0, 0x04);
+    ble_key_report ab = keys(0, 0x04, 0x05);
+    ble_key_report b = keys(0, 0, 0x05);
+    ble_queue_keys(&a);
+    flush();
+    module.reset();
+    ble_queue_keys(&ab);
+    ble_queue_keys(&b);
+    EXPECT_EQ(ble_queue_size(), 1);
+    flush();
+    ASSERT_EQ(module.commands.size(), 1u);
+    EXPECT_EQ(module.commands[0], encoded(b));
+}
+
+TEST_F(AdafruitBlePipeline, does_not_coalesce_across_a_consumer_key) {
+    ble_key_report a = keys(0, 0x04);
+    ble_key_report ab = keys(0, 0x04, 0x05);
+    ble_queue_keys(&a);
+    ble_queue_consumer(0x00E9);
+    ble_queue_keys(&ab);
+    EXPECT_EQ(ble_queue_size(), 3);
+    flush();
+    ASSERT_EQ(module.commands.size(), 3u);
+    EXPECT_EQ(module.commands[1], "AT+BLEHIDCONTROLKEY=0x00e9");
+}
+
+TEST_F(AdafruitBlePipeline, keeps_at_most_the_allowed_commands_in_flight) {
+    // tapping the same key over and over can't be coalesced
+    for (uint8_t i = 0; i < 2 * AdafruitBleMaxPending; i++) {
+        ble_key_report press = keys(0, 0x04);
+        ble_key_report release = keys(0);
+        ble_queue_keys(&press);
+        ble_queue_keys(&release);
+    }
+    run(1);
+    EXPECT_EQ(module.commands.size(), AdafruitBleMaxPending);
+    EXPECT_EQ(module.max_in_flight, AdafruitBleMaxPending);
+    flush();
+    EXPECT_EQ(module.commands.size(), 4u * AdafruitBleMaxPending);
+}
+
+TEST_F(AdafruitBlePipeline, keeps_up_with_a_report_every_ms) {
+    // A very fast typist: a new report every ms, alternating between pressing
+    // a key, rolling over to the next one and releasing everything
+    const uint32_t reports = 3000;
+    ble_key_report last = keys(0);
+    uint32_t start = timer_read32();
+    for (uint32_t i = 0; i < reports; i++) {
+        uint8_t key = 0x04 + (i / 3) % 26;
+        switch (i % 3) {
+            case 0: last = keys(0, key); break;
+            case 1: last = keys(0, key, key + 1); break;
+            case 2: last = keys(0); break;
+        }
+        ble_queue_keys(&last);
+        run(1);
+    }
+    flush();
+    uint32_t elapsed = timer_read32() - start;
+
+    ASSERT_FALSE(module.commands.empty());
+    EXPECT_EQ(module.commands.back(), encoded(last));
+    double per_second = reports * 1000.0 / elapsed;
+    // Sending one command per response latency is what it used to manage
+    EXPECT_GT(per_second, 1000.0 / module.latency);
+}
@@ -0,0 +1,262 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cstring>
+#include <vector>
+#include "report_queue.h"
+#include "report.h"
+
+// Stands in for an interrupt IN endpoint with a single bank. A written
+// report occupies the bank until the host polls it, which it does every
+// 'interval' microseconds. Waiting for the endpoint takes 40 us.
+namespace {
+struct SimulatedEndpoint {
+    uint32_t now = 0;
+    uint32_t interval = 1000;
+    uint32_t next_poll = 1000;
+    bool polling = true;
+    bool bank_full = false;
+    std::vector<uint8_t> bank;
+    std::vector<std::vector<uint8_t>> received;
+    uint32_t waits = 0;
+
+    void reset() {
+        *this = SimulatedEndpoint();
+    }
+
+    void advance(uint32_t us) {
+        now += us;
+        if (now >= next_poll) {
+            next_poll += ((now - next_poll) / interval + 1) * interval;
+            if (polling && bank_full) {
+                received.push_back(bank);
+                bank_full = false;
+            }
+        }
+    }
+};
+
+SimulatedEndpoint endpoint;
+}
+
+bool report_endpoint_ready(uint8_t ep) {
+    return !endpoint.bank_full;
+}
+
+void report_endpoint_write(uint8_t ep, const uint8_t *report, uint8_t length) {
+    endpoint.bank.assign(report, report + length);
+    endpoint.bank_full = true;
+}
+
+void report_endpoint_wait(void) {
+    endpoint.waits++;
+    endpoint.advance(40);
+}
+
+namespace {
+REPORT_QUEUE(keys, sizeof(report_keyboard_t), REPORT_QUEUE_KEYBOARD_SLOTS, report_merge_same);
+REPORT_QUEUE(mouse, sizeof(report_mouse_t), REPORT_QUEUE_MOUSE_SLOTS, report_merge_mouse);
+}
+
+class ReportQueue : public testing::Test {
+public:
+    ReportQueue() {
+        endpoint.reset();
+        report_queue_clear(&keys);
+        report_queue_clear(&mouse);
+    }
+
+    static report_keyboard_t keyboard(uint8_t k0 = 0, uint8_t k1 = 0) {
+        report_keyboard_t report = {};
+        report.keys[0] = k0;
+        report.keys[1] = k1;
+        return report;
+    }
+
+    static std::vector<uint8_t> bytes(const report_keyboard_t &report) {
+        return std::vector<uint8_t>(report.raw, report.raw + KEYBOARD_REPORT_SIZE);
+    }
+
+    static report_mouse_t move(int8_t x, int8_t y = 0, uint8_t buttons = 0) {
+        report_mouse_t report = {};
+        report.buttons = buttons;
+        report.x = x;
+        report.y = y;
+        return report;
+    }
+
+    static report_mouse_t received_mouse(size_t i) {
+        report_mouse_t report;
+        memcpy(&report, endpoint.received[i].data(), sizeof(report));
+        return report;
+    }
+
+    void send(const report_keyboard_t &report) {
+        report_queue_send(&keys, &report, 1, KEYBOARD_REPORT_SIZE);
+    }
+
+    void send(const report_mouse_t &report) {
+        report_queue_send(&mouse, &report, 2, sizeof(report_mouse_t));
+    }
+
+    // The main loop, scanning once every ms
+    void run(uint32_t ms) {
+        for (uint32_t i = 0; i < ms; i++) {
+            endpoint.advance(1000);
+            report_queue_drain(&keys, 1, KEYBOARD_REPORT_SIZE);
+            report_queue_drain(&mouse, 2, sizeof(report_mouse_t));
+        }
+    }
+};
+
+TEST_F(ReportQueue, WritesAReportRightAwayWhenTheEndpointIsFree) {
+    send(keyboard(KC_A));
+    EXPECT_TRUE(endpoint.bank_full);
+    EXPECT_EQ(report_queue_front(&keys), nullptr);
+    run(1);
+    ASSERT_EQ(endpoint.received.size(), 1u);
+    EXPECT_EQ(endpoint.received[0], bytes(keyboard(KC_A)));
+}
+
+TEST_F(ReportQueue, DeliversEveryKeyTransitionInOrder) {
+    // a tap of A and B rolling over, all within one polling interval
+    send(keyboard(KC_A));
+    send(keyboard());
+    send(keyboard(KC_B));
+    send(keyboard(KC_B, KC_C));
+    send(keyboard(KC_C));
+    EXPECT_EQ(endpoint.waits, 0u);
+    run(10);
+    std::vector<std::vector<uint8_t>> expected = {
+        bytes(keyboard(KC_A)), bytes(keyboard()), bytes(keyboard(KC_B)),
+        bytes(keyboard(KC_B, KC_C)), bytes(keyboard(KC_C)),
+    };
+    EXPECT_EQ(endpoint.received, expected);
+}
+
+TEST_F(ReportQueue, MergesRepeatedKeyboardReports) {
+    send(keyboard(KC_A));
+    send(keyboard(KC_B));
+    send(keyboard(KC_B));
+    send(keyboard(KC_B));
+    EXPECT_EQ(keys.count, 1);
+    run(5);
+    EXPECT_EQ(endpoint.received.size(), 2u);
+}
+
+TEST_F(ReportQueue, AddsUpMouseMovementWhileTheEndpointIsBusy) {
+    for (int i = 0; i < 10; i++) {
+        send(move(5, -2));
+    }
+    EXPECT_EQ(mouse.count, 1);
+    run(5);
+    ASSERT_EQ(endpoint.received.size(), 2u);
+    EXPECT_EQ(received_mouse(0).x, 5);
+    EXPECT_EQ(received_mouse(1).x, 45);
+    EXPECT_EQ(received_mouse(1).y, -18);
+}
+
+TEST_F(ReportQueue, KeepsMouseButtonChangesApart) {
+    send(move(1));
+    send(move(1));
+    send(move(0, 0, MOUSE_BTN1));
+    send(move(1, 0, MOUSE_BTN1));
+    send(move(0));
+    run(10);
+    ASSERT_EQ(endpoint.received.size(), 4u);
+    EXPECT_EQ(received_mouse(1).x, 1);
+    EXPECT_EQ(received_mouse(1).buttons, 0);
+    EXPECT_EQ(received_mouse(2).x, 1);
+    EXPECT_EQ(received_mouse(2).buttons, MOUSE_BTN1);
+    EXPECT_EQ(received_mouse(3).buttons, 0);
+}
+
+TEST_F(ReportQueue, DoesNotOverflowTheMovement) {
+    send(move(0));
+    send(move(100));
+    send(move(100));
+    send(move(-50));
+    EXPECT_EQ(mouse.count, 2);
+    run(10);
+    ASSERT_EQ(endpoint.received.size(), 3u);
+    EXPECT_EQ(received_mouse(1).x, 100);
+    EXPECT_EQ(received_mouse(2).x, 50);
+}
+
+TEST_F(ReportQueue, WaitsForTheHostOnlyWhenTheQueueIsFull) {
+    uint8_t key = KC_A;
+    // one in the bank, and a full queue behind it
+    for (int i = 0; i <= REPORT_QUEUE_KEYBOARD_SLOTS; i++) {
+        send(keyboard(key++));
+    }
+    EXPECT_EQ(endpoint.waits, 0u);
+    send(keyboard(key++));
+    EXPECT_GT(endpoint.waits, 0u);
+    EXPECT_LE(endpoint.waits, 1000u / 40 + 1);
+    run(10);
+    ASSERT_EQ(endpoint.received.size(), REPORT_QUEUE_KEYBOARD_SLOTS + 2u);
+    for (size_t i = 0; i < endpoint.received.size(); i++) {
+        EXPECT_EQ(endpoint.received[i], bytes(keyboard(KC_A + i)));
+    }
+}
+
+TEST_F(ReportQueue, GivesUpOnAHostThatDoesNotPoll) {
+    endpoint.polling = false;
+    for (int i = 0; i < 3 * REPORT_QUEUE_KEYBOARD_SLOTS; i++) {
+        send(keyboard(KC_A + i));
+    }
+    EXPECT_EQ(keys.count, REPORT_QUEUE_KEYBOARD_SLOTS);
+    // the newest reports are kept
+    EXPECT_EQ(keys.reports[((keys.head + keys.count - 1) % keys.slots) * keys.size + 2],
+              KC_A + 3 * REPORT_QUEUE_KEYBOARD_SLOTS - 1);
+    endpoint.polling = true;
+    run(REPORT_QUEUE_KEYBOARD_SLOTS + 2);
+    EXPECT_EQ(keys.count, 0);
+}
+
+TEST_F(ReportQueue, NothingQueuedIsSentAfterAClear) {
+    // one in the bank, two waiting when the host resets the device
+    send(keyboard(KC_A));
+    send(keyboard(KC_B));
+    send(keyboard(KC_C));
+    report_queue_clear(&keys);
+    EXPECT_EQ(report_queue_front(&keys), nullptr);
+    send(keyboard(KC_D));
+    run(3);
+    ASSERT_EQ(endpoint.received.size(), 2u);
+    EXPECT_EQ(endpoint.received[0], bytes(keyboard(KC_A)));
+    EXPECT_EQ(endpoint.received[1], bytes(keyboard(KC_D)));
+}
+
+TEST_F(ReportQueue, FastMouseKeysNeverWaitAndLoseNoMovement) {
+    // Mouse keys at full speed, a report every scan, with the host polling
+    // the mouse endpoint every 10 ms
+    endpoint.interval = 10000;
+    endpoint.next_poll = 10000;
+    const uint32_t reports = 1000;
+    for (uint32_t i = 0; i < reports; i++) {
+        send(move(2, 1));
+        run(1);
+    }
+    run(20);
+    int32_t x = 0;
+    for (size_t i = 0; i < endpoint.received.size(); i++) {
+        x += received_mouse(i).x;
+    }
+
+    EXPECT_EQ(endpoint.waits, 0u);
+    EXPECT_EQ(x, 2 * (int32_t)reports);
+}
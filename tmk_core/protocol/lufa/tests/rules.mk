@@ -0,0 +1,11 @@
+adafruit_ble_pipeline_DEFS := -DNO_PRINT
+adafruit_ble_pipeline_INC := $(TMK_PATH)/protocol/lufa
+adafruit_ble_pipeline_SRC := \
+	$(TMK_PATH)/protocol/lufa/tests/adafruit_ble_pipeline_tests.cpp \
+	$(TMK_PATH)/protocol/lufa/adafruit_ble_pipeline.cpp \
+	$(TMK_PATH)/common/test/timer.c
+
+report_queue_INC := $(TMK_PATH)/protocol/lufa
+report_queue_SRC := \
+	$(TMK_PATH)/protocol/lufa/tests/report_queue_tests.cpp \
+	$(TMK_PATH)/protocol/lufa/report_queue.c
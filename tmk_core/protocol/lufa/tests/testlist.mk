@@ -0,0 +1,3 @@
+TEST_LIST +=\
+	adafruit_ble_pipeline\
+	report_queue